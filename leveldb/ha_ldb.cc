@@ -94,9 +94,19 @@
 
 #include "sql_priv.h"
 #include "sql_class.h"           // MYSQL_HANDLERTON_INTERFACE_VERSION
+#include "sql_base.h"            // fill_record
 #include "ha_ldb.h"
 #include "probes_mysql.h"
 #include "sql_plugin.h"
+#include "myisampack.h"          // mi_int4store, mi_uint4korr
+#include "sql_show.h"            // schema_table_store_record
+#include "sql_table.h"           // filename_to_tablename
+#include "tztime.h"              // Time_zone
+#include "leveldb/cache.h"
+#include "leveldb/filter_policy.h"
+#include <map>
+#include <set>
+#include <vector>
 
 
 static handler *ldb_create_handler(handlerton *hton,
@@ -107,6 +117,152 @@ leveldb::Options options;
 leveldb::WriteOptions wo= leveldb::WriteOptions();
 handlerton *ldb_hton;
 
+/* The leveldb instance holding every LEVELDB table and the dictionary. */
+static leveldb::DB *ldb_db= NULL;
+static char *ldb_data_home_dir;
+
+/*
+  Memory and file budget of the engine. The block cache is owned by the
+  plugin rather than by the DB, so its size is fixed by the engine alone.
+*/
+static leveldb::Cache *ldb_block_cache= NULL;
+/* Bloom filter of the table files, consulted by the duplicate key checks. */
+static const leveldb::FilterPolicy *ldb_filter_policy= NULL;
+
+/*
+  Row cache: the stored rows read by primary key, so that hot rows are not
+  looked up in the memtables and the table files again. It is created at
+  startup when ldb_row_cache_size is not 0; the size can change later.
+
+  The cache key is ldb_row_cache_generation followed by the leveldb key.
+  Committed writes erase their keys; operations that change rows without a
+  transaction batch (bulk loads) move to a new generation instead.
+
+  Each key hashes to a stripe whose seq is raised to the last sequence
+  number after a commit touched one of its keys. A cached row carries the
+  stripe seq it was read under: it is current for every snapshot from that
+  sequence on, as long as it stays in the cache. While writers is not 0 a
+  commit of one of the keys of the stripe is in progress: its keys were
+  erased before the write, and no row of the stripe is cached until the
+  commit is over, so no snapshot that sees the commit finds an older row.
+*/
+#define LDB_ROW_CACHE_STRIPES 64
+
+typedef struct st_ldb_row_cache_stripe {
+  mysql_mutex_t mutex;
+  ulonglong seq;
+  uint writers;  ///< Commits in progress that write keys of the stripe
+} LDB_ROW_CACHE_STRIPE;
+
+typedef struct st_ldb_cached_row {
+  ulonglong valid_from;  ///< First snapshot sequence that may read the row
+  std::string value;
+} LDB_CACHED_ROW;
+
+static leveldb::Cache *ldb_row_cache= NULL;
+static ulonglong ldb_row_cache_size;
+static volatile uint32 ldb_row_cache_generation= 0;
+static LDB_ROW_CACHE_STRIPE ldb_row_cache_stripes[LDB_ROW_CACHE_STRIPES];
+
+/*
+  Row locks: a write locks the primary key of its row until its transaction
+  ends, so concurrent writers of one row take turns and the later one sees
+  the change of the first, see ha_ldb::lock_row(). It locks the unique
+  secondary values it writes the same way, see ha_ldb::check_unique_keys().
+  The owners are kept in hash tables of leveldb keys, split into stripes by
+  key hash. A waiter gives up after lock_wait_timeout seconds, and wakes up
+  every LDB_LOCK_WAIT_SLICE seconds to see whether it was killed.
+
+  Before waiting, a transaction follows the chain of lock_wait_owner from
+  the lock holder: if it leads back to itself, waiting would be a deadlock
+  and the lock request fails instead. The chain is protected by
+  ldb_lock_wait_mutex; a transaction is not freed while lock_waiters of
+  others point at it.
+*/
+#define LDB_ROW_LOCK_STRIPES 64
+#define LDB_LOCK_WAIT_MAX_DEPTH 200  // Longer chains are not searched
+#define LDB_LOCK_WAIT_SLICE 1        // Seconds between checks for KILL
+#define LDB_TRX_KEPT_ROW_LOCKS 1024  // Key strings kept by a transaction
+
+typedef struct st_ldb_row_lock_stripe {
+  mysql_mutex_t mutex;
+  mysql_cond_t cond;                     ///< Broadcast when a lock is freed
+  std::map<std::string, trx_t*> owners;
+} LDB_ROW_LOCK_STRIPE;
+
+static LDB_ROW_LOCK_STRIPE ldb_row_lock_stripes[LDB_ROW_LOCK_STRIPES];
+static mysql_mutex_t ldb_lock_wait_mutex;
+static mysql_cond_t ldb_lock_wait_cond;    ///< Some lock_waiters dropped to 0
+
+/*
+  Transactions of closed connections, kept by free_trx() so that get_trx()
+  hands a new connection one whose batch and row lock list already have
+  their memory. Protected by ldb_mutex.
+*/
+#define LDB_TRX_POOL_SIZE 64
+static std::vector<trx_t*> ldb_trx_pool;
+
+static MYSQL_THDVAR_ULONG(
+  lock_wait_timeout,
+  PLUGIN_VAR_RQCMDARG,
+  "Seconds a write waits for the lock of a row held by another transaction "
+  "before the statement fails.",
+  NULL,
+  NULL,
+  50,
+  1,
+  1024 * 1024 * 1024,
+  0);
+
+static ulonglong ldb_block_cache_size;
+static ulonglong ldb_memtable_budget;
+static ulong ldb_max_open_files;
+
+/* Rows sorted in memory at a time by a bulk insert; 0 disables bulk loads. */
+static ulonglong ldb_bulk_load_buffer_size;
+
+/* Write batch size at which a large UPDATE or DELETE spills; 0 never does. */
+static ulonglong ldb_trx_spill_size;
+
+/*
+  Table format and compaction tuning, mapped onto leveldb::Options by
+  ldb_static_options() and ldb_dynamic_options(). The dynamic ones are
+  applied to the open DB by DB::SetOptions() when they are set.
+*/
+static ulong ldb_block_size;
+static ulong ldb_block_restart_interval;
+static ulong ldb_bloom_bits_per_key;
+static ulong ldb_compression;
+static ulong ldb_target_file_size;
+static ulong ldb_base_level_size;
+static ulong ldb_arena_block_size;
+static my_bool ldb_use_mmap_reads;
+static ulong ldb_level0_compaction_trigger;
+static ulong ldb_level0_slowdown_writes_trigger;
+static ulong ldb_level0_stop_writes_trigger;
+static ulong ldb_max_mem_compact_level;
+static ulong ldb_limit_compact_levels;
+static ulong ldb_limit_compact_count_interval;
+static ulong ldb_limit_compact_time_interval;
+static ulong ldb_limit_compact_time_start;
+static ulong ldb_limit_compact_time_end;
+static ulong ldb_delete_obsolete_files_interval;
+static my_bool ldb_seek_compaction;
+static my_bool ldb_sync_writes;
+
+/* Next table id handed out by create(), protected by ldb_mutex. */
+static uint32 ldb_next_table_id;
+
+/*
+  Ids of dropped tables whose keys may still be in the leveldb instance.
+  The comparator hides their keys from reads and compactions discard them.
+  ldb_dropped_count is read without the lock: a dropped table is no longer
+  accessed by anyone, so a stale count never exposes its keys.
+*/
+static std::set<uint32> ldb_dropped_tables;
+static mysql_rwlock_t ldb_dropped_lock;
+static volatile uint32 ldb_dropped_count= 0;
+
 /* Variables for ldb share methods */
 
 /* 
@@ -131,12 +287,32 @@ static uchar* ldb_get_key(LEVELDB_SHARE *share, size_t *length,
 }
 
 #ifdef HAVE_PSI_INTERFACE
-static PSI_mutex_key ex_key_mutex_ldb, ex_key_mutex_LEVELDB_SHARE_mutex;
+static PSI_mutex_key ex_key_mutex_ldb, ex_key_mutex_LEVELDB_SHARE_mutex,
+                     ex_key_mutex_ldb_row_cache_stripe,
+                     ex_key_mutex_ldb_row_lock_stripe,
+                     ex_key_mutex_ldb_lock_wait;
+static PSI_rwlock_key ex_key_rwlock_ldb_dropped;
+static PSI_cond_key ex_key_cond_ldb_row_lock_stripe,
+                    ex_key_cond_ldb_lock_wait;
 
 static PSI_mutex_info all_ldb_mutexes[]=
 {
   { &ex_key_mutex_ldb, "ldb", PSI_FLAG_GLOBAL},
-  { &ex_key_mutex_LEVELDB_SHARE_mutex, "LEVELDB_SHARE::mutex", 0}
+  { &ex_key_mutex_LEVELDB_SHARE_mutex, "LEVELDB_SHARE::mutex", 0},
+  { &ex_key_mutex_ldb_row_cache_stripe, "ldb_row_cache_stripe", 0},
+  { &ex_key_mutex_ldb_row_lock_stripe, "ldb_row_lock_stripe", 0},
+  { &ex_key_mutex_ldb_lock_wait, "ldb_lock_wait", PSI_FLAG_GLOBAL}
+};
+
+static PSI_rwlock_info all_ldb_rwlocks[]=
+{
+  { &ex_key_rwlock_ldb_dropped, "ldb_dropped", PSI_FLAG_GLOBAL}
+};
+
+static PSI_cond_info all_ldb_conds[]=
+{
+  { &ex_key_cond_ldb_row_lock_stripe, "ldb_row_lock_stripe", 0},
+  { &ex_key_cond_ldb_lock_wait, "ldb_lock_wait", PSI_FLAG_GLOBAL}
 };
 
 static void init_ldb_psi_keys()
@@ -149,10 +325,249 @@ static void init_ldb_psi_keys()
 
   count= array_elements(all_ldb_mutexes);
   PSI_server->register_mutex(category, all_ldb_mutexes, count);
+
+  count= array_elements(all_ldb_rwlocks);
+  PSI_server->register_rwlock(category, all_ldb_rwlocks, count);
+
+  count= array_elements(all_ldb_conds);
+  PSI_server->register_cond(category, all_ldb_conds, count);
 }
 #endif
 
 
+/**
+  @brief
+  Appends the key prefix of table table_id.
+*/
+
+static void ldb_table_prefix(uint32 table_id, std::string &key)
+{
+  char buf[LDB_TABLE_ID_LENGTH];
+  mi_int4store(buf, table_id);
+  key.append(buf, LDB_TABLE_ID_LENGTH);
+}
+
+
+/**
+  @brief
+  Builds the dictionary key of the given type for name.
+*/
+
+static void ldb_dict_key(char type, const char *name, size_t length,
+                         std::string &key)
+{
+  ldb_table_prefix(LDB_DICT_TABLE_ID, key);
+  key.push_back(type);
+  key.append(name, length);
+}
+
+
+static bool ldb_table_dropped(uint32 table_id)
+{
+  bool dropped;
+
+  if (!ldb_dropped_count)
+    return false;
+  mysql_rwlock_rdlock(&ldb_dropped_lock);
+  dropped= ldb_dropped_tables.count(table_id) != 0;
+  mysql_rwlock_unlock(&ldb_dropped_lock);
+  return dropped;
+}
+
+
+static void ldb_mark_dropped(uint32 table_id)
+{
+  mysql_rwlock_wrlock(&ldb_dropped_lock);
+  ldb_dropped_tables.insert(table_id);
+  ldb_dropped_count= (uint32) ldb_dropped_tables.size();
+  mysql_rwlock_unlock(&ldb_dropped_lock);
+}
+
+
+/**
+  @brief
+  Bytewise order plus the ShouldDrop() hook, which drops a table in O(1):
+  the keys of a dropped table disappear from reads at once and are
+  discarded by the compactions that come across them.
+*/
+
+class ldb_table_comparator: public leveldb::Comparator
+{
+public:
+  int Compare(const leveldb::Slice &a, const leveldb::Slice &b) const
+  {
+    return leveldb::BytewiseComparator()->Compare(a, b);
+  }
+  const char *Name() const
+  {
+    return "ldb.TableComparator";
+  }
+  void FindShortestSeparator(std::string *start,
+                             const leveldb::Slice &limit) const
+  {
+    leveldb::BytewiseComparator()->FindShortestSeparator(start, limit);
+  }
+  void FindShortSuccessor(std::string *key) const
+  {
+    leveldb::BytewiseComparator()->FindShortSuccessor(key);
+  }
+  /* Every key starts with the id of its table. */
+  bool ShouldDrop(const char *key, int64_t sequence, uint32_t now) const
+  {
+    return ldb_table_dropped(mi_uint4korr((const uchar*) key));
+  }
+};
+
+static ldb_table_comparator ldb_comparator;
+
+
+/**
+  @brief
+  Looks up the id of table name in the dictionary. Returns 0,
+  HA_ERR_NO_SUCH_TABLE or HA_ERR_INTERNAL_ERROR.
+*/
+
+static int ldb_lookup_table(const char *name, uint32 *table_id)
+{
+  std::string key;
+  std::string value;
+
+  ldb_dict_key(LDB_DICT_TABLE, name, strlen(name), key);
+  leveldb::Status s= ldb_db->Get(leveldb::ReadOptions(), key, &value);
+  if (s.IsNotFound())
+    return HA_ERR_NO_SUCH_TABLE;
+  if (!s.ok() || value.size() != LDB_TABLE_ID_LENGTH)
+    return HA_ERR_INTERNAL_ERROR;
+  *table_id= mi_uint4korr((const uchar*) value.data());
+  return 0;
+}
+
+
+/**
+  @brief
+  Builds the dictionary key of the statistics of table table_id.
+*/
+
+static void ldb_stats_key(uint32 table_id, std::string &key)
+{
+  char id[LDB_TABLE_ID_LENGTH];
+  mi_int4store(id, table_id);
+  ldb_dict_key(LDB_DICT_STATS, id, LDB_TABLE_ID_LENGTH, key);
+}
+
+
+/*
+  A statistics value is the row count and their size (8 bytes each), the
+  mean row length and then rec_per_key of every key part (4 bytes each).
+*/
+#define LDB_STATS_HEADER_LENGTH 20
+
+/**
+  @brief
+  Loads the statistics of the last ANALYZE TABLE into share, if there are
+  any for its current layout.
+*/
+
+static void ldb_load_stats(LEVELDB_SHARE *share)
+{
+  std::string key;
+  std::string value;
+
+  ldb_stats_key(share->table_id, key);
+  if (!ldb_db->Get(leveldb::ReadOptions(), key, &value).ok() ||
+      value.size() != LDB_STATS_HEADER_LENGTH + 4 * share->rec_per_key_count)
+    return;
+
+  const uchar *from= (const uchar*) value.data();
+  share->stats_records= (ha_rows) uint8korr(from);
+  share->stats_data_size= uint8korr(from + 8);
+  share->stats_mean_rec_length= uint4korr(from + 16);
+  from+= LDB_STATS_HEADER_LENGTH;
+  for (uint i= 0; i < share->rec_per_key_count; i++, from+= 4)
+    share->rec_per_key[i]= uint4korr(from);
+  share->stats_valid= true;
+}
+
+
+/**
+  @brief
+  Stores the statistics of share in the dictionary.
+  share->mutex must be held.
+*/
+
+static bool ldb_store_stats(LEVELDB_SHARE *share)
+{
+  std::string key;
+  std::string value(LDB_STATS_HEADER_LENGTH + 4 * share->rec_per_key_count,
+                    '\0');
+  uchar *to= (uchar*) &value[0];
+
+  int8store(to, (ulonglong) share->stats_records);
+  int8store(to + 8, share->stats_data_size);
+  int4store(to + 16, share->stats_mean_rec_length);
+  to+= LDB_STATS_HEADER_LENGTH;
+  for (uint i= 0; i < share->rec_per_key_count; i++, to+= 4)
+    int4store(to, share->rec_per_key[i]);
+
+  ldb_stats_key(share->table_id, key);
+  return !ldb_db->Put(wo, key, value).ok();
+}
+
+
+/**
+  @brief
+  Reads the table id counter and the dropped tables from the dictionary.
+  Dropped tables whose keys are all gone are forgotten.
+
+  @details
+  Runs before any id is in ldb_dropped_tables, so the probe iterator still
+  sees the keys of dropped tables.
+*/
+
+static bool ldb_load_dictionary()
+{
+  std::string key;
+  std::string value;
+  leveldb::WriteBatch purge;
+  leveldb::ReadOptions ro;
+
+  ldb_dict_key(LDB_DICT_NEXT_ID, "", 0, key);
+  leveldb::Status s= ldb_db->Get(ro, key, &value);
+  if (s.IsNotFound())
+    ldb_next_table_id= LDB_DICT_TABLE_ID + 1;
+  else if (s.ok() && value.size() == LDB_TABLE_ID_LENGTH)
+    ldb_next_table_id= mi_uint4korr((const uchar*) value.data());
+  else
+    return true;
+
+  key.clear();
+  ldb_dict_key(LDB_DICT_DROPPED, "", 0, key);
+  leveldb::Iterator *dict= ldb_db->NewIterator(ro);
+  leveldb::Iterator *probe= ldb_db->NewIterator(ro);
+  for (dict->Seek(key); dict->Valid() && dict->key().starts_with(key);
+       dict->Next())
+  {
+    leveldb::Slice prefix(dict->key());
+    prefix.remove_prefix(key.length());
+    if (prefix.size() != LDB_TABLE_ID_LENGTH)
+      continue;
+    probe->Seek(prefix);
+    if (probe->Valid() && probe->key().starts_with(prefix))
+      ldb_dropped_tables.insert(mi_uint4korr((const uchar*) prefix.data()));
+    else
+      purge.Delete(dict->key());
+  }
+  s= dict->status();
+  delete probe;
+  delete dict;
+  ldb_dropped_count= (uint32) ldb_dropped_tables.size();
+
+  if (s.ok())
+    s= ldb_db->Write(wo, &purge);
+  return !s.ok();
+}
+
+
 
 static int ldb_done_func(void *p)
 {
@@ -163,6 +578,30 @@ static int ldb_done_func(void *p)
     error= 1;
   my_hash_free(&ldb_open_tables);
   mysql_mutex_destroy(&ldb_mutex);
+  for (size_t i= 0; i < ldb_trx_pool.size(); i++)
+    delete ldb_trx_pool[i];
+  ldb_trx_pool.clear();
+
+  delete ldb_db;
+  ldb_db= NULL;
+  delete ldb_block_cache;
+  ldb_block_cache= NULL;
+  delete ldb_filter_policy;
+  ldb_filter_policy= NULL;
+  delete ldb_row_cache;
+  ldb_row_cache= NULL;
+  for (uint i= 0; i < LDB_ROW_CACHE_STRIPES; i++)
+    mysql_mutex_destroy(&ldb_row_cache_stripes[i].mutex);
+  for (uint i= 0; i < LDB_ROW_LOCK_STRIPES; i++)
+  {
+    mysql_mutex_destroy(&ldb_row_lock_stripes[i].mutex);
+    mysql_cond_destroy(&ldb_row_lock_stripes[i].cond);
+  }
+  mysql_mutex_destroy(&ldb_lock_wait_mutex);
+  mysql_cond_destroy(&ldb_lock_wait_cond);
+  ldb_dropped_tables.clear();
+  ldb_dropped_count= 0;
+  mysql_rwlock_destroy(&ldb_dropped_lock);
 
   DBUG_RETURN(error);
 }
@@ -181,6 +620,7 @@ static LEVELDB_SHARE *get_share(const char *table_name, TABLE *table)
   LEVELDB_SHARE *share;
   uint length;
   char *tmp_name;
+  ulong *rec_per_key;
 
   mysql_mutex_lock(&ldb_mutex);
   length=(uint) strlen(table_name);
@@ -193,18 +633,25 @@ static LEVELDB_SHARE *get_share(const char *table_name, TABLE *table)
           my_multi_malloc(MYF(MY_WME | MY_ZEROFILL),
                           &share, sizeof(*share),
                           &tmp_name, length+1,
+                          &rec_per_key,
+                          sizeof(ulong) * (table->s->key_parts + 1),
                           NullS)))
     {
       mysql_mutex_unlock(&ldb_mutex);
       return NULL;
     }
 
-    leveldb::Status s= leveldb_open(table_name, false, share->db);
+    if (ldb_lookup_table(table_name, &share->table_id))
+      goto error;
 
+    share->db= ldb_db;
     share->use_count=0;
     share->table_name_length=length;
     share->table_name=tmp_name;
     strmov(share->table_name,table_name);
+    share->rec_per_key= rec_per_key;
+    share->rec_per_key_count= table->s->key_parts;
+    ldb_load_stats(share);
     if (my_hash_insert(&ldb_open_tables, (uchar*) share))
       goto error;
     thr_lock_init(&share->lock);
@@ -217,7 +664,7 @@ static LEVELDB_SHARE *get_share(const char *table_name, TABLE *table)
   return share;
 
 error:
-  mysql_mutex_destroy(&share->mutex);
+  mysql_mutex_unlock(&ldb_mutex);
   my_free(share);
 
   return NULL;
@@ -235,8 +682,6 @@ static int free_share(LEVELDB_SHARE *share)
   mysql_mutex_lock(&ldb_mutex);
   if (!--share->use_count)
   {
-    delete share->db;
-    share->db= NULL;
     my_hash_delete(&ldb_open_tables, (uchar*) share);
     thr_lock_delete(&share->lock);
     mysql_mutex_destroy(&share->mutex);
@@ -254,644 +699,3695 @@ static handler* ldb_create_handler(handlerton *hton,
   return new (mem_root) ha_ldb(hton, table);
 }
 
-static void free_trx(handlerton *hton, trx_t *trx)
+
+static trx_t *get_trx(handlerton *hton, THD *thd)
 {
-  if (!trx)
-    trx= (trx_t*) thd_get_ha_data(current_thd, hton);
+  trx_t *trx= (trx_t*) thd_get_ha_data(thd, hton);
 
-  delete trx;
-  trx= NULL;
-  thd_set_ha_data(current_thd, hton, NULL);
+  if (!trx)
+  {
+    mysql_mutex_lock(&ldb_mutex);
+    if (!ldb_trx_pool.empty())
+    {
+      trx= ldb_trx_pool.back();
+      ldb_trx_pool.pop_back();
+    }
+    mysql_mutex_unlock(&ldb_mutex);
+    if (!trx)
+      trx= new trx_t();
+    thd_set_ha_data(thd, hton, trx);
+  }
+  return trx;
 }
 
-static int ldb_init_func(void *p)
-{
-  DBUG_ENTER("ldb_init_func");
-
-#ifdef HAVE_PSI_INTERFACE
-  init_ldb_psi_keys();
-#endif
 
-  ldb_hton= (handlerton *)p;
-  mysql_mutex_init(ex_key_mutex_ldb, &ldb_mutex, MY_MUTEX_INIT_FAST);
-  (void) my_hash_init(&ldb_open_tables,system_charset_info,32,0,0,
-                      (my_hash_get_key) ldb_get_key,0,0);
+/**
+  @brief
+  The row cache key of the leveldb key of a row, built on the stack unless
+  the key is long.
+*/
 
-  handlerton * hton = (handlerton*) p;
-  hton->state        = SHOW_OPTION_YES;
-  hton->db_type      = DB_TYPE_DEFAULT;
-  hton->create      = ldb_create_handler;
-  hton->show_status    = NULL;
-//  hton->flags        = HTON_CAN_RECREATE;
+class ldb_row_cache_key
+{
+public:
+  ldb_row_cache_key(const leveldb::Slice &key)
+  {
+    size= 4 + key.size();
+    data= size <= sizeof(space) ? space : new char[size];
+    int4store(data, ldb_row_cache_generation);
+    memcpy(data + 4, key.data(), key.size());
+  }
+  ~ldb_row_cache_key()
+  {
+    if (data != space)
+      delete [] data;
+  }
+  leveldb::Slice slice() const { return leveldb::Slice(data, size); }
+private:
+  char *data;
+  size_t size;
+  char space[128];
+};
 
-//  ldb_hton->state= SHOW_OPTION_YES;
-//  ldb_hton->create= ldb_create_handler;
-//  ldb_hton->commit= ldb_commit;
-//  ldb_hton->rollback= ldb_rollback;
 
-//  ldb_hton->flags=   HTON_CAN_RECREATE;
+/* FNV-1a hash of a leveldb key, which picks its row cache and lock stripes. */
 
-  DBUG_RETURN(0);
+static uint32 ldb_key_hash(const leveldb::Slice &key)
+{
+  uint32 hash= 2166136261U;
+  for (size_t i= 0; i < key.size(); i++)
+    hash= (hash ^ (uchar) key[i]) * 16777619U;
+  return hash;
 }
 
 
-ha_ldb::ha_ldb(handlerton *hton, TABLE_SHARE *table_arg)
-  :handler(hton, table_arg)
+static LDB_ROW_CACHE_STRIPE *ldb_row_cache_stripe(const leveldb::Slice &key)
 {
+  return ldb_row_cache_stripes + ldb_key_hash(key) % LDB_ROW_CACHE_STRIPES;
 }
 
 
-/**
-  @brief
-  If frm_error() is called then we will use this to determine
-  the file extensions that exist for the storage engine. This is also
-  used by the default rename_table and delete_table method in
-  handler.cc.
+/* The stripe seq, or ~0 (newer than every snapshot) during a commit. */
 
-  For engines that have two file name extentions (separate meta/index file
-  and data file), the order of elements is relevant. First element of engine
-  file name extentions array should be meta/index file extention. Second
-  element - data file extention. This order is assumed by
-  prepare_for_repair() when REPAIR TABLE ... USE_FRM is issued.
+static ulonglong ldb_row_cache_stripe_seq(LDB_ROW_CACHE_STRIPE *stripe)
+{
+  mysql_mutex_lock(&stripe->mutex);
+  ulonglong seq= stripe->writers ? ~(ulonglong) 0 : stripe->seq;
+  mysql_mutex_unlock(&stripe->mutex);
+  return seq;
+}
 
-  @see
-  rename_table method in handler.cc and
-  delete_table method in handler.cc
-*/
 
-static const char *ha_ldb_exts[] = {
-  NullS
-};
+/* Stops the caching of the rows of stripe before a commit writes to it. */
 
-const char **ha_ldb::bas_ext() const
+static void ldb_row_cache_begin_stripe(LDB_ROW_CACHE_STRIPE *stripe)
 {
-  return ha_ldb_exts;
+  mysql_mutex_lock(&stripe->mutex);
+  stripe->writers++;
+  mysql_mutex_unlock(&stripe->mutex);
 }
 
 
 /**
   @brief
-  Used for opening tables. The name will be the name of the file.
-
-  @details
-  A table is opened when it needs to be opened; e.g. when a request comes in
-  for a SELECT on the table (tables are not open and closed for each request,
-  they are cached).
-
-  Called from handler.cc by handler::ha_open(). The server opens all tables by
-  calling ha_open() which then calls the handler specific open().
-
-  @see
-  handler::ha_open() in handler.cc
+  Ends ldb_row_cache_begin_stripe() after the write: the stripe becomes
+  newer than every snapshot that cannot see the write.
 */
 
+static void ldb_row_cache_end_stripe(LDB_ROW_CACHE_STRIPE *stripe)
+{
+  ulonglong seq= ldb_db->GetLatestSequenceNumber();
+  mysql_mutex_lock(&stripe->mutex);
+  if (stripe->seq < seq)
+    stripe->seq= seq;
+  stripe->writers--;
+  mysql_mutex_unlock(&stripe->mutex);
+}
 
 
-int ha_ldb::open(const char *name, int mode, uint test_if_locked)
+static void ldb_delete_cached_row(const leveldb::Slice &key, void *value)
 {
-  DBUG_ENTER("ha_ldb::open");
-  if (!(share = get_share(name, table)))
-    DBUG_RETURN(1);
-  thr_lock_data_init(&share->lock,&lock,NULL);
-  
-  DBUG_RETURN(0);
+  delete (LDB_CACHED_ROW*) value;
 }
 
 
 /**
   @brief
-  Closes a table. We call the free_share() function to free any resources
-  that we have allocated in the "shared" structure.
+  Reads the stored row of key as of snapshot (the latest state if NULL),
+  from the row cache if it holds a row current for the snapshot. A row read
+  from the database is cached when no commit changed its stripe after the
+  snapshot.
 
   @details
-  Called from sql_base.cc, sql_select.cc, and table.cc. In sql_select.cc it is
-  only used to close up temporary tables or during the process where a
-  temporary table is converted over to being a myisam table.
-
-  For sql_base.cc look at close_data_tables().
-
-  @see
-  sql_base.cc, sql_select.cc and table.cc
+  A commit racing with the read either begins on the stripe before the row
+  is cached, which the check after the insert catches, or erases the key
+  after the insert. A cached row found after seq was taken was cached
+  before any commit that seq sees began, so it is older than such a commit
+  only if seq is too. The cache key is built after seq for the same reason
+  with respect to the generation.
 */
 
-int ha_ldb::close(void)
+static leveldb::Status ldb_row_cache_get(const leveldb::Snapshot *snapshot,
+                                         const leveldb::Slice &key,
+                                         std::string *value)
 {
-  DBUG_ENTER("ha_ldb::close");
-  DBUG_RETURN(free_share(share));
+  leveldb::ReadOptions ro;
+  LDB_ROW_CACHE_STRIPE *stripe= ldb_row_cache_stripe(key);
+  ulonglong seq= snapshot ? snapshot->sequence()
+                          : ldb_db->GetLatestSequenceNumber();
+  ldb_row_cache_key ckey(key);
+
+  leveldb::Cache::Handle *handle= ldb_row_cache->Lookup(ckey.slice());
+  if (handle)
+  {
+    LDB_CACHED_ROW *row= (LDB_CACHED_ROW*) ldb_row_cache->Value(handle);
+    bool current= seq >= row->valid_from;
+    if (current)
+      value->assign(row->value);
+    ldb_row_cache->Release(handle);
+    if (current)
+      return leveldb::Status::OK();
+  }
+
+  ulonglong valid_from= ldb_row_cache_stripe_seq(stripe);
+  ro.snapshot= snapshot;
+  leveldb::Status s= ldb_db->Get(ro, key, value);
+  if (!s.ok() || valid_from > seq)
+    return s;
+
+  LDB_CACHED_ROW *row= new LDB_CACHED_ROW;
+  row->valid_from= valid_from;
+  row->value.assign(*value);
+  handle= ldb_row_cache->Insert(ckey.slice(), row,
+                                ckey.slice().size() + value->size(),
+                                ldb_delete_cached_row);
+  ldb_row_cache->Release(handle);
+  if (ldb_row_cache_stripe_seq(stripe) != valid_from)
+    ldb_row_cache->Erase(ckey.slice());
+  return s;
 }
 
 
 /**
   @brief
-  write_row() inserts a row. No extra() hint is given currently if a bulk load
-  is happening. buf() is a byte array of data. You can use the field
-  information to extract the data from the native byte array type.
+  Drops the cached rows of the keys of a batch: before it is written
+  (written false), then again after the write.
+*/
 
-  @details
-  Example of this would be:
-  @code
-  for (Field **field=table->field ; *field ; field++)
+class ldb_row_cache_invalidator: public leveldb::WriteBatch::Handler
+{
+public:
+  ldb_row_cache_invalidator(bool written_arg) : written(written_arg) {}
+  void Put(const leveldb::Slice &key, const leveldb::Slice &value)
   {
-    ...
+    Delete(key);
   }
-  @endcode
-
-  See ha_tina.cc for an ldb of extracting all of the data as strings.
-  ha_berekly.cc has an ldb of how to store it intact by "packing" it
-  for ha_berkeley's own native storage type.
-
-  See the note for update_row() on auto_increments and timestamps. This
-  case also applies to write_row().
+  void Delete(const leveldb::Slice &key)
+  {
+    if (written)
+      ldb_row_cache_end_stripe(ldb_row_cache_stripe(key));
+    else
+      ldb_row_cache_begin_stripe(ldb_row_cache_stripe(key));
+    ldb_row_cache->Erase(ldb_row_cache_key(key).slice());
+  }
+private:
+  bool written;
+};
 
-  Called from item_sum.cc, item_sum.cc, sql_acl.cc, sql_insert.cc,
-  sql_insert.cc, sql_select.cc, sql_table.cc, sql_udf.cc, and sql_update.cc.
 
-  @see
-  item_sum.cc, item_sum.cc, sql_acl.cc, sql_insert.cc,
-  sql_insert.cc, sql_select.cc, sql_table.cc, sql_udf.cc and sql_update.cc
+/**
+  @brief
+  Invalidates every cached row, for changes made outside of transaction
+  batches: called before the change, and with written true after it.
 */
 
-void ha_ldb::get_key(uchar *buf, std::string &key)
+static void ldb_row_cache_invalidate_all(bool written)
 {
-  KEY_PART_INFO *key_part= table->key_info[0].key_part;
-  int bit_start= 0;
-
-  if (key_part->type == HA_KEYTYPE_VARTEXT1 || key_part->type == HA_KEYTYPE_VARBINARY1)
-    bit_start= 1;
-  if (key_part->type == HA_KEYTYPE_VARTEXT2 || key_part->type == HA_KEYTYPE_VARBINARY2)
-    bit_start= 2;
-
-  key.append((char*)buf+key_part->offset+bit_start, key_part->length);
- 
-}
-
-int ha_ldb::write_row(uchar *buf)
-{
-  DBUG_ENTER("ha_ldb::write_row");
-
-  std::string key;
-  std::string value;
-
-  get_key(buf, key);
-
-  size_t raw_len= table->s->rec_buff_length;
-  size_t compressed_len= 0;
-
-  if (my_compress(buf, &raw_len, &compressed_len))
+  if (!ldb_row_cache)
+    return;
+  if (!written)
   {
-    compressed_len= raw_len;
+    mysql_mutex_lock(&ldb_mutex);
+    ldb_row_cache_generation++;
+    mysql_mutex_unlock(&ldb_mutex);
+  }
+  for (uint i= 0; i < LDB_ROW_CACHE_STRIPES; i++)
+  {
+    if (written)
+      ldb_row_cache_end_stripe(ldb_row_cache_stripes + i);
+    else
+      ldb_row_cache_begin_stripe(ldb_row_cache_stripes + i);
   }
-
-  value.append((char*)buf, raw_len);
-
-  trx_t *trx= (trx_t*)thd_get_ha_data(current_thd, ldb_hton);
-  trx->batch.Put(key, value);
-
-  DBUG_RETURN(0);
 }
 
 
 /**
   @brief
-  Yes, update_row() does what you expect, it updates a row. old_data will have
-  the previous row record in it, while new_data will have the newest data in it.
-  Keep in mind that the server can do updates based on ordering if an ORDER BY
-  clause was used. Consecutive ordering is not guaranteed.
+  Records that trx waits for owner, unless owner waits for trx, directly
+  or through other transactions. Returns true for such a deadlock.
 
   @details
-  Currently new_data will not have an updated auto_increament record, or
-  and updated timestamp field. You can do these for ldb by doing:
-  @code
-  if (table->timestamp_field_type & TIMESTAMP_AUTO_SET_ON_UPDATE)
-    table->timestamp_field->set_time();
-  if (table->next_number_field && record == table->record[0])
-    update_auto_increment();
-  @endcode
-
-  Called from sql_select.cc, sql_acl.cc, sql_update.cc, and sql_insert.cc.
-
-  @see
-  sql_select.cc, sql_acl.cc, sql_update.cc and sql_insert.cc
+  The transactions of the chain are alive: owner cannot free its locks
+  while the caller holds the mutex of the stripe of one of them, and a
+  transaction waited for is not freed, see free_trx().
 */
-int ha_ldb::update_row(const uchar *old_data, uchar *new_data)
-{
 
-  DBUG_ENTER("ha_ldb::update_row");
-
-  std::string old_key;
-  std::string new_key;
-
-  get_key((uchar*) old_data, old_key);
-  get_key((uchar*) new_data, new_key);
-  
-  trx_t *trx= (trx_t*)thd_get_ha_data(current_thd, ldb_hton);
+static bool ldb_lock_wait_begin(trx_t *trx, trx_t *owner)
+{
+  bool deadlock= false;
+  uint depth= 0;
 
-  if (old_key.compare(new_key) != 0)
+  mysql_mutex_lock(&ldb_lock_wait_mutex);
+  for (trx_t *t= owner; t && depth < LDB_LOCK_WAIT_MAX_DEPTH;
+       t= t->lock_wait_owner, depth++)
   {
-    trx->batch.Delete(old_key);
+    if (t == trx)
+    {
+      deadlock= true;
+      break;
+    }
+  }
+  if (!deadlock)
+  {
+    trx->lock_wait_owner= owner;
+    owner->lock_waiters++;
   }
+  mysql_mutex_unlock(&ldb_lock_wait_mutex);
+  return deadlock;
+}
 
-  write_row(new_data);
 
-  DBUG_RETURN(0);
+static void ldb_lock_wait_end(trx_t *trx)
+{
+  mysql_mutex_lock(&ldb_lock_wait_mutex);
+  if (!--trx->lock_wait_owner->lock_waiters)
+    mysql_cond_broadcast(&ldb_lock_wait_cond);
+  trx->lock_wait_owner= NULL;
+  mysql_mutex_unlock(&ldb_lock_wait_mutex);
 }
 
 
 /**
   @brief
-  This will delete a row. buf will contain a copy of the row to be deleted.
-  The server will call this right after the current row has been called (from
-  either a previous rnd_nexT() or index call).
+  Locks the row of primary key key (or a unique secondary value) for trx,
+  waiting for the transaction that holds it. Returns 0,
+  HA_ERR_LOCK_DEADLOCK if the holder waits for trx, or
+  HA_ERR_LOCK_WAIT_TIMEOUT after lock_wait_timeout seconds or when the
+  session is killed meanwhile.
 
   @details
-  If you keep a pointer to the last row or can access a primary key it will
-  make doing the deletion quite a bit easier. Keep in mind that the server does
-  not guarantee consecutive deletions. ORDER BY clauses can be used.
-
-  Called in sql_acl.cc and sql_udf.cc to manage internal table
-  information.  Called in sql_delete.cc, sql_insert.cc, and
-  sql_select.cc. In sql_select it is used for removing duplicates
-  while in insert it is used for REPLACE calls.
-
-  @see
-  sql_acl.cc, sql_udf.cc, sql_delete.cc, sql_insert.cc and sql_select.cc
+  A deadlock victim is marked for a full rollback: rolling back only the
+  statement would keep the row locks the other transaction waits for.
+  KILL does not signal stripe->cond, so the wait is cut into slices after
+  which thd_killed() is checked again.
 */
 
-int ha_ldb::delete_row(const uchar *buf)
+static int ldb_lock_row(THD *thd, trx_t *trx, const std::string &key)
 {
-  DBUG_ENTER("ha_ldb::delete_row");
+  LDB_ROW_LOCK_STRIPE *stripe= ldb_row_lock_stripes +
+                               ldb_key_hash(key) % LDB_ROW_LOCK_STRIPES;
+  struct timespec abstime;
+  int rc= 0;
+
+  set_timespec(abstime, THDVAR(thd, lock_wait_timeout));
+  mysql_mutex_lock(&stripe->mutex);
+  for (;;)
+  {
+    std::map<std::string, trx_t*>::iterator it= stripe->owners.find(key);
+    if (it == stripe->owners.end())
+    {
+      stripe->owners.insert(std::make_pair(key, trx));
+      /* The key strings of earlier transactions are reused. */
+      if (trx->row_lock_count < trx->row_locks.size())
+        trx->row_locks[trx->row_lock_count].assign(key);
+      else
+        trx->row_locks.push_back(key);
+      trx->row_lock_count++;
+      break;
+    }
+    if (it->second == trx)
+      break;
+    if (thd_killed(thd))
+    {
+      rc= HA_ERR_LOCK_WAIT_TIMEOUT;
+      break;
+    }
+    if (ldb_lock_wait_begin(trx, it->second))
+    {
+      thd_mark_transaction_to_rollback(thd, TRUE);
+      rc= HA_ERR_LOCK_DEADLOCK;
+      break;
+    }
+    struct timespec slice;
+    set_timespec(slice, LDB_LOCK_WAIT_SLICE);
+    bool last_slice= cmp_timespec(slice, abstime) >= 0;
+    int wait= mysql_cond_timedwait(&stripe->cond, &stripe->mutex,
+                                   last_slice ? &abstime : &slice);
+    ldb_lock_wait_end(trx);
+    if (wait == ETIMEDOUT && last_slice)
+    {
+      it= stripe->owners.find(key);
+      if (it != stripe->owners.end() && it->second != trx)
+      {
+        rc= HA_ERR_LOCK_WAIT_TIMEOUT;
+        break;
+      }
+    }
+  }
+  mysql_mutex_unlock(&stripe->mutex);
+  return rc;
+}
 
-  std::string key;
-  get_key((uchar*)buf, key);
 
-  trx_t *trx= (trx_t*)thd_get_ha_data(current_thd, ldb_hton);
-  trx->batch.Delete(key);
+/* Frees the row locks of trx once its changes are written or discarded. */
 
-  DBUG_RETURN(0);
+static void ldb_release_row_locks(trx_t *trx)
+{
+  for (size_t i= 0; i < trx->row_lock_count; i++)
+  {
+    const std::string &key= trx->row_locks[i];
+    LDB_ROW_LOCK_STRIPE *stripe= ldb_row_lock_stripes +
+                                 ldb_key_hash(key) % LDB_ROW_LOCK_STRIPES;
+    mysql_mutex_lock(&stripe->mutex);
+    stripe->owners.erase(key);
+    mysql_cond_broadcast(&stripe->cond);
+    mysql_mutex_unlock(&stripe->mutex);
+  }
+  trx->row_lock_count= 0;
+  /* A large transaction does not leave all its key strings behind. */
+  if (trx->row_locks.size() > LDB_TRX_KEPT_ROW_LOCKS)
+    std::vector<std::string>(trx->row_locks.begin(),
+                             trx->row_locks.begin() +
+                             LDB_TRX_KEPT_ROW_LOCKS).swap(trx->row_locks);
 }
 
 
+/* Replays a write batch into the bulk load of a spilling transaction. */
+
+class ldb_spill_writer: public leveldb::WriteBatch::Handler
+{
+public:
+  ldb_spill_writer(leveldb::BulkLoad *spill_arg) : spill(spill_arg) {}
+  void Put(const leveldb::Slice &key, const leveldb::Slice &value)
+  {
+    spill->Add(key, value);
+  }
+  void Delete(const leveldb::Slice &key)
+  {
+    spill->Delete(key);
+  }
+private:
+  leveldb::BulkLoad *spill;
+};
+
+
 /**
   @brief
-  Positions an index cursor to the index specified in the handle. Fetches the
-  row if available. If the key value is null, begin at the first key of the
-  index.
+  Moves the changes in the batch of trx to trx->spill, which is created
+  first if needed, and empties the batch.
 */
-int ha_ldb::index_read(uchar *buf, const uchar *key, uint key_len, ha_rkey_function find_flag)
+
+static leveldb::Status ldb_spill_batch(trx_t *trx)
 {
-  DBUG_ENTER("ha_ldb::index_read");
+  if (!trx->spill)
+    trx->spill= ldb_db->NewBulkLoad(wo, (size_t) ldb_trx_spill_size, true);
+  ldb_spill_writer writer(trx->spill);
+  leveldb::Status s= trx->batch.GetWriteBatch()->Iterate(&writer);
+  trx->batch.Clear();
+  return s.ok() ? trx->spill->status() : s;
+}
 
-  std::string skey;
-  std::string svalue;
-  int bit_start= table->key_info[0].key_part[0].key_part_flag & HA_VAR_LENGTH_PART ? 2 : 0;
 
-  skey.append((char*)(key+bit_start), key_len-bit_start);
-  leveldb::Status s = share->db->Get(leveldb::ReadOptions(), skey, &svalue);
+/**
+  @brief
+  Writes the changes of a transaction that spilled: the spilled table
+  files and the rest of its batch are added to the database at once.
 
-  if (!s.ok())
-    DBUG_RETURN(HA_ERR_END_OF_FILE);
+  @details
+  If their key range has recent writes, leveldb writes them through the
+  memtable in bounded batches instead. The row locks of the transaction,
+  released after this, keep other writers off the keys meanwhile.
+*/
 
-  memcpy(buf, svalue.c_str(), svalue.length());
+static int ldb_commit_spill(trx_t *trx)
+{
+  leveldb::Status s= ldb_spill_batch(trx);
+  /* The spilled keys are not known any more. */
+  ldb_row_cache_invalidate_all(false);
+  if (s.ok())
+    s= trx->spill->Finish();
+  ldb_row_cache_invalidate_all(true);
+  delete trx->spill;
+  trx->spill= NULL;
+  return s.ok() ? 0 : HA_ERR_INTERNAL_ERROR;
+}
 
-  size_t uncomlen= table->s->rec_buff_length;
-  size_t comlen= svalue.length();
-  my_uncompress(buf, comlen, &uncomlen);
-  
 
-  table->status= 0;
-  DBUG_RETURN(0);
+static void ldb_set_savepoint(trx_t *trx, LDB_SAVEPOINT *sv)
+{
+  sv->batch_size= trx->batch.ApproximateSize();
+  sv->batch_count= trx->batch.Count();
 }
 
 
 /**
   @brief
-  Used to read forward through the index.
+  Starts a statement: registers it with the server and marks where a
+  failed statement rolls back to. A multi-statement transaction is
+  registered too and keeps one write batch until it ends.
+
+  @details
+  The statement reads from trx->snapshot, which is taken here unless the
+  transaction already has one. Readers and writers never wait for each
+  other: a statement sees the DB as of its snapshot, whatever is written
+  meanwhile.
 */
 
-int ha_ldb::index_next(uchar *buf)
+static void ldb_register_stmt(THD *thd, trx_t *trx)
 {
-  DBUG_ENTER("ha_ldb::index_next");
-  table->status= STATUS_NOT_FOUND;
-  DBUG_RETURN(HA_ERR_END_OF_FILE);
+  ldb_set_savepoint(trx, &trx->stmt_savepoint);
+  if (!trx->snapshot)
+    trx->snapshot= ldb_db->GetSnapshot();
+  trans_register_ha(thd, FALSE, ldb_hton);
+  if (thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN))
+    trans_register_ha(thd, TRUE, ldb_hton);
 }
 
 
 /**
   @brief
-  Used to read backwards through the index.
+  Releases the snapshot of trx at the end of the transaction (all) or of
+  a statement. Under REPEATABLE READ and SERIALIZABLE a multi-statement
+  transaction keeps the snapshot of its first statement until it ends.
 */
 
-int ha_ldb::index_prev(uchar *buf)
+static void ldb_release_snapshot(THD *thd, trx_t *trx, bool all)
 {
-  int rc;
-  DBUG_ENTER("ha_ldb::index_prev");
-  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
-  rc= HA_ERR_WRONG_COMMAND;
-  MYSQL_INDEX_READ_ROW_DONE(rc);
-  DBUG_RETURN(rc);
+  if (trx->snapshot &&
+      (all || !thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN) ||
+       thd_tx_isolation(thd) <= ISO_READ_COMMITTED))
+  {
+    ldb_db->ReleaseSnapshot(trx->snapshot);
+    trx->snapshot= NULL;
+  }
 }
 
 
 /**
   @brief
-  index_first() asks for the first key in the index.
-
-  @details
-  Called from opt_range.cc, opt_sum.cc, sql_handler.cc, and sql_select.cc.
-
-  @see
-  opt_range.cc, opt_sum.cc, sql_handler.cc and sql_select.cc
+  START TRANSACTION WITH CONSISTENT SNAPSHOT: the transaction reads as of
+  now, even the tables it has not used yet.
 */
-int ha_ldb::index_first(uchar *buf)
+
+static int ldb_start_consistent_snapshot(handlerton *hton, THD *thd)
 {
-  int rc;
-  DBUG_ENTER("ha_ldb::index_first");
-  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
-  rc= HA_ERR_WRONG_COMMAND;
-  MYSQL_INDEX_READ_ROW_DONE(rc);
-  DBUG_RETURN(rc);
+  trx_t *trx= get_trx(hton, thd);
+  DBUG_ENTER("ldb_start_consistent_snapshot");
+
+  if (!trx->snapshot)
+    trx->snapshot= ldb_db->GetSnapshot();
+  trans_register_ha(thd, TRUE, hton);
+  DBUG_RETURN(0);
 }
 
 
 /**
   @brief
-  index_last() asks for the last key in the index.
+  Commits the transaction (all) or the statement. A statement inside a
+  multi-statement transaction only leaves its changes in the batch.
 
   @details
-  Called from opt_range.cc, opt_sum.cc, sql_handler.cc, and sql_select.cc.
-
-  @see
-  opt_range.cc, opt_sum.cc, sql_handler.cc and sql_select.cc
+  The batch is written with a synced write. DBImpl::Write() queues
+  concurrent committers, and the one at the head of the queue writes and
+  syncs the batches of all of them at once. The changes of a statement
+  that spilled (see ha_ldb::spill_batch()) are added as a bulk load.
 */
-int ha_ldb::index_last(uchar *buf)
+
+static int ldb_commit(handlerton *hton, THD *thd, bool all)
 {
-  int rc;
-  DBUG_ENTER("ha_ldb::index_last");
-  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
-  rc= HA_ERR_WRONG_COMMAND;
-  MYSQL_INDEX_READ_ROW_DONE(rc);
+  int rc= 0;
+  trx_t *trx= (trx_t*) thd_get_ha_data(thd, hton);
+  DBUG_ENTER("ldb_commit");
+
+  if (!trx)
+    DBUG_RETURN(0);
+  if (all || !thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN))
+  {
+    if (trx->spill)
+      rc= ldb_commit_spill(trx);
+    else if (trx->batch.Count())
+    {
+      bool cached= ldb_row_cache != NULL;
+      if (cached)
+      {
+        ldb_row_cache_invalidator invalidator(false);
+        trx->batch.GetWriteBatch()->Iterate(&invalidator);
+      }
+      if (!ldb_db->Write(wo, trx->batch.GetWriteBatch()).ok())
+        rc= HA_ERR_INTERNAL_ERROR;
+      if (cached)
+      {
+        /* Even a failed write may have reached the memtable. */
+        ldb_row_cache_invalidator invalidator(true);
+        trx->batch.GetWriteBatch()->Iterate(&invalidator);
+      }
+    }
+    trx->batch.Clear();
+    ldb_release_row_locks(trx);
+  }
+  ldb_release_snapshot(thd, trx, all);
   DBUG_RETURN(rc);
 }
 
 
-/**
-  @brief
-  rnd_init() is called when the system wants the storage engine to do a table
-  scan. See the ldb in the introduction at the top of this file to see when
-  rnd_init() is called.
-
-  @details
-  Called from filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc,
-  and sql_update.cc.
-
-  @see
-  filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc and sql_update.cc
-*/
-int ha_ldb::rnd_init(bool scan)
+static int ldb_rollback(handlerton *hton, THD *thd, bool all)
 {
-  DBUG_ENTER("ha_ldb::rnd_init");
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  trx_t *trx= (trx_t*) thd_get_ha_data(thd, hton);
+  DBUG_ENTER("ldb_rollback");
+
+  if (!trx)
+    DBUG_RETURN(0);
+  if (all || !thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN))
+  {
+    trx->batch.Clear();
+    /* The spilled files are removed unused. */
+    delete trx->spill;
+    trx->spill= NULL;
+    ldb_release_row_locks(trx);
+  }
+  else
+    trx->batch.RollbackTo(trx->stmt_savepoint.batch_size,
+                          trx->stmt_savepoint.batch_count);
+  ldb_release_snapshot(thd, trx, all);
+  DBUG_RETURN(0);
 }
 
-int ha_ldb::rnd_end()
+
+static int ldb_savepoint_set(handlerton *hton, THD *thd, void *sv)
 {
-  DBUG_ENTER("ha_ldb::rnd_end");
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  DBUG_ENTER("ldb_savepoint_set");
+  ldb_set_savepoint(get_trx(hton, thd), (LDB_SAVEPOINT*) sv);
+  DBUG_RETURN(0);
 }
 
 
-/**
-  @brief
-  This is called for each row of the table scan. When you run out of records
-  you should return HA_ERR_END_OF_FILE. Fill buff up with the row information.
-  The Field structure for the table is the key to getting data into buf
-  in a manner that will allow the server to understand it.
+static int ldb_savepoint_rollback(handlerton *hton, THD *thd, void *sv)
+{
+  LDB_SAVEPOINT *savepoint= (LDB_SAVEPOINT*) sv;
+  DBUG_ENTER("ldb_savepoint_rollback");
+  get_trx(hton, thd)->batch.RollbackTo(savepoint->batch_size,
+                                       savepoint->batch_count);
+  DBUG_RETURN(0);
+}
 
-  @details
-  Called from filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc,
-  and sql_update.cc.
 
-  @see
-  filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc and sql_update.cc
-*/
-int ha_ldb::rnd_next(uchar *buf)
+static int ldb_savepoint_release(handlerton *hton, THD *thd, void *sv)
 {
-  DBUG_ENTER("ha_ldb::rnd_next");
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  return 0;
 }
 
 
 /**
   @brief
-  position() is called after each call to rnd_next() if the data needs
-  to be ordered. You can do something like the following to store
-  the position:
-  @code
-  my_store_ptr(ref, ref_length, current_position);
-  @endcode
+  Ends the transaction of a closing connection and puts trx_t back in
+  ldb_trx_pool for the next connection, unless the pool is full.
+*/
 
-  @details
-  The server uses ref to store data. ref_length in the above case is
-  the size needed to store current_position. ref is just a byte array
-  that the server will maintain. If you are using offsets to mark rows, then
-  current_position should be the offset. If it is a primary key like in
-  BDB, then it needs to be a primary key.
+static void free_trx(handlerton *hton, THD *thd)
+{
+  trx_t *trx= (trx_t*) thd_get_ha_data(thd, hton);
 
-  Called from filesort.cc, sql_select.cc, sql_delete.cc, and sql_update.cc.
+  if (!trx)
+    return;
+  if (trx->snapshot)
+    ldb_db->ReleaseSnapshot(trx->snapshot);
+  trx->snapshot= NULL;
+  delete trx->spill;
+  trx->spill= NULL;
+  trx->batch.Clear();
+  trx->tables_in_use= 0;
+  ldb_release_row_locks(trx);
+  /* The woken waiters still point at trx until they leave their wait. */
+  mysql_mutex_lock(&ldb_lock_wait_mutex);
+  while (trx->lock_waiters)
+    mysql_cond_wait(&ldb_lock_wait_cond, &ldb_lock_wait_mutex);
+  mysql_mutex_unlock(&ldb_lock_wait_mutex);
+  thd_set_ha_data(thd, hton, NULL);
 
-  @see
-  filesort.cc, sql_select.cc, sql_delete.cc and sql_update.cc
-*/
-void ha_ldb::position(const uchar *record)
-{
-  DBUG_ENTER("ha_ldb::position");
-  DBUG_VOID_RETURN;
+  mysql_mutex_lock(&ldb_mutex);
+  if (ldb_trx_pool.size() < LDB_TRX_POOL_SIZE)
+  {
+    ldb_trx_pool.push_back(trx);
+    trx= NULL;
+  }
+  mysql_mutex_unlock(&ldb_mutex);
+  delete trx;
 }
 
 
-/**
-  @brief
-  This is like rnd_next, but you are given a position to use
-  to determine the row. The position will be of the type that you stored in
-  ref. You can use ha_get_ptr(pos,ref_length) to retrieve whatever key
-  or position you saved when position() was called.
-
-  @details
-  Called from filesort.cc, records.cc, sql_insert.cc, sql_select.cc, and sql_update.cc.
+static int ldb_close_connection(handlerton *hton, THD *thd)
+{
+  free_trx(hton, thd);
+  return 0;
+}
 
-  @see
-  filesort.cc, records.cc, sql_insert.cc, sql_select.cc and sql_update.cc
+/**
+  @brief
+  SHOW ENGINE LEVELDB STATUS: the per-level table of leveldb.stats, the
+  memtables and the counters of DB::GetStats() and of the block and row
+  caches.
 */
-int ha_ldb::rnd_pos(uchar *buf, uchar *pos)
+
+static bool ldb_show_status(handlerton *hton, THD *thd,
+                            stat_print_fn *stat_print,
+                            enum ha_stat_type stat_type)
 {
-  int rc;
-  DBUG_ENTER("ha_ldb::rnd_pos");
-  MYSQL_READ_ROW_START(table_share->db.str, table_share->table_name.str,
-                       TRUE);
-  rc= HA_ERR_WRONG_COMMAND;
-  MYSQL_READ_ROW_DONE(rc);
-  DBUG_RETURN(rc);
+  std::string status;
+  std::string levels;
+  leveldb::DBStats stats;
+  char buf[512];
+
+  if (stat_type != HA_ENGINE_STATUS || !ldb_db)
+    return FALSE;
+
+  ldb_db->GetProperty("leveldb.stats", &levels);
+  ldb_db->GetStats(&stats);
+
+  status.append("\n------\nLEVELS\n------\n");
+  status.append(levels);
+
+  snprintf(buf, sizeof(buf),
+           "---------\nMEMTABLES\n---------\n"
+           "%llu memtables (bucket memtables included), %llu immutable, "
+           "%llu bytes\n",
+           (ulonglong) stats.memtables, (ulonglong) stats.immutable_memtables,
+           (ulonglong) stats.memtable_bytes);
+  status.append(buf);
+
+  snprintf(buf, sizeof(buf),
+           "------\nWRITES\n------\n"
+           "%llu log writes carrying %llu batches, %llu bytes\n"
+           "Tables written: %llu bytes by flushes, %llu by compactions, "
+           "%llu by bulk loads\n"
+           "Compactions read %llu bytes\n"
+           "Syncs: %llu log, %llu table, %llu manifest\n"
+           "Write stalls: %llu slowdowns, %llu stops, %.3f sec\n",
+           (ulonglong) stats.write_groups,
+           (ulonglong) stats.write_group_batches,
+           (ulonglong) stats.log_bytes,
+           (ulonglong) stats.flush_bytes,
+           (ulonglong) stats.compaction_bytes_written,
+           (ulonglong) stats.bulk_load_bytes,
+           (ulonglong) stats.compaction_bytes_read,
+           (ulonglong) stats.log_syncs, (ulonglong) stats.table_syncs,
+           (ulonglong) stats.manifest_syncs,
+           (ulonglong) stats.write_slowdowns, (ulonglong) stats.write_stops,
+           stats.stall_micros / 1e6);
+  status.append(buf);
+
+  if (ldb_block_cache)
+  {
+    snprintf(buf, sizeof(buf),
+             "-----------\nBLOCK CACHE\n-----------\n"
+             "%llu hits, %llu misses, %llu bytes in use\n",
+             (ulonglong) ldb_block_cache->Hits(),
+             (ulonglong) ldb_block_cache->Misses(),
+             (ulonglong) ldb_block_cache->TotalCharge());
+    status.append(buf);
+  }
+
+  if (ldb_row_cache)
+  {
+    snprintf(buf, sizeof(buf),
+             "---------\nROW CACHE\n---------\n"
+             "%llu hits, %llu misses, %llu bytes in use\n",
+             (ulonglong) ldb_row_cache->Hits(),
+             (ulonglong) ldb_row_cache->Misses(),
+             (ulonglong) ldb_row_cache->TotalCharge());
+    status.append(buf);
+  }
+
+  return stat_print(thd, STRING_WITH_LEN("LEVELDB"), STRING_WITH_LEN(""),
+                    status.data(), (uint) status.size());
 }
 
 
-/**
-  @brief
-  ::info() is used to return information to the optimizer. See my_base.h for
-  the complete description.
+static int ldb_init_func(void *p)
+{
+  DBUG_ENTER("ldb_init_func");
 
-  @details
-  Currently this table handler doesn't implement most of the fields really needed.
-  SHOW also makes use of this data.
+#ifdef HAVE_PSI_INTERFACE
+  init_ldb_psi_keys();
+#endif
 
-  You will probably want to have the following in your code:
-  @code
-  if (records < 2)
-    records = 2;
-  @endcode
-  The reason is that the server will optimize for cases of only a single
-  record. If, in a table scan, you don't know the number of records, it
-  will probably be better to set records to two so you can return as many
-  records as you need. Along with records, a few more variables you may wish
-  to set are:
-    records
-    deleted
-    data_file_length
-    index_file_length
-    delete_length
-    check_time
-  Take a look at the public variables in handler.h for more information.
+  ldb_hton= (handlerton *)p;
+  mysql_mutex_init(ex_key_mutex_ldb, &ldb_mutex, MY_MUTEX_INIT_FAST);
+  (void) my_hash_init(&ldb_open_tables,system_charset_info,32,0,0,
+                      (my_hash_get_key) ldb_get_key,0,0);
+  mysql_rwlock_init(ex_key_rwlock_ldb_dropped, &ldb_dropped_lock);
+  for (uint i= 0; i < LDB_ROW_CACHE_STRIPES; i++)
+  {
+    mysql_mutex_init(ex_key_mutex_ldb_row_cache_stripe,
+                     &ldb_row_cache_stripes[i].mutex, MY_MUTEX_INIT_FAST);
+    ldb_row_cache_stripes[i].seq= 0;
+    ldb_row_cache_stripes[i].writers= 0;
+  }
+  for (uint i= 0; i < LDB_ROW_LOCK_STRIPES; i++)
+  {
+    mysql_mutex_init(ex_key_mutex_ldb_row_lock_stripe,
+                     &ldb_row_lock_stripes[i].mutex, MY_MUTEX_INIT_FAST);
+    mysql_cond_init(ex_key_cond_ldb_row_lock_stripe,
+                    &ldb_row_lock_stripes[i].cond, NULL);
+  }
+  mysql_mutex_init(ex_key_mutex_ldb_lock_wait, &ldb_lock_wait_mutex,
+                   MY_MUTEX_INIT_FAST);
+  mysql_cond_init(ex_key_cond_ldb_lock_wait, &ldb_lock_wait_cond, NULL);
+  if (ldb_row_cache_size)
+    ldb_row_cache= leveldb::NewLRUCache((size_t) ldb_row_cache_size);
+
+  if (!leveldb_open(ldb_data_home_dir, true, ldb_db).ok() ||
+      ldb_load_dictionary())
+  {
+    sql_print_error("LEVELDB: cannot open the data directory %s",
+                    ldb_data_home_dir);
+    delete ldb_db;
+    ldb_db= NULL;
+    delete ldb_block_cache;
+    ldb_block_cache= NULL;
+    delete ldb_filter_policy;
+    ldb_filter_policy= NULL;
+    delete ldb_row_cache;
+    ldb_row_cache= NULL;
+    for (uint i= 0; i < LDB_ROW_CACHE_STRIPES; i++)
+      mysql_mutex_destroy(&ldb_row_cache_stripes[i].mutex);
+    for (uint i= 0; i < LDB_ROW_LOCK_STRIPES; i++)
+    {
+      mysql_mutex_destroy(&ldb_row_lock_stripes[i].mutex);
+      mysql_cond_destroy(&ldb_row_lock_stripes[i].cond);
+    }
+    mysql_mutex_destroy(&ldb_lock_wait_mutex);
+    mysql_cond_destroy(&ldb_lock_wait_cond);
+    my_hash_free(&ldb_open_tables);
+    mysql_mutex_destroy(&ldb_mutex);
+    mysql_rwlock_destroy(&ldb_dropped_lock);
+    DBUG_RETURN(1);
+  }
 
-  Called in filesort.cc, ha_heap.cc, item_sum.cc, opt_sum.cc, sql_delete.cc,
-  sql_delete.cc, sql_derived.cc, sql_select.cc, sql_select.cc, sql_select.cc,
-  sql_select.cc, sql_select.cc, sql_show.cc, sql_show.cc, sql_show.cc, sql_show.cc,
-  sql_table.cc, sql_union.cc, and sql_update.cc.
+  handlerton * hton = (handlerton*) p;
+  hton->state        = SHOW_OPTION_YES;
+  hton->db_type      = DB_TYPE_DEFAULT;
+  hton->create      = ldb_create_handler;
+  hton->show_status    = ldb_show_status;
+  hton->commit       = ldb_commit;
+  hton->rollback     = ldb_rollback;
+  hton->savepoint_offset= sizeof(LDB_SAVEPOINT);
+  hton->savepoint_set= ldb_savepoint_set;
+  hton->savepoint_rollback= ldb_savepoint_rollback;
+  hton->savepoint_release= ldb_savepoint_release;
+  hton->start_consistent_snapshot= ldb_start_consistent_snapshot;
+  hton->close_connection= ldb_close_connection;
+//  hton->flags        = HTON_CAN_RECREATE;
+
+  DBUG_RETURN(0);
+}
+
+
+ha_ldb::ha_ldb(handlerton *hton, TABLE_SHARE *table_arg)
+  :handler(hton, table_arg), snapshot(NULL), scan_iter(NULL),
+   index_iter(NULL), point_read(false), keyread(false), scan_fill_cache(true),
+   write_can_replace(false), scan_cond(NULL), icp_cond(NULL), icp_keyno(MAX_KEY),
+   scan_batch_count(0), scan_batch_pos(0),
+   mrr_batched(false), mrr_batch_count(0), mrr_batch_pos(0), key_defs(NULL),
+   row_fields(NULL), bulk_load(NULL), dup_key(MAX_KEY)
+{
+}
+
+
+/**
+  @brief
+  If frm_error() is called then we will use this to determine
+  the file extensions that exist for the storage engine. This is also
+  used by the default rename_table and delete_table method in
+  handler.cc.
+
+  For engines that have two file name extentions (separate meta/index file
+  and data file), the order of elements is relevant. First element of engine
+  file name extentions array should be meta/index file extention. Second
+  element - data file extention. This order is assumed by
+  prepare_for_repair() when REPAIR TABLE ... USE_FRM is issued.
 
   @see
-  filesort.cc, ha_heap.cc, item_sum.cc, opt_sum.cc, sql_delete.cc, sql_delete.cc,
-  sql_derived.cc, sql_select.cc, sql_select.cc, sql_select.cc, sql_select.cc,
-  sql_select.cc, sql_show.cc, sql_show.cc, sql_show.cc, sql_show.cc, sql_table.cc,
-  sql_union.cc and sql_update.cc
+  rename_table method in handler.cc and
+  delete_table method in handler.cc
 */
-int ha_ldb::info(uint flag)
+
+static const char *ha_ldb_exts[] = {
+  NullS
+};
+
+const char **ha_ldb::bas_ext() const
 {
-  DBUG_ENTER("ha_ldb::info");
-  DBUG_RETURN(0);
+  return ha_ldb_exts;
 }
 
 
 /**
   @brief
-  extra() is called whenever the server wishes to send a hint to
-  the storage engine. The myisam engine implements the most hints.
-  ha_innodb.cc has the most exhaustive list of these hints.
+  Generates the memcomparable encoding of every index of table. The key
+  definitions and their parts are allocated as one block; free it with
+  my_free().
+*/
 
-    @see
-  ha_innodb.cc
+static LDB_KEY_DEF *ldb_build_key_defs(TABLE *table)
+{
+  LDB_KEY_DEF *key_defs;
+  LDB_KEY_PART *parts;
+  uint total_parts= 0;
+
+  for (uint i= 0; i < table->s->keys; i++)
+    total_parts+= table->key_info[i].key_parts;
+
+  if (!my_multi_malloc(MYF(MY_WME | MY_ZEROFILL),
+                       &key_defs, sizeof(*key_defs) * (table->s->keys + 1),
+                       &parts, sizeof(*parts) * (total_parts + 1),
+                       NullS))
+    return NULL;
+
+  for (uint i= 0; i < table->s->keys; i++)
+  {
+    KEY *key_info= table->key_info + i;
+    LDB_KEY_DEF *def= key_defs + i;
+
+    def->parts= parts;
+    def->part_count= key_info->key_parts;
+    def->decodable= true;
+    parts+= def->part_count;
+
+    for (uint j= 0; j < def->part_count; j++)
+    {
+      LDB_KEY_PART *part= def->parts + j;
+      KEY_PART_INFO *key_part= key_info->key_part + j;
+      CHARSET_INFO *cs= key_part->field->charset();
+
+      part->key_part= key_part;
+      part->length_bytes= 0;
+      part->data_length= key_part->length;
+
+      switch (key_part->type) {
+      case HA_KEYTYPE_INT8:
+      case HA_KEYTYPE_SHORT_INT:
+      case HA_KEYTYPE_INT24:
+      case HA_KEYTYPE_LONG_INT:
+      case HA_KEYTYPE_LONGLONG:
+        part->encoding= LDB_KEY_INT;
+        break;
+      case HA_KEYTYPE_USHORT_INT:
+      case HA_KEYTYPE_UINT24:
+      case HA_KEYTYPE_ULONG_INT:
+      case HA_KEYTYPE_ULONGLONG:
+        part->encoding= LDB_KEY_UINT;
+        break;
+      case HA_KEYTYPE_FLOAT:
+        part->encoding= LDB_KEY_FLOAT;
+        break;
+      case HA_KEYTYPE_DOUBLE:
+        part->encoding= LDB_KEY_DOUBLE;
+        break;
+      case HA_KEYTYPE_VARBINARY1:
+      case HA_KEYTYPE_VARBINARY2:
+        part->encoding= LDB_KEY_VARBINARY;
+        part->length_bytes= key_part->type == HA_KEYTYPE_VARBINARY1 ? 1 : 2;
+        part->data_length= key_part->length + 2;
+        break;
+      case HA_KEYTYPE_VARTEXT1:
+      case HA_KEYTYPE_VARTEXT2:
+        part->length_bytes= key_part->type == HA_KEYTYPE_VARTEXT1 ? 1 : 2;
+        /* fall through */
+      case HA_KEYTYPE_TEXT:
+        part->encoding= LDB_KEY_TEXT;
+        part->data_length= cs->coll->strnxfrmlen(cs, key_part->length);
+        def->decodable= false;
+        break;
+      default:
+        part->encoding= LDB_KEY_BINARY;
+        break;
+      }
+
+      def->max_length+= part->data_length + (key_part->null_bit ? 1 : 0);
+    }
+  }
+  return key_defs;
+}
+
+
+/**
+  @brief
+  Generates the packed row encoding of every field of table, terminated
+  by an entry without field. Free the result with my_free().
 */
-int ha_ldb::extra(enum ha_extra_function operation)
+
+static LDB_ROW_FIELD *ldb_build_row_fields(TABLE *table)
 {
-  DBUG_ENTER("ha_ldb::extra");
-  DBUG_RETURN(0);
+  LDB_ROW_FIELD *row_fields;
+
+  if (!(row_fields= (LDB_ROW_FIELD*)
+        my_malloc(sizeof(*row_fields) * (table->s->fields + 1),
+                  MYF(MY_WME | MY_ZEROFILL))))
+    return NULL;
+
+  for (uint i= 0; i < table->s->fields; i++)
+  {
+    Field *field= table->field[i];
+    LDB_ROW_FIELD *rf= row_fields + i;
+
+    rf->field= field;
+    rf->length= field->pack_length();
+    rf->length_bytes= 0;
+
+    switch (field->real_type()) {
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_LONGLONG:
+      rf->encoding= (field->flags & UNSIGNED_FLAG) ? LDB_ROW_UINT : LDB_ROW_INT;
+      break;
+    case MYSQL_TYPE_VARCHAR:
+      rf->encoding= LDB_ROW_VARCHAR;
+      rf->length_bytes= ((Field_varstring*) field)->length_bytes;
+      break;
+    case MYSQL_TYPE_TINY_BLOB:
+    case MYSQL_TYPE_MEDIUM_BLOB:
+    case MYSQL_TYPE_LONG_BLOB:
+    case MYSQL_TYPE_BLOB:
+    case MYSQL_TYPE_GEOMETRY:
+      rf->encoding= LDB_ROW_BLOB;
+      rf->length_bytes= ((Field_blob*) field)->pack_length_no_ptr();
+      break;
+    default:
+      rf->encoding= LDB_ROW_FIXED;
+      break;
+    }
+  }
+  return row_fields;
 }
 
 
 /**
   @brief
-  Used to delete all rows in a table, including cases of truncate and cases where
-  the optimizer realizes that all rows will be removed as a result of an SQL statement.
+  Appends the memcomparable image of one NOT NULL key part. data points to
+  the value as it is laid out in the record (VARCHARs without their length
+  prefix, len bytes long).
+*/
 
-  @details
-  Called from item_sum.cc by Item_func_group_concat::clear(),
-  Item_sum_count_distinct::clear(), and Item_func_group_concat::clear().
-  Called from sql_delete.cc by mysql_delete().
-  Called from sql_select.cc by JOIN::reinit().
-  Called from sql_union.cc by st_select_lex_unit::exec().
+static void ldb_encode_key_part(const LDB_KEY_PART *part, const uchar *data,
+                                uint len, std::string &out)
+{
+  size_t start= out.length();
+  uint n= part->key_part->length;
+
+  switch (part->encoding) {
+  case LDB_KEY_INT:
+  case LDB_KEY_UINT:
+    for (uint i= n; i > 0; i--)
+      out.push_back((char) data[i - 1]);
+    if (part->encoding == LDB_KEY_INT)
+      out[start]^= (char) 0x80;
+    break;
+  case LDB_KEY_FLOAT:
+  {
+    float f;
+    uint32 bits;
+    float4get(f, data);
+    if (f == 0.0)
+      f= 0.0;                                   /* -0.0 sorts as 0.0 */
+    memcpy(&bits, &f, sizeof(bits));
+    bits= (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+    for (int shift= 24; shift >= 0; shift-= 8)
+      out.push_back((char) (bits >> shift));
+    break;
+  }
+  case LDB_KEY_DOUBLE:
+  {
+    double d;
+    ulonglong bits;
+    float8get(d, data);
+    if (d == 0.0)
+      d= 0.0;
+    memcpy(&bits, &d, sizeof(bits));
+    bits= (bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL;
+    for (int shift= 56; shift >= 0; shift-= 8)
+      out.push_back((char) (bits >> shift));
+    break;
+  }
+  case LDB_KEY_VARBINARY:
+    set_if_smaller(len, n);
+    out.append((const char*) data, len);
+    out.append(n - len, '\0');
+    out.push_back((char) (len >> 8));
+    out.push_back((char) len);
+    break;
+  case LDB_KEY_TEXT:
+  {
+    CHARSET_INFO *cs= part->key_part->field->charset();
+    set_if_smaller(len, n);
+    set_if_smaller(len, (uint) my_charpos(cs, data, data + len, n / cs->mbmaxlen));
+    out.resize(start + part->data_length);
+    my_strnxfrm(cs, (uchar*) &out[start], part->data_length, data, len);
+    break;
+  }
+  case LDB_KEY_BINARY:
+    out.append((const char*) data, n);
+    break;
+  }
+}
 
-  @see
-  Item_func_group_concat::clear(), Item_sum_count_distinct::clear() and
-  Item_func_group_concat::clear() in item_sum.cc;
-  mysql_delete() in sql_delete.cc;
-  JOIN::reinit() in sql_select.cc and
-  st_select_lex_unit::exec() in sql_union.cc.
+
+/**
+  @brief
+  Restores one NOT NULL key part from its memcomparable image into the
+  record layout at to. Returns false if the encoding is not reversible.
 */
-int ha_ldb::delete_all_rows()
+
+static bool ldb_decode_key_part(const LDB_KEY_PART *part, const uchar *from,
+                                uchar *to)
 {
-  DBUG_ENTER("ha_ldb::delete_all_rows");
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  uint n= part->key_part->length;
+
+  switch (part->encoding) {
+  case LDB_KEY_INT:
+  case LDB_KEY_UINT:
+    for (uint i= 0; i < n; i++)
+      to[i]= from[n - 1 - i];
+    if (part->encoding == LDB_KEY_INT)
+      to[n - 1]^= 0x80;
+    return true;
+  case LDB_KEY_FLOAT:
+  {
+    uint32 bits= 0;
+    float f;
+    for (uint i= 0; i < 4; i++)
+      bits= (bits << 8) | from[i];
+    bits= (bits & 0x80000000) ? bits & ~0x80000000 : ~bits;
+    memcpy(&f, &bits, sizeof(f));
+    float4store(to, f);
+    return true;
+  }
+  case LDB_KEY_DOUBLE:
+  {
+    ulonglong bits= 0;
+    double d;
+    for (uint i= 0; i < 8; i++)
+      bits= (bits << 8) | from[i];
+    bits= (bits & 0x8000000000000000ULL) ? bits & ~0x8000000000000000ULL : ~bits;
+    memcpy(&d, &bits, sizeof(d));
+    float8store(to, d);
+    return true;
+  }
+  case LDB_KEY_VARBINARY:
+  {
+    uint len= (from[n] << 8) | from[n + 1];
+    if (part->length_bytes == 1)
+      to[0]= (uchar) len;
+    else
+      int2store(to, len);
+    memcpy(to + part->length_bytes, from, len);
+    return true;
+  }
+  case LDB_KEY_TEXT:
+    return false;
+  case LDB_KEY_BINARY:
+    memcpy(to, from, n);
+    return true;
+  }
+  return false;
 }
 
 
 /**
   @brief
-  Used for handler specific truncate table.  The table is locked in
-  exclusive mode and handler is responsible for reseting the auto-
-  increment counter.
+  Returns the length of the first parts key parts of def encoded at the
+  start of key.
+*/
 
-  @details
-  Called from Truncate_statement::handler_truncate.
-  Not used if the handlerton supports HTON_CAN_RECREATE, unless this
-  engine can be used as a partition. In this case, it is invoked when
-  a particular partition is to be truncated.
+static uint ldb_encoded_parts_length(const LDB_KEY_DEF *def, uint parts,
+                                     const leveldb::Slice &key)
+{
+  uint pos= 0;
 
-  @see
-  Truncate_statement in sql_truncate.cc
-  Remarks in handler::truncate.
+  for (uint i= 0; i < parts && pos < key.size(); i++)
+  {
+    const LDB_KEY_PART *part= def->parts + i;
+    if (part->key_part->null_bit && !key[pos++])
+      continue;
+    pos+= part->data_length;
+  }
+  return pos < key.size() ? pos : (uint) key.size();
+}
+
+
+/**
+  @brief
+  Returns the length of the encoded key of def at the start of key, which
+  may be followed by more bytes (the primary key of a secondary entry).
 */
-int ha_ldb::truncate()
+
+static uint ldb_encoded_key_length(const LDB_KEY_DEF *def,
+                                   const leveldb::Slice &key)
 {
-  DBUG_ENTER("ha_ldb::truncate");
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  return ldb_encoded_parts_length(def, def->part_count, key);
 }
 
 
 /**
   @brief
-  This create a lock on the table. If you are implementing a storage engine
-  that can handle transacations look at ha_berkely.cc to see how you will
-  want to go about doing this. Otherwise you should consider calling flock()
-  here. Hint: Read the section "locking functions for mysql" in lock.cc to understand
-  this.
+  Used for opening tables. The name will be the name of the file.
 
   @details
-  Called from lock.cc by lock_external() and unlock_external(). Also called
-  from sql_table.cc by copy_data_between_tables().
+  A table is opened when it needs to be opened; e.g. when a request comes in
+  for a SELECT on the table (tables are not open and closed for each request,
+  they are cached).
+
+  Called from handler.cc by handler::ha_open(). The server opens all tables by
+  calling ha_open() which then calls the handler specific open().
 
   @see
-  lock.cc by lock_external() and unlock_external() in lock.cc;
-  the section "locking functions for mysql" in lock.cc;
-  copy_data_between_tables() in sql_table.cc.
+  handler::ha_open() in handler.cc
 */
-int ha_ldb::external_lock(THD *thd, int lock_type)
+
+
+
+int ha_ldb::open(const char *name, int mode, uint test_if_locked)
 {
-  DBUG_ENTER("ha_ldb::external_lock");
-  thd= current_thd;
-  trx_t *trx;
-  if (lock_type != F_UNLCK)
+  DBUG_ENTER("ha_ldb::open");
+  if (!(share = get_share(name, table)))
+    DBUG_RETURN(1);
+  thr_lock_data_init(&share->lock,&lock,NULL);
+
+  if (!(key_defs= ldb_build_key_defs(table)) ||
+      !(row_fields= ldb_build_row_fields(table)) ||
+      bitmap_init(&scan_cond_fields, NULL, table->s->fields, FALSE))
   {
-    trx= (trx_t*) thd_get_ha_data(thd, ldb_hton);
-    if (!trx)
-    {
-      trx= new trx_t;
-      trx->pobj= this;
-      thd_set_ha_data(current_thd, ldb_hton, trx);
-    }
-    DBUG_RETURN(0);
+    my_free(key_defs);
+    key_defs= NULL;
+    my_free(row_fields);
+    row_fields= NULL;
+    free_share(share);
+    DBUG_RETURN(HA_ERR_OUT_OF_MEM);
   }
-  else
-  {
-    trx= (trx_t*) thd_get_ha_data(thd, ldb_hton);
 
-    if (!trx)
-    {
-      DBUG_RETURN(1);
-    }
- 
-    leveldb::Status s= trx->pobj->share->db->Write(wo, &trx->batch);
- 
-    free_trx(ldb_hton, trx);
-
-    DBUG_RETURN(!s.ok());
-  }
+  /* position() stores the length prefixed primary key in ref. */
+  ref_length= sizeof(uint16) + LDB_TABLE_ID_LENGTH + LDB_INDEX_ID_LENGTH +
+              key_defs[table->s->primary_key].max_length;
+  
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Closes a table. We call the free_share() function to free any resources
+  that we have allocated in the "shared" structure.
+
+  @details
+  Called from sql_base.cc, sql_select.cc, and table.cc. In sql_select.cc it is
+  only used to close up temporary tables or during the process where a
+  temporary table is converted over to being a myisam table.
+
+  For sql_base.cc look at close_data_tables().
+
+  @see
+  sql_base.cc, sql_select.cc and table.cc
+*/
+
+int ha_ldb::close(void)
+{
+  DBUG_ENTER("ha_ldb::close");
+  delete scan_iter;
+  scan_iter= NULL;
+  delete index_iter;
+  index_iter= NULL;
+  delete bulk_load;
+  bulk_load= NULL;
+  my_free(key_defs);
+  key_defs= NULL;
+  my_free(row_fields);
+  row_fields= NULL;
+  row_blobs.clear();
+  bitmap_free(&scan_cond_fields);
+  scan_cond= NULL;
+  icp_cond= NULL;
+  DBUG_RETURN(free_share(share));
+}
+
+
+/**
+  @brief
+  write_row() inserts a row. No extra() hint is given currently if a bulk load
+  is happening. buf() is a byte array of data. You can use the field
+  information to extract the data from the native byte array type.
+
+  @details
+  Example of this would be:
+  @code
+  for (Field **field=table->field ; *field ; field++)
+  {
+    ...
+  }
+  @endcode
+
+  See ha_tina.cc for an ldb of extracting all of the data as strings.
+  ha_berekly.cc has an ldb of how to store it intact by "packing" it
+  for ha_berkeley's own native storage type.
+
+  See the note for update_row() on auto_increments and timestamps. This
+  case also applies to write_row().
+
+  Called from item_sum.cc, item_sum.cc, sql_acl.cc, sql_insert.cc,
+  sql_insert.cc, sql_select.cc, sql_table.cc, sql_udf.cc, and sql_update.cc.
+
+  @see
+  item_sum.cc, item_sum.cc, sql_acl.cc, sql_insert.cc,
+  sql_insert.cc, sql_select.cc, sql_table.cc, sql_udf.cc and sql_update.cc
+*/
+
+/**
+  @brief
+  Appends the encoding of the key columns of def taken from record.
+*/
+
+static void ldb_encode_record_key(const LDB_KEY_DEF *def, const uchar *record,
+                                  std::string &key)
+{
+  for (uint i= 0; i < def->part_count; i++)
+  {
+    const LDB_KEY_PART *part= def->parts + i;
+    const KEY_PART_INFO *key_part= part->key_part;
+    const uchar *data= record + key_part->offset;
+    uint len= key_part->length;
+
+    if (key_part->null_bit)
+    {
+      if (record[key_part->null_offset] & key_part->null_bit)
+      {
+        key.push_back('\0');
+        continue;
+      }
+      key.push_back('\1');
+    }
+
+    if (part->length_bytes)
+    {
+      len= part->length_bytes == 1 ? (uint) *data : uint2korr(data);
+      data+= part->length_bytes;
+    }
+    ldb_encode_key_part(part, data, len, key);
+  }
+}
+
+
+/**
+  @brief
+  Appends the keyspace prefix of index keynr. Each index lives in its own
+  range of the leveldb key space, starting with the table id and its index
+  id.
+*/
+
+void ha_ldb::key_prefix(uint keynr, std::string &key)
+{
+  ldb_table_prefix(share->table_id, key);
+  key.push_back((char) keynr);
+}
+
+
+/**
+  @brief
+  Builds the leveldb key of index keynr for record. The primary key entry
+  holds the row; a secondary entry is the secondary columns followed by the
+  primary key columns, with an empty value.
+*/
+
+void ha_ldb::pack_record_key(uint keynr, const uchar *record, std::string &key)
+{
+  key_prefix(keynr, key);
+  ldb_encode_record_key(key_defs + keynr, record, key);
+  if (keynr != table->s->primary_key)
+    ldb_encode_record_key(key_defs + table->s->primary_key, record, key);
+}
+
+
+static void ldb_store_varint(std::string &to, ulonglong nr)
+{
+  while (nr >= 0x80)
+  {
+    to.push_back((char) (nr | 0x80));
+    nr>>= 7;
+  }
+  to.push_back((char) nr);
+}
+
+
+/* Returns the byte after the varint at from, or NULL if it is corrupt. */
+
+static const uchar *ldb_read_varint(const uchar *from, const uchar *end,
+                                    ulonglong *nr)
+{
+  ulonglong result= 0;
+  for (uint shift= 0; shift < 64 && from < end; shift+= 7)
+  {
+    uchar byte= *from++;
+    result|= (ulonglong) (byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      *nr= result;
+      return from;
+    }
+  }
+  return NULL;
+}
+
+
+/**
+  @brief
+  Serializes record into the value stored under its primary key, in the
+  packed row format described at ldb_row_encoding.
+*/
+
+void ha_ldb::pack_row(const uchar *record, std::string &value)
+{
+  my_ptrdiff_t offset= record - table->record[0];
+
+  value.clear();
+  value.push_back((char) LDB_ROW_FORMAT_VERSION);
+  value.append((const char*) record, table->s->null_bytes);
+
+  for (const LDB_ROW_FIELD *rf= row_fields; rf->field; rf++)
+  {
+    const uchar *ptr= rf->field->ptr + offset;
+
+    if (rf->field->is_null(offset))
+      continue;
+
+    switch (rf->encoding) {
+    case LDB_ROW_INT:
+    case LDB_ROW_UINT:
+    {
+      uint bits= rf->length * 8;
+      ulonglong nr= 0;
+      for (uint i= rf->length; i--; )
+        nr= (nr << 8) | ptr[i];
+      if (rf->encoding == LDB_ROW_INT)
+      {
+        /* Sign extend, then zigzag so that small negatives stay short. */
+        if (bits < 64 && (nr >> (bits - 1)) & 1)
+          nr|= ~(ulonglong) 0 << bits;
+        nr= (nr << 1) ^ (ulonglong) ((longlong) nr >> 63);
+      }
+      ldb_store_varint(value, nr);
+      break;
+    }
+    case LDB_ROW_VARCHAR:
+    {
+      uint length= rf->length_bytes == 1 ? (uint) *ptr : uint2korr(ptr);
+      ldb_store_varint(value, length);
+      value.append((const char*) ptr + rf->length_bytes, length);
+      break;
+    }
+    case LDB_ROW_BLOB:
+    {
+      Field_blob *blob= (Field_blob*) rf->field;
+      uint32 length= blob->get_length(ptr);
+      const char *data;
+      memcpy(&data, ptr + rf->length_bytes, sizeof(data));
+      ldb_store_varint(value, length);
+      value.append(data, length);
+      break;
+    }
+    case LDB_ROW_FIXED:
+      value.append((const char*) ptr, rf->length);
+      break;
+    }
+  }
+}
+
+
+/**
+  @brief
+  Decodes the fields of a packed row from [from, end) into the record at
+  offset from record[0]. Returns false if the row is corrupt.
+
+  @details
+  If fields is not NULL only the fields set in it are stored; the others
+  are skipped over and left as they are in the record.
+*/
+
+static bool ldb_unpack_fields(const LDB_ROW_FIELD *rf, my_ptrdiff_t offset,
+                              const uchar *from, const uchar *end,
+                              const MY_BITMAP *fields)
+{
+  for (; rf->field; rf++)
+  {
+    uchar *ptr= rf->field->ptr + offset;
+    bool skip= fields && !bitmap_is_set(fields, rf->field->field_index);
+    ulonglong nr;
+
+    if (rf->field->is_null(offset))
+    {
+      if (!skip)
+        bzero(ptr, rf->length);
+      continue;
+    }
+
+    switch (rf->encoding) {
+    case LDB_ROW_INT:
+    case LDB_ROW_UINT:
+      if (!(from= ldb_read_varint(from, end, &nr)))
+        return false;
+      if (skip)
+        break;
+      if (rf->encoding == LDB_ROW_INT)
+        nr= (nr >> 1) ^ (~(nr & 1) + 1);
+      for (uint i= 0; i < rf->length; i++, nr>>= 8)
+        ptr[i]= (uchar) nr;
+      break;
+    case LDB_ROW_VARCHAR:
+      if (!(from= ldb_read_varint(from, end, &nr)) ||
+          nr > (ulonglong) (end - from) ||
+          nr + rf->length_bytes > rf->length)
+        return false;
+      if (!skip)
+      {
+        if (rf->length_bytes == 1)
+          *ptr= (uchar) nr;
+        else
+          int2store(ptr, (uint) nr);
+        memcpy(ptr + rf->length_bytes, from, (size_t) nr);
+      }
+      from+= nr;
+      break;
+    case LDB_ROW_BLOB:
+      if (!(from= ldb_read_varint(from, end, &nr)) ||
+          nr > (ulonglong) (end - from))
+        return false;
+      /* The blob points into the value, which the caller keeps alive. */
+      if (!skip)
+        ((Field_blob*) rf->field)->set_ptr_offset(offset, (uint32) nr,
+                                                  (uchar*) from);
+      from+= nr;
+      break;
+    case LDB_ROW_FIXED:
+      if (rf->length > (size_t) (end - from))
+        return false;
+      if (!skip)
+        memcpy(ptr, from, rf->length);
+      from+= rf->length;
+      break;
+    }
+  }
+  return from == end;
+}
+
+
+/**
+  @brief
+  Builds in key the part of the entry of unique index keynr for record that
+  must not repeat: the whole primary key, or the secondary columns without
+  the primary key that follows them. Returns false if a NULL part exempts
+  record from the constraint.
+*/
+
+bool ha_ldb::pack_unique_key(uint keynr, const uchar *record, std::string &key)
+{
+  KEY *key_info= table->key_info + keynr;
+
+  for (uint i= 0; i < key_info->key_parts; i++)
+  {
+    KEY_PART_INFO *key_part= key_info->key_part + i;
+    if (key_part->null_bit &&
+        (record[key_part->null_offset] & key_part->null_bit))
+      return false;
+  }
+  key.clear();
+  key_prefix(keynr, key);
+  ldb_encode_record_key(key_defs + keynr, record, key);
+  return true;
+}
+
+
+/**
+  @brief
+  Returns HA_ERR_FOUND_DUPP_KEY if the transaction sees an entry starting
+  with the unique key built by pack_unique_key(), 0 if it does not.
+
+  @details
+  A primary key is looked up in the pending changes of the transaction,
+  then with DB::KeyMayExist(), which only probes the memtables and the
+  bloom filters of the table files: a new key usually costs no data block
+  read. A filter hit is confirmed by a real read. A secondary entry ends
+  with the primary key, so it takes a seek over the index instead. The
+  caller holds the row lock of the key, so either is looked up in the
+  latest state rather than in the snapshot. Values found are copied into
+  the reused latest_value, so that a primary key check does not allocate.
+*/
+
+int ha_ldb::key_exists(uint keynr, const std::string &key)
+{
+  if (keynr != table->s->primary_key)
+  {
+    trx_t *trx= get_trx(ldb_hton, ha_thd());
+    leveldb::Iterator *it= trx->batch.NewIteratorWithBase(
+      share->db->NewIterator(leveldb::ReadOptions()));
+    it->Seek(key);
+    bool found= it->Valid() && it->key().starts_with(key);
+    bool ok= it->status().ok();
+    delete it;
+    if (!ok)
+      return HA_ERR_INTERNAL_ERROR;
+    return found ? HA_ERR_FOUND_DUPP_KEY : 0;
+  }
+
+  leveldb::Slice written;
+  bool deleted;
+  bool value_found;
+  trx_t *trx= get_trx(ldb_hton, ha_thd());
+  if (trx->batch.Get(key, &written, &deleted))
+    return deleted ? 0 : HA_ERR_FOUND_DUPP_KEY;
+  if (!share->db->KeyMayExist(leveldb::ReadOptions(), key, &latest_value,
+                              &value_found))
+    return 0;
+  if (value_found)
+    return HA_ERR_FOUND_DUPP_KEY;
+
+  leveldb::Status s= share->db->Get(leveldb::ReadOptions(), key,
+                                    &latest_value);
+  if (s.ok())
+    return HA_ERR_FOUND_DUPP_KEY;
+  return s.IsNotFound() ? 0 : HA_ERR_INTERNAL_ERROR;
+}
+
+
+/**
+  @brief
+  Checks that record repeats no key of a unique index. For an update,
+  old_record is the row being replaced and only the keys that change are
+  checked. The index of a duplicate is reported by info(HA_STATUS_ERRKEY).
+
+  @details
+  The caller holds the lock of the primary key. A unique secondary value is
+  locked like a primary key before it is checked, so that two transactions
+  writing the same value take turns and the later one sees the entry of
+  the first.
+*/
+
+int ha_ldb::check_unique_keys(const uchar *record, const uchar *old_record)
+{
+  THD *thd= ha_thd();
+  trx_t *trx= get_trx(ldb_hton, thd);
+  int rc;
+
+  for (uint keynr= 0; keynr < table->s->keys; keynr++)
+  {
+    if (!(table->key_info[keynr].flags & HA_NOSAME) ||
+        !pack_unique_key(keynr, record, unique_key))
+      continue;
+    if (old_record && pack_unique_key(keynr, old_record, old_unique_key) &&
+        unique_key.compare(old_unique_key) == 0)
+      continue;
+    if (keynr != table->s->primary_key &&
+        (rc= ldb_lock_row(thd, trx, unique_key)))
+      return rc;
+    rc= key_exists(keynr, unique_key);
+    if (rc)
+    {
+      if (rc == HA_ERR_FOUND_DUPP_KEY)
+        dup_key= keynr;
+      return rc;
+    }
+  }
+  return 0;
+}
+
+
+/**
+  @brief
+  Tells whether a row that changed after the statement read it may be
+  rechecked by lock_row() instead of failing the statement: only in a
+  single-table UPDATE or DELETE without triggers, and unless the snapshot
+  of the transaction spans statements (REPEATABLE READ and SERIALIZABLE
+  transactions), whose reads must all see the same state.
+
+  @details
+  The recheck evaluates the WHERE condition and the SET values of the
+  statement once more, so neither may run a subquery or a stored function.
+*/
+
+bool ha_ldb::can_recheck_row(THD *thd, trx_t *trx)
+{
+  LEX *lex= thd->lex;
+
+  if (thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN) &&
+      thd_tx_isolation(thd) > ISO_READ_COMMITTED)
+    return false;
+  if ((lex->sql_command != SQLCOM_UPDATE &&
+       lex->sql_command != SQLCOM_DELETE) ||
+      trx->tables_in_use != 1 || table->triggers ||
+      lex->uses_stored_routines() ||
+      (lex->select_lex.where && lex->select_lex.where->with_subselect))
+    return false;
+
+  List_iterator_fast<Item> values(lex->value_list);
+  Item *value;
+  while ((value= values++))
+    if (value->with_subselect)
+      return false;
+  return true;
+}
+
+
+/**
+  @brief
+  Locks the row of primary key key until the transaction ends, see
+  ldb_lock_row(). With reread the row is about to be rewritten from what
+  the statement read at its snapshot, in table->record[0]. If another
+  transaction changed it since, the write would lose that change.
+
+  @details
+  Nothing can have changed if no write was made after the snapshot, or if
+  the transaction wrote the row itself, which it then read from its batch.
+
+  A changed row is read again at the latest state, which the lock keeps
+  stable, into table->record[0], and the WHERE condition of the statement
+  is evaluated on it, so that writers of one row take turns: *reread is
+  set and the caller proceeds from the new row. A row that was deleted or
+  does not match any more gives HA_ERR_RECORD_IS_THE_SAME, and is left as
+  it is. Without can_recheck_row() the statement fails with
+  HA_ERR_RECORD_CHANGED instead.
+*/
+
+int ha_ldb::lock_row(const std::string &key, bool *reread)
+{
+  THD *thd= ha_thd();
+  trx_t *trx= get_trx(ldb_hton, thd);
+  leveldb::Slice written;
+  bool deleted;
+  int rc;
+
+  if ((rc= ldb_lock_row(thd, trx, key)))
+    return rc;
+  if (!reread || !snapshot ||
+      snapshot->sequence() == share->db->GetLatestSequenceNumber() ||
+      trx->batch.Get(key, &written, &deleted))
+    return 0;
+
+  leveldb::Status s= get_row(key, &row_value);
+  leveldb::Status l= ldb_row_cache ? ldb_row_cache_get(NULL, key,
+                                                       &latest_value)
+                                   : share->db->Get(leveldb::ReadOptions(),
+                                                    key, &latest_value);
+  if ((!s.ok() && !s.IsNotFound()) || (!l.ok() && !l.IsNotFound()))
+    return HA_ERR_INTERNAL_ERROR;
+  if (s.ok() == l.ok() && row_value.compare(latest_value) == 0)
+    return 0;
+
+  if (!can_recheck_row(thd, trx))
+    return HA_ERR_RECORD_CHANGED;
+  if (!l.ok())
+    return HA_ERR_RECORD_IS_THE_SAME;
+  if ((rc= unpack_row(table->record[0], latest_value)))
+    return rc;
+  Item *where= thd->lex->select_lex.where;
+  if (where && !where->val_int())
+    return HA_ERR_RECORD_IS_THE_SAME;
+  *reread= true;
+  return 0;
+}
+
+
+/**
+  @brief
+  Tells whether the current statement may spill its changes: only an
+  autocommit UPDATE or DELETE of this table alone that changes no unique
+  key, since the spilled changes are no longer visible to its reads.
+
+  @details
+  Such a statement reads each row once, before it changes it, and checks
+  no unique key against its own changes. Its cursors are the only ones
+  over the batch and spill_batch() reopens them.
+*/
+
+bool ha_ldb::can_spill(THD *thd, trx_t *trx)
+{
+  if (thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN) ||
+      trx->tables_in_use != 1)
+    return false;
+  if (thd->lex->sql_command == SQLCOM_DELETE)
+    return true;
+  if (thd->lex->sql_command != SQLCOM_UPDATE)
+    return false;
+  for (uint keynr= 0; keynr < table->s->keys; keynr++)
+  {
+    KEY *key_info= table->key_info + keynr;
+    if (!(key_info->flags & HA_NOSAME))
+      continue;
+    for (uint i= 0; i < key_info->key_parts; i++)
+      if (bitmap_is_set(table->write_set, key_info->key_part[i].fieldnr - 1))
+        return false;
+  }
+  return true;
+}
+
+
+/**
+  @brief
+  Keeps the memory of a large statement bounded: once the batch reaches
+  ldb_trx_spill_size, its changes are moved to trx->spill, a leveldb bulk
+  load that sorts them into temporary table files. ldb_commit() adds the
+  files and the rest of the batch to the database at once, or
+  ldb_rollback() removes them.
+
+  @details
+  The cursors over the batch do not survive it being emptied. The scan
+  cursor is reopened after the last key read ahead, and the index cursor
+  after its current key by index_cursor().
+*/
+
+int ha_ldb::spill_batch(THD *thd, trx_t *trx)
+{
+  std::string scan_key;
+
+  if (!ldb_trx_spill_size ||
+      trx->batch.ApproximateSize() < ldb_trx_spill_size ||
+      !can_spill(thd, trx))
+    return 0;
+
+  if (scan_iter)
+  {
+    if (scan_iter->Valid() && scan_iter->key().starts_with(scan_prefix))
+      scan_key.assign(scan_iter->key().data(), scan_iter->key().size());
+    else
+    {
+      /* Past the keyspace: the scan is over. */
+      scan_key.assign(scan_prefix);
+      scan_key[scan_key.size() - 1]++;
+    }
+    delete scan_iter;
+    scan_iter= NULL;
+  }
+  if (index_iter)
+  {
+    if (!point_read)
+    {
+      if (index_iter->Valid())
+        point_key.assign(index_iter->key().data(), index_iter->key().size());
+      else
+      {
+        point_key.assign(index_prefix);
+        point_key[point_key.size() - 1]++;
+      }
+      point_read= true;
+    }
+    delete index_iter;
+    index_iter= NULL;
+  }
+
+  if (!ldb_spill_batch(trx).ok())
+    return HA_ERR_INTERNAL_ERROR;
+
+  if (!scan_key.empty())
+  {
+    scan_iter= new_iterator(scan_fill_cache);
+    scan_iter->Seek(scan_key);
+  }
+  return 0;
+}
+
+
+/**
+  @brief
+  Adds the entries of a new row to the transaction, or to the bulk load.
+
+  @details
+  The primary key is locked and the unique keys are checked first, also by
+  a bulk load: its table was empty when it started, but concurrent writers
+  may have added rows since. The load finds the primary keys it repeats
+  itself. A REPLACE into a table without secondary indexes skips the check:
+  it may overwrite the old row blindly, since no secondary entry of it
+  would be left behind.
+*/
+
+int ha_ldb::write_row(uchar *buf)
+{
+  DBUG_ENTER("ha_ldb::write_row");
+
+  std::string &key= row_key;
+  std::string &value= row_value;
+  trx_t *trx= (trx_t*)thd_get_ha_data(current_thd, ldb_hton);
+  int rc;
+
+  key.clear();
+  pack_record_key(table->s->primary_key, buf, key);
+  if ((rc= lock_row(key, NULL)))
+    DBUG_RETURN(rc);
+  if (!(write_can_replace && table->s->keys == 1) &&
+      (rc= check_unique_keys(buf, NULL)))
+    DBUG_RETURN(rc);
+
+  for (uint keynr= 0; keynr < table->s->keys; keynr++)
+  {
+    if (keynr == table->s->primary_key)
+      continue;
+    key.clear();
+    pack_record_key(keynr, buf, key);
+    if (bulk_load)
+      bulk_load->Add(key, leveldb::Slice());
+    else
+      trx->batch.Put(key, leveldb::Slice());
+  }
+
+  key.clear();
+  pack_record_key(table->s->primary_key, buf, key);
+  pack_row(buf, value);
+  if (bulk_load)
+  {
+    bulk_load->Add(key, value);
+    if (!bulk_load->status().ok())
+      DBUG_RETURN(HA_ERR_INTERNAL_ERROR);
+  }
+  else
+    trx->batch.Put(key, value);
+
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Tells whether the rows of the current statement may be bulk loaded: only
+  those of an autocommit statement that fails on duplicate keys, into a
+  table that holds no row yet and has no unique secondary index.
+
+  @details
+  A bulk load finds the keys it repeats itself, but does not look for them
+  in the database, and would overwrite a stored row and leave its
+  secondary entries behind. write_row() still checks each key for the
+  rows that concurrent writers add to the empty table. The loaded rows
+  are not visible to those checks, and secondary entries end with the
+  primary key, so two loaded rows with one unique secondary value would
+  go unnoticed.
+*/
+
+bool ha_ldb::can_bulk_load(THD *thd)
+{
+  std::string prefix;
+
+  if (!ldb_bulk_load_buffer_size ||
+      thd_test_options(thd, OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN) ||
+      thd->lex->duplicates != DUP_ERROR || thd->lex->ignore)
+    return false;
+  for (uint keynr= 0; keynr < table->s->keys; keynr++)
+    if (keynr != table->s->primary_key &&
+        (table->key_info[keynr].flags & HA_NOSAME))
+      return false;
+
+  ldb_table_prefix(share->table_id, prefix);
+  leveldb::Iterator *it= share->db->NewIterator(leveldb::ReadOptions());
+  it->Seek(prefix);
+  bool empty= it->status().ok() &&
+              !(it->Valid() && it->key().starts_with(prefix));
+  delete it;
+  return empty;
+}
+
+
+/**
+  @brief
+  Called before a multi-row INSERT, LOAD DATA or INSERT ... SELECT. The rows
+  of an autocommit statement that fails on duplicate keys are handed to a
+  leveldb bulk load instead of the transaction batch: they are sorted into
+  table files that end_bulk_insert() adds to the database at once, bypassing
+  the log and the memtable.
+
+  @details
+  The loaded rows are not visible to the statement itself and cannot be
+  rolled back once end_bulk_insert() succeeded, hence the restriction to
+  autocommit statements, see can_bulk_load(). Rows whose key range overlaps
+  recent writes are written through the memtable by leveldb instead.
+
+  @see
+  mysql_insert(), mysql_load() and select_insert::prepare() in sql_insert.cc
+  and sql_load.cc
+*/
+
+void ha_ldb::start_bulk_insert(ha_rows rows)
+{
+  DBUG_ENTER("ha_ldb::start_bulk_insert");
+
+  DBUG_ASSERT(!bulk_load);
+  if (can_bulk_load(ha_thd()))
+    bulk_load= share->db->NewBulkLoad(wo, (size_t) ldb_bulk_load_buffer_size,
+                                      false);
+  DBUG_VOID_RETURN;
+}
+
+
+/**
+  @brief
+  Adds the rows of a bulk load to the database, unless the statement
+  failed.
+*/
+
+int ha_ldb::end_bulk_insert()
+{
+  DBUG_ENTER("ha_ldb::end_bulk_insert");
+  int rc= 0;
+
+  if (!bulk_load)
+    DBUG_RETURN(0);
+  if (!ha_thd()->is_error())
+  {
+    /* Loaded rows may replace rows that are cached. */
+    ldb_row_cache_invalidate_all(false);
+    leveldb::Status s= bulk_load->Finish();
+    ldb_row_cache_invalidate_all(true);
+    if (s.IsInvalidArgument())
+    {
+      /* The loaded rows themselves repeat a primary key. */
+      dup_key= table->s->primary_key;
+      rc= HA_ERR_FOUND_DUPP_KEY;
+    }
+    else if (!s.ok())
+      rc= HA_ERR_INTERNAL_ERROR;
+  }
+  /* An unfinished load leaves the database unchanged. */
+  delete bulk_load;
+  bulk_load= NULL;
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  Yes, update_row() does what you expect, it updates a row. old_data will have
+  the previous row record in it, while new_data will have the newest data in it.
+  Keep in mind that the server can do updates based on ordering if an ORDER BY
+  clause was used. Consecutive ordering is not guaranteed.
+
+  @details
+  Currently new_data will not have an updated auto_increament record, or
+  and updated timestamp field. You can do these for ldb by doing:
+  @code
+  if (table->timestamp_field_type & TIMESTAMP_AUTO_SET_ON_UPDATE)
+    table->timestamp_field->set_time();
+  if (table->next_number_field && record == table->record[0])
+    update_auto_increment();
+  @endcode
+
+  Called from sql_select.cc, sql_acl.cc, sql_update.cc, and sql_insert.cc.
+
+  @see
+  sql_select.cc, sql_acl.cc, sql_update.cc and sql_insert.cc
+*/
+int ha_ldb::update_row(const uchar *old_data, uchar *new_data)
+{
+
+  DBUG_ENTER("ha_ldb::update_row");
+
+  std::string &old_key= old_row_key;
+  std::string &new_key= row_key;
+  std::string &value= row_value;
+  trx_t *trx= (trx_t*)thd_get_ha_data(current_thd, ldb_hton);
+  bool reread= false;
+  int rc;
+
+  old_key.clear();
+  pack_record_key(table->s->primary_key, old_data, old_key);
+  if ((rc= lock_row(old_key, &reread)))
+    DBUG_RETURN(rc);
+  if (reread)
+  {
+    /*
+      record[0] holds the latest row: it becomes the old row, and the new
+      one is computed from it again.
+    */
+    THD *thd= ha_thd();
+    DBUG_ASSERT(old_data == table->record[1] && new_data == table->record[0]);
+    if (old_data != table->record[1] || new_data != table->record[0])
+      DBUG_RETURN(HA_ERR_RECORD_CHANGED);
+    store_record(table, record[1]);
+    if (fill_record(thd, thd->lex->select_lex.item_list, thd->lex->value_list,
+                    false))
+      DBUG_RETURN(HA_ERR_INTERNAL_ERROR);
+  }
+  new_key.clear();
+  pack_record_key(table->s->primary_key, new_data, new_key);
+  if (old_key.compare(new_key) != 0 && (rc= lock_row(new_key, NULL)))
+    DBUG_RETURN(rc);
+
+  if ((rc= check_unique_keys(new_data, old_data)))
+    DBUG_RETURN(rc);
+
+  /* Secondary entries only change if their columns or the primary key do. */
+  for (uint keynr= 0; keynr < table->s->keys; keynr++)
+  {
+    if (keynr == table->s->primary_key)
+      continue;
+    old_key.clear();
+    new_key.clear();
+    pack_record_key(keynr, old_data, old_key);
+    pack_record_key(keynr, new_data, new_key);
+    if (old_key.compare(new_key) != 0)
+    {
+      trx->batch.Delete(old_key);
+      trx->batch.Put(new_key, leveldb::Slice());
+    }
+  }
+
+  old_key.clear();
+  new_key.clear();
+  pack_record_key(table->s->primary_key, old_data, old_key);
+  pack_record_key(table->s->primary_key, new_data, new_key);
+
+  if (old_key.compare(new_key) != 0)
+  {
+    trx->batch.Delete(old_key);
+  }
+
+  pack_row(new_data, value);
+  trx->batch.Put(new_key, value);
+
+  DBUG_RETURN(spill_batch(ha_thd(), trx));
+}
+
+
+/**
+  @brief
+  This will delete a row. buf will contain a copy of the row to be deleted.
+  The server will call this right after the current row has been called (from
+  either a previous rnd_nexT() or index call).
+
+  @details
+  If you keep a pointer to the last row or can access a primary key it will
+  make doing the deletion quite a bit easier. Keep in mind that the server does
+  not guarantee consecutive deletions. ORDER BY clauses can be used.
+
+  Called in sql_acl.cc and sql_udf.cc to manage internal table
+  information.  Called in sql_delete.cc, sql_insert.cc, and
+  sql_select.cc. In sql_select it is used for removing duplicates
+  while in insert it is used for REPLACE calls.
+
+  @see
+  sql_acl.cc, sql_udf.cc, sql_delete.cc, sql_insert.cc and sql_select.cc
+*/
+
+int ha_ldb::delete_row(const uchar *buf)
+{
+  DBUG_ENTER("ha_ldb::delete_row");
+
+  std::string &key= row_key;
+  trx_t *trx= (trx_t*)thd_get_ha_data(current_thd, ldb_hton);
+  bool reread= false;
+  int rc;
+
+  key.clear();
+  pack_record_key(table->s->primary_key, buf, key);
+  /* A row deleted meanwhile, or that no longer matches, is kept as it is. */
+  if ((rc= lock_row(key, &reread)) == HA_ERR_RECORD_IS_THE_SAME)
+    DBUG_RETURN(0);
+  if (rc)
+    DBUG_RETURN(rc);
+  /* The latest row was read into record[0]. */
+  DBUG_ASSERT(!reread || buf == table->record[0]);
+  if (reread && buf != table->record[0])
+    DBUG_RETURN(HA_ERR_RECORD_CHANGED);
+
+  for (uint keynr= 0; keynr < table->s->keys; keynr++)
+  {
+    key.clear();
+    pack_record_key(keynr, buf, key);
+    trx->batch.Delete(key);
+  }
+
+  DBUG_RETURN(spill_batch(ha_thd(), trx));
+}
+
+
+/**
+  @brief
+  Converts the first key_len bytes of a key in MySQL key buffer format into
+  its leveldb key: the index prefix and the memcomparable encoding. A partial
+  key yields a prefix of the encoding of any full key it matches.
+*/
+
+void ha_ldb::pack_key(uint keynr, const uchar *key, uint key_len, std::string &skey)
+{
+  const LDB_KEY_DEF *def= key_defs + keynr;
+  const uchar *end= key + key_len;
+
+  key_prefix(keynr, skey);
+  for (uint i= 0; i < def->part_count && key < end; i++)
+  {
+    const LDB_KEY_PART *part= def->parts + i;
+    const KEY_PART_INFO *key_part= part->key_part;
+    const uchar *data= key;
+    uint len= key_part->length;
+
+    key+= key_part->store_length;
+
+    if (key_part->null_bit)
+    {
+      if (*data++)
+      {
+        skey.push_back('\0');
+        continue;
+      }
+      skey.push_back('\1');
+    }
+
+    if (key_part->key_part_flag & HA_VAR_LENGTH_PART)
+    {
+      len= uint2korr(data);
+      data+= HA_KEY_BLOB_LENGTH;
+    }
+    ldb_encode_key_part(part, data, len, skey);
+  }
+}
+
+
+/**
+  @brief
+  Restores the key columns of index keynr into record from their encoding
+  (without the index prefix). Parts that cannot be decoded (collated
+  strings) are skipped, in which case false is returned.
+*/
+
+bool ha_ldb::unpack_key(uint keynr, const leveldb::Slice &key, uchar *record)
+{
+  const LDB_KEY_DEF *def= key_defs + keynr;
+  const uchar *from= (const uchar*) key.data();
+  const uchar *end= from + key.size();
+  bool decoded= true;
+
+  for (uint i= 0; i < def->part_count; i++)
+  {
+    const LDB_KEY_PART *part= def->parts + i;
+    const KEY_PART_INFO *key_part= part->key_part;
+
+    if (key_part->null_bit)
+    {
+      if (from >= end)
+        return false;
+      if (!*from++)
+      {
+        record[key_part->null_offset]|= key_part->null_bit;
+        continue;
+      }
+      record[key_part->null_offset]&= (uchar) ~key_part->null_bit;
+    }
+    if (from + part->data_length > end)
+      return false;
+    if (!ldb_decode_key_part(part, from, record + key_part->offset))
+      decoded= false;
+    from+= part->data_length;
+  }
+  return decoded;
+}
+
+
+/**
+  @brief
+  Turns key into the smallest key that sorts after every key prefixed by
+  it. Returns false if there is no such key (key is all 0xff).
+*/
+
+static bool key_successor(std::string &key)
+{
+  while (!key.empty())
+  {
+    uchar last= (uchar) key[key.length() - 1];
+    if (last != 0xff)
+    {
+      key[key.length() - 1]= (char) (last + 1);
+      return true;
+    }
+    key.resize(key.length() - 1);
+  }
+  return false;
+}
+
+
+/**
+  @brief
+  Returns the index cursor, opening it on the statement snapshot first if
+  needed. The cursor is kept across index_* calls and repositioned by Seek,
+  which is also done here after a point read.
+*/
+
+leveldb::Iterator *ha_ldb::index_cursor()
+{
+  if (!index_iter)
+    index_iter= new_iterator(true);
+  if (point_read)
+  {
+    index_iter->Seek(point_key);
+    point_read= false;
+  }
+  return index_iter;
+}
+
+
+/**
+  @brief
+  Reads the row of the full primary key skey with read_row(), which may
+  find it in the row cache, without seeking the index cursor.
+*/
+
+int ha_ldb::read_point_row(uchar *buf, const std::string &skey)
+{
+  int rc= read_row(skey, buf);
+
+  if (rc == HA_ERR_KEY_NOT_FOUND || rc == HA_ERR_INTERNAL_ERROR)
+    return rc;
+  point_key.assign(skey);
+  point_read= true;
+  return rc;
+}
+
+
+/**
+  @brief
+  Evaluates the pushed index condition on the entry under the index cursor,
+  after decoding the key columns (and the primary key of a secondary entry)
+  into buf.
+*/
+
+enum ldb_icp_result ha_ldb::check_index_cond(uchar *buf, bool forward)
+{
+  uint pk= table->s->primary_key;
+  leveldb::Slice entry= index_iter->key();
+  entry.remove_prefix(index_prefix.length());
+
+  unpack_key(active_index, entry, buf);
+  if (active_index != pk)
+  {
+    uint sec_len= ldb_encoded_key_length(key_defs + active_index, entry);
+    unpack_key(pk, leveldb::Slice(entry.data() + sec_len,
+                                  entry.size() - sec_len), buf);
+  }
+  if (forward && end_range && compare_key(end_range) > 0)
+    return LDB_ICP_OUT_OF_RANGE;
+  return icp_cond->val_int() ? LDB_ICP_MATCH : LDB_ICP_NO_MATCH;
+}
+
+
+/**
+  @brief
+  Reads the row under the index cursor into buf. The cursor is past the end
+  of the index once it leaves the keyspace of the active index.
+
+  @details
+  A secondary entry carries the primary key after the secondary columns.
+  If every column the statement reads is part of the two keys, the row is
+  decoded from the entry itself; otherwise it is fetched by primary key.
+
+  Entries rejected by the pushed index condition are skipped in the
+  direction of the read without fetching their rows, as long as they keep
+  the prefix icp_bound and stay within end_range.
+*/
+
+int ha_ldb::read_index_row(uchar *buf, int not_found_error, bool forward)
+{
+  for (;;)
+  {
+    if (!index_iter->Valid() || !index_iter->key().starts_with(index_prefix))
+    {
+      table->status= STATUS_NOT_FOUND;
+      return index_iter->status().ok() ? not_found_error : HA_ERR_INTERNAL_ERROR;
+    }
+    if (!icp_cond || active_index != icp_keyno || buf != table->record[0])
+      break;
+
+    enum ldb_icp_result icp= check_index_cond(buf, forward);
+    if (icp == LDB_ICP_MATCH)
+      break;
+    if (icp == LDB_ICP_NO_MATCH)
+    {
+      if (forward)
+        index_iter->Next();
+      else
+        index_iter->Prev();
+    }
+    if (icp == LDB_ICP_OUT_OF_RANGE ||
+        (index_iter->Valid() && !index_iter->key().starts_with(icp_bound)))
+    {
+      table->status= STATUS_NOT_FOUND;
+      return not_found_error;
+    }
+  }
+
+  uint pk= table->s->primary_key;
+  leveldb::Slice entry= index_iter->key();
+  entry.remove_prefix(index_prefix.length());
+
+  if (active_index == pk)
+  {
+    if (!keyread_covering)
+      return unpack_row(buf, index_iter->value());
+    /* Key-only read of the primary key: the value is not decoded. */
+    unpack_key(pk, entry, buf);
+    table->status= 0;
+    return 0;
+  }
+  uint sec_len= ldb_encoded_key_length(key_defs + active_index, entry);
+  leveldb::Slice pk_part(entry.data() + sec_len, entry.size() - sec_len);
+
+  if (keyread_covering)
+  {
+    unpack_key(active_index, entry, buf);
+    unpack_key(pk, pk_part, buf);
+    table->status= 0;
+    return 0;
+  }
+
+  row_key.clear();
+  key_prefix(pk, row_key);
+  row_key.append(pk_part.data(), pk_part.size());
+  return read_row(row_key, buf);
+}
+
+
+/**
+  @brief
+  Returns true if every column in the read set of the statement can be
+  decoded from the entries of secondary index keynr.
+*/
+
+bool ha_ldb::index_covers_read_set(uint keynr)
+{
+  uint pk= table->s->primary_key;
+
+  if (keynr == pk)
+    return false;
+  for (Field **field= table->field; *field; field++)
+  {
+    if (bitmap_is_set(table->read_set, (*field)->field_index) &&
+        !(*field)->part_of_key.is_set(keynr) &&
+        !(*field)->part_of_key.is_set(pk))
+      return false;
+  }
+  return true;
+}
+
+
+int ha_ldb::index_init(uint idx, bool sorted)
+{
+  DBUG_ENTER("ha_ldb::index_init");
+  active_index= idx;
+  index_prefix.clear();
+  key_prefix(idx, index_prefix);
+  point_read= false;
+  keyread_covering= keyread || index_covers_read_set(idx);
+  /* Set again by read_range_first(); the index condition checks it. */
+  end_range= NULL;
+  DBUG_RETURN(0);
+}
+
+
+int ha_ldb::index_end()
+{
+  DBUG_ENTER("ha_ldb::index_end");
+  delete index_iter;
+  index_iter= NULL;
+  point_read= false;
+  active_index= MAX_KEY;
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Positions it on the last entry whose key is below every key prefixed by
+  key, i.e. the last entry with that prefix if there is one.
+*/
+
+static void ldb_seek_last_with_prefix(leveldb::Iterator *it, const std::string &key)
+{
+  std::string past_prefix(key);
+
+  if (key_successor(past_prefix))
+  {
+    it->Seek(past_prefix);
+    if (it->Valid())
+    {
+      it->Prev();
+      return;
+    }
+  }
+  it->SeekToLast();
+}
+
+
+/**
+  @brief
+  Positions an index cursor to the index specified in the handle. Fetches the
+  row if available. If the key value is null, begin at the first key of the
+  index.
+
+  @details
+  Keys are stored in leveldb order, so every find_flag maps onto a Seek of
+  the persistent index cursor, optionally followed by one Prev. Landing
+  outside the keyspace of the index is detected by read_index_row().
+  An exact match on the whole primary key is a point read instead.
+*/
+int ha_ldb::index_read(uchar *buf, const uchar *key, uint key_len, ha_rkey_function find_flag)
+{
+  int rc;
+  DBUG_ENTER("ha_ldb::index_read");
+  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
+
+  std::string &skey= seek_key;
+  std::string past_prefix;
+  bool match_prefix= false;
+  leveldb::Iterator *it;
+
+  skey.clear();
+  if (key)
+    pack_key(active_index, key, key_len, skey);
+  else
+    key_prefix(active_index, skey);
+
+  point_read= false;
+  if (find_flag == HA_READ_KEY_EXACT && key && !icp_cond &&
+      active_index == table->s->primary_key &&
+      key_len >= table->key_info[active_index].key_length)
+  {
+    rc= read_point_row(buf, skey);
+    goto end;
+  }
+  it= index_cursor();
+
+  switch (find_flag) {
+  case HA_READ_KEY_EXACT:
+  case HA_READ_PREFIX:
+    match_prefix= true;
+    /* fall through */
+  case HA_READ_KEY_OR_NEXT:
+    it->Seek(skey);
+    break;
+  case HA_READ_AFTER_KEY:
+    past_prefix= skey;
+    if (key_successor(past_prefix))
+      it->Seek(past_prefix);
+    else
+    {
+      /* Nothing sorts after the key: leave the cursor past the end. */
+      it->SeekToLast();
+      if (it->Valid())
+        it->Next();
+    }
+    break;
+  case HA_READ_BEFORE_KEY:
+    it->Seek(skey);
+    if (it->Valid())
+      it->Prev();
+    else
+      it->SeekToLast();
+    break;
+  case HA_READ_PREFIX_LAST:
+    match_prefix= true;
+    /* fall through */
+  case HA_READ_KEY_OR_PREV:
+  case HA_READ_PREFIX_LAST_OR_PREV:
+    ldb_seek_last_with_prefix(it, skey);
+    break;
+  default:
+    rc= HA_ERR_WRONG_COMMAND;
+    goto end;
+  }
+
+  if (match_prefix && it->Valid() && !it->key().starts_with(skey))
+  {
+    table->status= STATUS_NOT_FOUND;
+    rc= HA_ERR_KEY_NOT_FOUND;
+    goto end;
+  }
+  if (icp_cond)
+    icp_bound.assign(match_prefix ? skey : index_prefix);
+  rc= read_index_row(buf, HA_ERR_KEY_NOT_FOUND,
+                     find_flag == HA_READ_KEY_EXACT ||
+                     find_flag == HA_READ_PREFIX ||
+                     find_flag == HA_READ_KEY_OR_NEXT ||
+                     find_flag == HA_READ_AFTER_KEY);
+
+end:
+  MYSQL_INDEX_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  Reads the last row with the given key prefix.
+*/
+
+int ha_ldb::index_read_last(uchar *buf, const uchar *key, uint key_len)
+{
+  DBUG_ENTER("ha_ldb::index_read_last");
+  DBUG_RETURN(index_read(buf, key, key_len, HA_READ_PREFIX_LAST));
+}
+
+
+/**
+  @brief
+  Starts reading the rows of several ranges of the active index. When every
+  range is a single primary key value, as for pk IN (...) or a range
+  optimized join on the primary key, the rows are fetched in batches by
+  MultiGet(), which reads each table file once per batch instead of once
+  per key. Other ranges are read one by one by the default implementation.
+
+  @details
+  The ranges come sorted from the optimizer and the rows are returned in
+  range order, so sorted reads need no extra work.
+
+  @see
+  QUICK_RANGE_SELECT::get_next() in opt_range.cc
+*/
+
+int ha_ldb::read_multi_range_first(KEY_MULTI_RANGE **found_range_p,
+                                   KEY_MULTI_RANGE *ranges, uint range_count,
+                                   bool sorted, HANDLER_BUFFER *buffer)
+{
+  DBUG_ENTER("ha_ldb::read_multi_range_first");
+
+  mrr_batched= (active_index == table->s->primary_key);
+  for (uint i= 0; mrr_batched && i < range_count; i++)
+  {
+    if ((ranges[i].range_flag & (UNIQUE_RANGE | NULL_RANGE)) != UNIQUE_RANGE)
+      mrr_batched= false;
+  }
+  if (!mrr_batched)
+    DBUG_RETURN(handler::read_multi_range_first(found_range_p, ranges,
+                                                range_count, sorted, buffer));
+
+  multi_range_sorted= sorted;
+  multi_range_buffer= buffer;
+  multi_range_curr= ranges;
+  multi_range_end= ranges + range_count;
+  mrr_batch_count= mrr_batch_pos= 0;
+  DBUG_RETURN(read_multi_range_next(found_range_p));
+}
+
+
+/**
+  @brief
+  Looks up the rows of the next ranges, from multi_range_curr on. Pending
+  changes of the transaction are taken from its batch, the other keys are
+  read by one MultiGet().
+*/
+
+void ha_ldb::fill_mrr_batch()
+{
+  trx_t *trx= get_trx(ldb_hton, ha_thd());
+  std::string keys[LDB_MRR_BATCH_KEYS];
+  std::vector<leveldb::Slice> lookup_keys;
+  std::vector<uint> lookup_pos;
+  std::vector<std::string> values;
+
+  mrr_batch_count= LDB_MRR_BATCH_KEYS;
+  set_if_smaller(mrr_batch_count, (uint) (multi_range_end - multi_range_curr));
+  mrr_batch_pos= 0;
+
+  for (uint i= 0; i < mrr_batch_count; i++)
+  {
+    const key_range *start= &multi_range_curr[i].start_key;
+    bool deleted;
+
+    pack_key(active_index, start->key, start->length, keys[i]);
+    if (trx->batch.Get(keys[i], &mrr_values[i], &deleted))
+    {
+      mrr_status[i]= deleted ? leveldb::Status::NotFound(keys[i]) :
+                               leveldb::Status::OK();
+      continue;
+    }
+    lookup_keys.push_back(keys[i]);
+    lookup_pos.push_back(i);
+  }
+  if (lookup_keys.empty())
+    return;
+
+  std::vector<leveldb::Status> status=
+    share->db->MultiGet(read_options(), lookup_keys, &values);
+  for (uint i= 0; i < lookup_pos.size(); i++)
+  {
+    mrr_status[lookup_pos[i]]= status[i];
+    mrr_values[lookup_pos[i]].swap(values[i]);
+  }
+}
+
+
+/**
+  @brief
+  Returns the row of the next range that has one.
+*/
+
+int ha_ldb::read_multi_range_next(KEY_MULTI_RANGE **found_range_p)
+{
+  DBUG_ENTER("ha_ldb::read_multi_range_next");
+  if (!mrr_batched)
+    DBUG_RETURN(handler::read_multi_range_next(found_range_p));
+
+  while (multi_range_curr < multi_range_end)
+  {
+    if (mrr_batch_pos == mrr_batch_count)
+      fill_mrr_batch();
+
+    uint pos= mrr_batch_pos++;
+    KEY_MULTI_RANGE *range= multi_range_curr++;
+    if (mrr_status[pos].ok())
+    {
+      *found_range_p= range;
+      DBUG_RETURN(unpack_row(table->record[0], mrr_values[pos]));
+    }
+    if (!mrr_status[pos].IsNotFound())
+    {
+      table->status= STATUS_NOT_FOUND;
+      DBUG_RETURN(HA_ERR_INTERNAL_ERROR);
+    }
+  }
+  table->status= STATUS_NOT_FOUND;
+  DBUG_RETURN(HA_ERR_END_OF_FILE);
+}
+
+
+/**
+  @brief
+  Decodes a stored value written by pack_row() straight into the record
+  buffer buf. Blobs keep pointing into row_blobs until the next call.
+*/
+
+int ha_ldb::unpack_row(uchar *buf, const leveldb::Slice &value)
+{
+  const uchar *from= (const uchar*) value.data();
+  const uchar *end= from + value.size();
+  uint null_bytes= table->s->null_bytes;
+
+  if (table->s->blob_fields)
+  {
+    row_blobs.assign(value.data(), value.size());
+    from= (const uchar*) row_blobs.data();
+    end= from + row_blobs.size();
+  }
+
+  table->status= STATUS_NOT_FOUND;
+  if (from == end || *from != LDB_ROW_FORMAT_VERSION)
+    return HA_ERR_TABLE_NEEDS_UPGRADE;
+  from++;
+  if ((size_t) (end - from) < null_bytes)
+    return HA_ERR_WRONG_IN_RECORD;
+  memcpy(buf, from, null_bytes);
+  if (!ldb_unpack_fields(row_fields, buf - table->record[0],
+                         from + null_bytes, end, NULL))
+    return HA_ERR_WRONG_IN_RECORD;
+
+  table->status= 0;
+  return 0;
+}
+
+
+/**
+  @brief
+  Read options of the current statement: every read sees the snapshot of
+  the transaction, see ldb_register_stmt().
+*/
+
+leveldb::ReadOptions ha_ldb::read_options() const
+{
+  leveldb::ReadOptions ro;
+  ro.snapshot= snapshot;
+  return ro;
+}
+
+
+/**
+  @brief
+  Returns an iterator over the statement snapshot with the pending changes
+  of the transaction on top of it, so a transaction reads its own writes.
+  Blocks read by an iterator without fill_cache bypass the block cache.
+*/
+
+leveldb::Iterator *ha_ldb::new_iterator(bool fill_cache)
+{
+  trx_t *trx= get_trx(ldb_hton, ha_thd());
+  leveldb::ReadOptions ro= read_options();
+  ro.fill_cache= fill_cache;
+  return trx->batch.NewIteratorWithBase(share->db->NewIterator(ro));
+}
+
+
+/**
+  @brief
+  Reads the value of key, looking at the pending changes of the transaction
+  before the statement snapshot, which is read through the row cache.
+*/
+
+leveldb::Status ha_ldb::get_row(const leveldb::Slice &key, std::string *value)
+{
+  bool deleted;
+  trx_t *trx= get_trx(ldb_hton, ha_thd());
+
+  if (trx->batch.Get(key, value, &deleted))
+    return deleted ? leveldb::Status::NotFound(key) : leveldb::Status::OK();
+  if (ldb_row_cache)
+    return ldb_row_cache_get(snapshot, key, value);
+  return share->db->Get(read_options(), key, value);
+}
+
+
+/* Decoding target of a row read by ha_ldb::read_row(). */
+typedef struct st_ldb_read_row {
+  ha_ldb *handler;
+  uchar *buf;
+  int rc;
+} LDB_READ_ROW;
+
+
+void ha_ldb::unpack_read_row(void *arg, const leveldb::Slice &value)
+{
+  LDB_READ_ROW *read= (LDB_READ_ROW*) arg;
+  read->rc= read->handler->unpack_row(read->buf, value);
+}
+
+
+/**
+  @brief
+  Reads the row of key into buf, from the same places as get_row(). The
+  value is decoded where it is found instead of being copied out first:
+  in the batch, or in leveldb by unpack_read_row(). Only a row from the
+  row cache is copied, into row_value.
+*/
+
+int ha_ldb::read_row(const leveldb::Slice &key, uchar *buf)
+{
+  leveldb::Slice value;
+  leveldb::Status s;
+  bool deleted;
+  trx_t *trx= get_trx(ldb_hton, ha_thd());
+
+  if (trx->batch.Get(key, &value, &deleted))
+  {
+    if (!deleted)
+      return unpack_row(buf, value);
+  }
+  else if (ldb_row_cache)
+  {
+    s= ldb_row_cache_get(snapshot, key, &row_value);
+    if (s.ok())
+      return unpack_row(buf, row_value);
+  }
+  else
+  {
+    LDB_READ_ROW read= { this, buf, 0 };
+    s= share->db->Get(read_options(), key, &read, unpack_read_row);
+    if (s.ok())
+      return read.rc;
+  }
+  table->status= STATUS_NOT_FOUND;
+  return s.ok() || s.IsNotFound() ? HA_ERR_KEY_NOT_FOUND
+                                  : HA_ERR_INTERNAL_ERROR;
+}
+
+
+/**
+  @brief
+  Used to read forward through the index.
+*/
+
+int ha_ldb::index_next(uchar *buf)
+{
+  int rc;
+  DBUG_ENTER("ha_ldb::index_next");
+  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
+  leveldb::Iterator *it= index_cursor();
+  if (it->Valid())
+    it->Next();
+  rc= read_index_row(buf, HA_ERR_END_OF_FILE, true);
+  MYSQL_INDEX_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  Used to read backwards through the index.
+*/
+
+int ha_ldb::index_prev(uchar *buf)
+{
+  int rc;
+  DBUG_ENTER("ha_ldb::index_prev");
+  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
+  leveldb::Iterator *it= index_cursor();
+  if (it->Valid())
+    it->Prev();
+  rc= read_index_row(buf, HA_ERR_END_OF_FILE, false);
+  MYSQL_INDEX_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  index_first() asks for the first key in the index.
+
+  @details
+  Called from opt_range.cc, opt_sum.cc, sql_handler.cc, and sql_select.cc.
+
+  @see
+  opt_range.cc, opt_sum.cc, sql_handler.cc and sql_select.cc
+*/
+int ha_ldb::index_first(uchar *buf)
+{
+  int rc;
+  DBUG_ENTER("ha_ldb::index_first");
+  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
+  point_read= false;
+  index_cursor()->Seek(index_prefix);
+  if (icp_cond)
+    icp_bound.assign(index_prefix);
+  rc= read_index_row(buf, HA_ERR_END_OF_FILE, true);
+  MYSQL_INDEX_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  index_last() asks for the last key in the index.
+
+  @details
+  Called from opt_range.cc, opt_sum.cc, sql_handler.cc, and sql_select.cc.
+
+  @see
+  opt_range.cc, opt_sum.cc, sql_handler.cc and sql_select.cc
+*/
+int ha_ldb::index_last(uchar *buf)
+{
+  int rc;
+  DBUG_ENTER("ha_ldb::index_last");
+  MYSQL_INDEX_READ_ROW_START(table_share->db.str, table_share->table_name.str);
+  point_read= false;
+  ldb_seek_last_with_prefix(index_cursor(), index_prefix);
+  if (icp_cond)
+    icp_bound.assign(index_prefix);
+  rc= read_index_row(buf, HA_ERR_END_OF_FILE, false);
+  MYSQL_INDEX_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  rnd_init() is called when the system wants the storage engine to do a table
+  scan. See the ldb in the introduction at the top of this file to see when
+  rnd_init() is called.
+
+  @details
+  Called from filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc,
+  and sql_update.cc.
+
+  @see
+  filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc and sql_update.cc
+*/
+int ha_ldb::rnd_init(bool scan)
+{
+  DBUG_ENTER("ha_ldb::rnd_init");
+
+  scan_prefix.clear();
+  key_prefix(table->s->primary_key, scan_prefix);
+  /* A new cursor is opened by the first rnd_next(), after the hints. */
+  if (scan_iter)
+    scan_iter->Seek(scan_prefix);
+  scan_batch_count= scan_batch_pos= 0;
+
+  DBUG_RETURN(0);
+}
+
+int ha_ldb::rnd_end()
+{
+  DBUG_ENTER("ha_ldb::rnd_end");
+  delete scan_iter;
+  scan_iter= NULL;
+  scan_batch_count= scan_batch_pos= 0;
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Evaluates the pushed scan condition on a stored row, decoding only the
+  fields the condition reads into record[0]. A row that cannot be decoded
+  matches, so that unpack_row() reports it.
+*/
+
+bool ha_ldb::scan_cond_matches(const leveldb::Slice &value)
+{
+  const uchar *from= (const uchar*) value.data();
+  const uchar *end= from + value.size();
+  uint null_bytes= table->s->null_bytes;
+
+  if (value.size() < 1 + null_bytes || *from != LDB_ROW_FORMAT_VERSION)
+    return true;
+  memcpy(table->record[0], from + 1, null_bytes);
+  if (!ldb_unpack_fields(row_fields, 0, from + 1 + null_bytes, end,
+                         &scan_cond_fields))
+    return true;
+  return ((Item*) scan_cond)->val_int() != 0;
+}
+
+
+/**
+  @brief
+  Refills the read-ahead batch from scan_iter. Returns HA_ERR_END_OF_FILE
+  when the primary key keyspace is exhausted. If filter is set, rows that
+  fail the pushed scan condition are skipped inside the loop.
+*/
+
+int ha_ldb::fill_scan_batch(bool filter)
+{
+  scan_batch_count= scan_batch_pos= 0;
+  if (!scan_iter)
+  {
+    scan_iter= new_iterator(scan_fill_cache);
+    scan_iter->Seek(scan_prefix);
+  }
+
+  for (; scan_batch_count < LDB_SCAN_BATCH_ROWS && scan_iter->Valid() &&
+         scan_iter->key().starts_with(scan_prefix);
+       scan_iter->Next())
+  {
+    leveldb::Slice value= scan_iter->value();
+    if (filter && !scan_cond_matches(value))
+      continue;
+    scan_values[scan_batch_count++].assign(value.data(), value.size());
+  }
+
+  if (!scan_iter->status().ok())
+    return HA_ERR_INTERNAL_ERROR;
+  return scan_batch_count ? 0 : HA_ERR_END_OF_FILE;
+}
+
+
+/**
+  @brief
+  This is called for each row of the table scan. When you run out of records
+  you should return HA_ERR_END_OF_FILE. Fill buff up with the row information.
+  The Field structure for the table is the key to getting data into buf
+  in a manner that will allow the server to understand it.
+
+  @details
+  Called from filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc,
+  and sql_update.cc.
+
+  @see
+  filesort.cc, records.cc, sql_handler.cc, sql_select.cc, sql_table.cc and sql_update.cc
+*/
+int ha_ldb::rnd_next(uchar *buf)
+{
+  int rc= 0;
+  DBUG_ENTER("ha_ldb::rnd_next");
+  MYSQL_READ_ROW_START(table_share->db.str, table_share->table_name.str,
+                       TRUE);
+
+  /* The pushed condition reads its fields from record[0]. */
+  if (scan_batch_pos == scan_batch_count)
+    rc= fill_scan_batch(scan_cond && buf == table->record[0]);
+
+  if (!rc)
+    rc= unpack_row(buf, scan_values[scan_batch_pos++]);
+  else
+    table->status= STATUS_NOT_FOUND;
+
+  MYSQL_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  position() is called after each call to rnd_next() if the data needs
+  to be ordered. You can do something like the following to store
+  the position:
+  @code
+  my_store_ptr(ref, ref_length, current_position);
+  @endcode
+
+  @details
+  The server uses ref to store data. ref_length in the above case is
+  the size needed to store current_position. ref is just a byte array
+  that the server will maintain. If you are using offsets to mark rows, then
+  current_position should be the offset. If it is a primary key like in
+  BDB, then it needs to be a primary key.
+
+  Called from filesort.cc, sql_select.cc, sql_delete.cc, and sql_update.cc.
+
+  @see
+  filesort.cc, sql_select.cc, sql_delete.cc and sql_update.cc
+*/
+void ha_ldb::position(const uchar *record)
+{
+  DBUG_ENTER("ha_ldb::position");
+
+  std::string &key= row_key;
+  key.clear();
+  pack_record_key(table->s->primary_key, record, key);
+  DBUG_ASSERT(sizeof(uint16) + key.length() <= ref_length);
+
+  int2store(ref, key.length());
+  memcpy(ref + sizeof(uint16), key.data(), key.length());
+
+  DBUG_VOID_RETURN;
+}
+
+
+/**
+  @brief
+  This is like rnd_next, but you are given a position to use
+  to determine the row. The position will be of the type that you stored in
+  ref. You can use ha_get_ptr(pos,ref_length) to retrieve whatever key
+  or position you saved when position() was called.
+
+  @details
+  Called from filesort.cc, records.cc, sql_insert.cc, sql_select.cc, and sql_update.cc.
+
+  @see
+  filesort.cc, records.cc, sql_insert.cc, sql_select.cc and sql_update.cc
+*/
+int ha_ldb::rnd_pos(uchar *buf, uchar *pos)
+{
+  int rc;
+  DBUG_ENTER("ha_ldb::rnd_pos");
+  MYSQL_READ_ROW_START(table_share->db.str, table_share->table_name.str,
+                       TRUE);
+
+  leveldb::Slice key((char*) pos + sizeof(uint16), uint2korr(pos));
+  rc= read_row(key, buf);
+
+  MYSQL_READ_ROW_DONE(rc);
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  Returns the approximate size of the table files holding the keys in
+  [start, limit). Keys still in the memtables are not counted.
+*/
+
+static ulonglong ldb_approximate_size(leveldb::DB *db, const std::string &start,
+                                      const std::string &limit)
+{
+  leveldb::Range range(start, limit);
+  uint64_t size;
+  db->GetApproximateSizes(&range, 1, &size);
+  return size;
+}
+
+
+/**
+  @brief
+  ::info() is used to return information to the optimizer. See my_base.h for
+  the complete description.
+
+  @details
+  Currently this table handler doesn't implement most of the fields really needed.
+  SHOW also makes use of this data.
+
+  You will probably want to have the following in your code:
+  @code
+  if (records < 2)
+    records = 2;
+  @endcode
+  The reason is that the server will optimize for cases of only a single
+  record. If, in a table scan, you don't know the number of records, it
+  will probably be better to set records to two so you can return as many
+  records as you need. Along with records, a few more variables you may wish
+  to set are:
+    records
+    deleted
+    data_file_length
+    index_file_length
+    delete_length
+    check_time
+  Take a look at the public variables in handler.h for more information.
+
+  Called in filesort.cc, ha_heap.cc, item_sum.cc, opt_sum.cc, sql_delete.cc,
+  sql_delete.cc, sql_derived.cc, sql_select.cc, sql_select.cc, sql_select.cc,
+  sql_select.cc, sql_select.cc, sql_show.cc, sql_show.cc, sql_show.cc, sql_show.cc,
+  sql_table.cc, sql_union.cc, and sql_update.cc.
+
+  @see
+  filesort.cc, ha_heap.cc, item_sum.cc, opt_sum.cc, sql_delete.cc, sql_delete.cc,
+  sql_derived.cc, sql_select.cc, sql_select.cc, sql_select.cc, sql_select.cc,
+  sql_select.cc, sql_show.cc, sql_show.cc, sql_show.cc, sql_show.cc, sql_table.cc,
+  sql_union.cc and sql_update.cc
+*/
+int ha_ldb::info(uint flag)
+{
+  DBUG_ENTER("ha_ldb::info");
+
+  if (flag & HA_STATUS_ERRKEY)
+    errkey= dup_key;
+
+  if (flag & HA_STATUS_VARIABLE)
+  {
+    ulonglong data_size= 0;
+    ulonglong index_size= 0;
+    ha_rows records;
+    ulong mean_rec_length;
+
+    /*
+      The primary key range holds the rows, the other ranges the secondary
+      entries. Rows still in the memtables are not counted.
+    */
+    for (uint i= 0; i < table->s->keys; i++)
+    {
+      std::string start;
+      std::string limit;
+      key_prefix(i, start);
+      limit= start;
+      key_successor(limit);
+      if (i == table->s->primary_key)
+        data_size= ldb_approximate_size(share->db, start, limit);
+      else
+        index_size+= ldb_approximate_size(share->db, start, limit);
+    }
+
+    /*
+      ANALYZE TABLE counted the rows once; scale the count by how much the
+      table grew or shrank since. Without statistics assume rows are as
+      long as the record buffer.
+    */
+    mysql_mutex_lock(&share->mutex);
+    if (share->stats_valid)
+    {
+      records= share->stats_records;
+      mean_rec_length= share->stats_mean_rec_length;
+      if (share->stats_data_size && data_size)
+        records= (ha_rows) (rows2double(records) * ulonglong2double(data_size) /
+                            ulonglong2double(share->stats_data_size));
+    }
+    else
+    {
+      mean_rec_length= table->s->reclength;
+      records= (ha_rows) (data_size / max(mean_rec_length, 1));
+    }
+    mysql_mutex_unlock(&share->mutex);
+
+    /* Never let the optimizer assume 0 or 1 rows from an estimate. */
+    stats.records= max(records, 2);
+    stats.deleted= 0;
+    stats.data_file_length= data_size;
+    stats.index_file_length= index_size;
+    stats.mean_rec_length= mean_rec_length;
+    stats.block_size= IO_SIZE;
+  }
+
+  if ((flag & HA_STATUS_CONST) && share->stats_valid)
+  {
+    ulong *rec_per_key= share->rec_per_key;
+
+    mysql_mutex_lock(&share->mutex);
+    for (uint i= 0; i < table->s->keys; i++)
+    {
+      KEY *key_info= table->key_info + i;
+      for (uint j= 0; j < key_info->key_parts; j++)
+        key_info->rec_per_key[j]= *rec_per_key++;
+    }
+    mysql_mutex_unlock(&share->mutex);
+  }
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Counts the rows of the table and, for every key part of every index, the
+  mean number of entries per distinct value of the key prefix up to it.
+  The statistics are kept in the dictionary and read by info().
+*/
+
+int ha_ldb::analyze(THD* thd, HA_CHECK_OPT* check_opt)
+{
+  DBUG_ENTER("ha_ldb::analyze");
+
+  uint pk= table->s->primary_key;
+  ha_rows records= 0;
+  ulonglong row_bytes= 0;
+  ulonglong data_size= 0;
+  std::vector<ulong> rec_per_key;
+  std::vector<ulonglong> distinct;
+  leveldb::ReadOptions ro;
+  leveldb::Status s;
+
+  ro.fill_cache= false;
+  leveldb::Iterator *it= share->db->NewIterator(ro);
+
+  for (uint i= 0; i < table->s->keys && s.ok(); i++)
+  {
+    const LDB_KEY_DEF *def= key_defs + i;
+    std::string prefix;
+    std::string limit;
+    std::string last;
+    ha_rows entries= 0;
+
+    key_prefix(i, prefix);
+    distinct.assign(def->part_count, 0);
+
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+         it->Next())
+    {
+      leveldb::Slice entry= it->key();
+      entry.remove_prefix(prefix.length());
+
+      /* Every part from the first that differs from the last entry on. */
+      for (uint j= 0; j < def->part_count; j++)
+      {
+        uint length= ldb_encoded_parts_length(def, j + 1, entry);
+        if (!entries || last.size() < length ||
+            memcmp(last.data(), entry.data(), length))
+        {
+          for (; j < def->part_count; j++)
+            distinct[j]++;
+        }
+      }
+      if (i == pk)
+        row_bytes+= it->key().size() + it->value().size();
+      last.assign(entry.data(), entry.size());
+      entries++;
+
+      if (thd_killed(thd))
+      {
+        delete it;
+        DBUG_RETURN(HA_ADMIN_FAILED);
+      }
+    }
+    s= it->status();
+
+    for (uint j= 0; j < def->part_count; j++)
+      rec_per_key.push_back(distinct[j] ? (ulong) (entries / distinct[j]) : 0);
+
+    if (i == pk)
+    {
+      records= entries;
+      limit= prefix;
+      key_successor(limit);
+      data_size= ldb_approximate_size(share->db, prefix, limit);
+    }
+  }
+  delete it;
+  if (!s.ok())
+    DBUG_RETURN(HA_ADMIN_FAILED);
+
+  mysql_mutex_lock(&share->mutex);
+  share->stats_records= records;
+  share->stats_data_size= data_size;
+  share->stats_mean_rec_length= records ? (ulong) (row_bytes / records) : 0;
+  for (uint i= 0; i < share->rec_per_key_count; i++)
+    share->rec_per_key[i]= rec_per_key[i];
+  share->stats_valid= true;
+  bool failed= ldb_store_stats(share);
+  mysql_mutex_unlock(&share->mutex);
+
+  info(HA_STATUS_CONST | HA_STATUS_VARIABLE);
+  DBUG_RETURN(failed ? HA_ADMIN_FAILED : HA_ADMIN_OK);
+}
+
+
+/**
+  @brief
+  extra() is called whenever the server wishes to send a hint to
+  the storage engine. The myisam engine implements the most hints.
+  ha_innodb.cc has the most exhaustive list of these hints.
+
+  @details
+  HA_EXTRA_KEYREAD makes index reads decode the key columns only, even
+  from the primary key, whose value is then left alone.
+  HA_EXTRA_CACHE announces a sequential scan of the whole table: its blocks
+  are read without filling the block cache, so that a big scan does not
+  evict the working set of the point reads.
+  HA_EXTRA_WRITE_CAN_REPLACE is sent by REPLACE when a duplicate row may be
+  overwritten in place.
+
+    @see
+  ha_innodb.cc
+*/
+int ha_ldb::extra(enum ha_extra_function operation)
+{
+  DBUG_ENTER("ha_ldb::extra");
+
+  switch (operation) {
+  case HA_EXTRA_KEYREAD:
+    keyread= true;
+    if (inited == INDEX)
+      keyread_covering= true;
+    break;
+  case HA_EXTRA_NO_KEYREAD:
+    keyread= false;
+    if (inited == INDEX)
+      keyread_covering= index_covers_read_set(active_index);
+    break;
+  case HA_EXTRA_CACHE:
+    scan_fill_cache= false;
+    break;
+  case HA_EXTRA_NO_CACHE:
+    scan_fill_cache= true;
+    break;
+  case HA_EXTRA_WRITE_CAN_REPLACE:
+    write_can_replace= true;
+    break;
+  case HA_EXTRA_WRITE_CANNOT_REPLACE:
+    write_can_replace= false;
+    break;
+  default:
+    break;
+  }
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Called after every statement: the pushed conditions and the hints
+  belong to the statement that gave them.
+*/
+
+int ha_ldb::reset()
+{
+  DBUG_ENTER("ha_ldb::reset");
+  keyread= false;
+  scan_fill_cache= true;
+  write_can_replace= false;
+  scan_cond= NULL;
+  icp_cond= NULL;
+  icp_keyno= MAX_KEY;
+  DBUG_RETURN(0);
+}
+
+
+typedef struct st_ldb_cond_fields {
+  TABLE *table;
+  MY_BITMAP *fields;
+  bool pushable;
+} LDB_COND_FIELDS;
+
+
+static void ldb_collect_cond_fields(const Item *item, void *arg)
+{
+  LDB_COND_FIELDS *cond_fields= (LDB_COND_FIELDS*) arg;
+
+  if (!item)                            // End of the arguments of a function
+    return;
+  switch (item->type()) {
+  case Item::FIELD_ITEM:
+  {
+    Field *field= ((const Item_field*) item)->field;
+    if (field->table == cond_fields->table)
+      bitmap_set_bit(cond_fields->fields, field->field_index);
+    else
+      cond_fields->pushable= false;
+    break;
+  }
+  case Item::FUNC_ITEM:
+    switch (((const Item_func*) item)->functype()) {
+    case Item_func::FUNC_SP:
+    case Item_func::SUSERVAR_FUNC:
+      cond_fields->pushable= false;
+      break;
+    default:
+      break;
+    }
+    break;
+  case Item::REF_ITEM:
+  case Item::SUBSELECT_ITEM:
+  case Item::SUM_FUNC_ITEM:
+    cond_fields->pushable= false;
+    break;
+  default:
+    break;
+  }
+}
+
+
+/**
+  @brief
+  Takes over the condition of a table scan when it only reads fields of
+  this table: rnd_next() then decodes just those fields of each row and
+  skips the rows that fail it. The server still evaluates the condition
+  on the rows returned.
+
+  @details
+  Conditions on other tables are refused, since their fields do not hold
+  the right row while a join buffer is being matched.
+*/
+
+const COND *ha_ldb::cond_push(const COND *cond)
+{
+  LDB_COND_FIELDS cond_fields;
+  DBUG_ENTER("ha_ldb::cond_push");
+
+  scan_cond= NULL;
+  if (cond->used_tables() & ~table->map)
+    DBUG_RETURN(cond);
+
+  bitmap_clear_all(&scan_cond_fields);
+  cond_fields.table= table;
+  cond_fields.fields= &scan_cond_fields;
+  cond_fields.pushable= true;
+  ((COND*) cond)->traverse_cond(ldb_collect_cond_fields, &cond_fields,
+                                Item::PREFIX);
+  if (!cond_fields.pushable)
+    DBUG_RETURN(cond);
+
+  scan_cond= cond;
+  DBUG_RETURN(NULL);
+}
+
+
+void ha_ldb::cond_pop()
+{
+  DBUG_ENTER("ha_ldb::cond_pop");
+  scan_cond= NULL;
+  DBUG_VOID_RETURN;
+}
+
+
+/**
+  @brief
+  Takes over a condition on the columns of index keyno. It is checked on
+  the decoded key of each entry before the row is fetched (secondary
+  indexes) or decoded (primary key); see read_index_row().
+*/
+
+Item *ha_ldb::idx_cond_push(uint keyno, Item *idx_cond)
+{
+  DBUG_ENTER("ha_ldb::idx_cond_push");
+  if (!key_defs[keyno].decodable ||
+      !key_defs[table->s->primary_key].decodable)
+    DBUG_RETURN(idx_cond);
+  icp_cond= idx_cond;
+  icp_keyno= keyno;
+  DBUG_RETURN(NULL);
+}
+
+
+/**
+  @brief
+  Removes the table files that hold keys of table table_id only. The id
+  must already be dropped: its keys in the files shared with other tables
+  stay hidden until the compactions discard them.
+*/
+
+static void ldb_delete_table_files(uint32 table_id)
+{
+  std::string begin;
+  std::string end;
+
+  ldb_table_prefix(table_id, begin);
+  ldb_table_prefix(table_id + 1, end);
+  leveldb::Status s= ldb_db->DeleteFilesInRange(begin, end);
+  if (!s.ok())
+    sql_print_warning("LEVELDB: cannot delete the files of table %u: %s",
+                      table_id, s.ToString().c_str());
+}
+
+
+/**
+  @brief
+  Empties the table of share by moving its name to a new table id and
+  dropping the old id, like delete_table() does. The caller must keep
+  every other handler of the table out.
+*/
+
+static int ldb_recreate_table(LEVELDB_SHARE *share)
+{
+  uint32 old_id;
+  uint32 new_id;
+  std::string key;
+  char id[LDB_TABLE_ID_LENGTH];
+  leveldb::WriteBatch batch;
+
+  mysql_mutex_lock(&ldb_mutex);
+  old_id= share->table_id;
+  new_id= ldb_next_table_id;
+
+  mi_int4store(id, new_id);
+  ldb_dict_key(LDB_DICT_TABLE, share->table_name, share->table_name_length,
+               key);
+  batch.Put(key, leveldb::Slice(id, LDB_TABLE_ID_LENGTH));
+
+  mi_int4store(id, new_id + 1);
+  key.clear();
+  ldb_dict_key(LDB_DICT_NEXT_ID, "", 0, key);
+  batch.Put(key, leveldb::Slice(id, LDB_TABLE_ID_LENGTH));
+
+  mi_int4store(id, old_id);
+  key.clear();
+  ldb_dict_key(LDB_DICT_DROPPED, id, LDB_TABLE_ID_LENGTH, key);
+  batch.Put(key, leveldb::Slice());
+  key.clear();
+  ldb_stats_key(old_id, key);
+  batch.Delete(key);
+
+  leveldb::Status s= ldb_db->Write(wo, &batch);
+  if (s.ok())
+  {
+    ldb_next_table_id++;
+    ldb_mark_dropped(old_id);
+    mysql_mutex_lock(&share->mutex);
+    share->table_id= new_id;
+    share->stats_valid= false;
+    mysql_mutex_unlock(&share->mutex);
+  }
+  mysql_mutex_unlock(&ldb_mutex);
+
+  if (!s.ok())
+    return HA_ERR_INTERNAL_ERROR;
+  ldb_delete_table_files(old_id);
+  return 0;
+}
+
+
+/**
+  @brief
+  Used to delete all rows in a table, including cases of truncate and cases where
+  the optimizer realizes that all rows will be removed as a result of an SQL statement.
+
+  @details
+  Called from item_sum.cc by Item_func_group_concat::clear(),
+  Item_sum_count_distinct::clear(), and Item_func_group_concat::clear().
+  Called from sql_delete.cc by mysql_delete().
+  Called from sql_select.cc by JOIN::reinit().
+  Called from sql_union.cc by st_select_lex_unit::exec().
+
+  @see
+  Item_func_group_concat::clear(), Item_sum_count_distinct::clear() and
+  Item_func_group_concat::clear() in item_sum.cc;
+  mysql_delete() in sql_delete.cc;
+  JOIN::reinit() in sql_select.cc and
+  st_select_lex_unit::exec() in sql_union.cc.
+
+  The table gets a new key space, which cannot be rolled back, so only an
+  autocommit statement does this; in a transaction the rows are deleted
+  one by one. The statement must also hold the table exclusively (a
+  TL_WRITE lock, which store_lock() only leaves under LOCK TABLES), so
+  that no other session reads the table or has uncommitted rows packed
+  with the old table id; a plain DELETE shares the table with other
+  writers and deletes its rows one by one too.
+*/
+int ha_ldb::delete_all_rows()
+{
+  DBUG_ENTER("ha_ldb::delete_all_rows");
+  if (thd_test_options(ha_thd(), OPTION_NOT_AUTOCOMMIT | OPTION_BEGIN) ||
+      lock.type != TL_WRITE)
+    DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  DBUG_RETURN(ldb_recreate_table(share));
+}
+
+
+/**
+  @brief
+  Used for handler specific truncate table.  The table is locked in
+  exclusive mode and handler is responsible for reseting the auto-
+  increment counter.
+
+  @details
+  Called from Truncate_statement::handler_truncate.
+  Not used if the handlerton supports HTON_CAN_RECREATE, unless this
+  engine can be used as a partition. In this case, it is invoked when
+  a particular partition is to be truncated.
+
+  @see
+  Truncate_statement in sql_truncate.cc
+  Remarks in handler::truncate.
+*/
+int ha_ldb::truncate()
+{
+  DBUG_ENTER("ha_ldb::truncate");
+  DBUG_RETURN(ldb_recreate_table(share));
+}
+
+
+/**
+  @brief
+  This create a lock on the table. If you are implementing a storage engine
+  that can handle transacations look at ha_berkely.cc to see how you will
+  want to go about doing this. Otherwise you should consider calling flock()
+  here. Hint: Read the section "locking functions for mysql" in lock.cc to understand
+  this.
+
+  @details
+  Called from lock.cc by lock_external() and unlock_external(). Also called
+  from sql_table.cc by copy_data_between_tables().
+
+  @see
+  lock.cc by lock_external() and unlock_external() in lock.cc;
+  the section "locking functions for mysql" in lock.cc;
+  copy_data_between_tables() in sql_table.cc.
+*/
+int ha_ldb::external_lock(THD *thd, int lock_type)
+{
+  DBUG_ENTER("ha_ldb::external_lock");
+  thd= current_thd;
+  trx_t *trx;
+  if (lock_type != F_UNLCK)
+  {
+    trx= get_trx(ldb_hton, thd);
+    if (!trx->tables_in_use++)
+      ldb_register_stmt(thd, trx);
+    snapshot= trx->snapshot;
+    DBUG_RETURN(0);
+  }
+  else
+  {
+    delete scan_iter;
+    scan_iter= NULL;
+    delete index_iter;
+    index_iter= NULL;
+    delete bulk_load;
+    bulk_load= NULL;
+    snapshot= NULL;
+
+    /*
+      The changes are written when the server commits, which also releases
+      the snapshot; an autocommit statement that is not committed releases
+      it here.
+    */
+    trx= (trx_t*) thd_get_ha_data(thd, ldb_hton);
+    if (trx && trx->tables_in_use && !--trx->tables_in_use)
+      ldb_release_snapshot(thd, trx, false);
+    DBUG_RETURN(0);
+  }
+}
+
+
+/**
+  @brief
+  Starts a statement on a table locked by LOCK TABLES, which does not
+  call external_lock() per statement.
+*/
+
+int ha_ldb::start_stmt(THD *thd, thr_lock_type lock_type)
+{
+  DBUG_ENTER("ha_ldb::start_stmt");
+
+  /* The cursors of the previous statement may refer to a committed batch. */
+  delete scan_iter;
+  scan_iter= NULL;
+  delete index_iter;
+  index_iter= NULL;
+  trx_t *trx= get_trx(ldb_hton, thd);
+  ldb_register_stmt(thd, trx);
+  snapshot= trx->snapshot;
+  DBUG_RETURN(0);
 }
 
 
@@ -901,255 +4397,1270 @@ int ha_ldb::external_lock(THD *thd, int lock_type)
   should be needed for the table. For updates/deletes/inserts we get WRITE
   locks, for SELECT... we get read locks.
 
-  @details
-  Before adding the lock into the table lock handler (see thr_lock.c),
-  mysqld calls store lock with the requested locks. Store lock can now
-  modify a write lock to a read lock (or some other lock), ignore the
-  lock (if we don't want to use MySQL table locks at all), or add locks
-  for many tables (like we do when we are using a MERGE handler).
+  @details
+  Before adding the lock into the table lock handler (see thr_lock.c),
+  mysqld calls store lock with the requested locks. Store lock can now
+  modify a write lock to a read lock (or some other lock), ignore the
+  lock (if we don't want to use MySQL table locks at all), or add locks
+  for many tables (like we do when we are using a MERGE handler).
+
+  Berkeley DB, for ldb, changes all WRITE locks to TL_WRITE_ALLOW_WRITE
+  (which signals that we are doing WRITES, but are still allowing other
+  readers and writers).
+
+  When releasing locks, store_lock() is also called. In this case one
+  usually doesn't have to do anything.
+
+  In some exceptional cases MySQL may send a request for a TL_IGNORE;
+  This means that we are requesting the same lock as last time and this
+  should also be ignored. (This may happen when someone does a flush
+  table when we have opened a part of the tables, in which case mysqld
+  closes and reopens the tables and tries to get the same locks at last
+  time). In the future we will probably try to remove this.
+
+  Called from lock.cc by get_lock_data().
+
+  @note
+  In this method one should NEVER rely on table->in_use, it may, in fact,
+  refer to a different thread! (this happens if get_lock_data() is called
+  from mysql_lock_abort_for_thread() function)
+
+  @see
+  get_lock_data() in lock.cc
+*/
+THR_LOCK_DATA **ha_ldb::store_lock(THD *thd,
+                                       THR_LOCK_DATA **to,
+                                       enum thr_lock_type lock_type)
+{
+  DBUG_ENTER("store_lock");
+
+  const bool in_lock_tables = thd_in_lock_tables(thd);
+  const uint sql_command = thd_sql_command(thd);
+  if ((lock_type >= TL_WRITE_CONCURRENT_INSERT
+       && lock_type <= TL_WRITE)
+       && !(in_lock_tables
+       && sql_command == SQLCOM_LOCK_TABLES)
+       && !thd_tablespace_op(thd)
+       && sql_command != SQLCOM_TRUNCATE
+       && sql_command != SQLCOM_OPTIMIZE
+       && sql_command != SQLCOM_CREATE_TABLE)
+  {
+    lock_type = TL_WRITE_ALLOW_WRITE;
+  }
+
+  if ( lock_type!=TL_IGNORE && lock.type==TL_UNLOCK )
+    lock.type=lock_type;
+
+  *to++ = &lock;
+  DBUG_RETURN(to);
+}
+/*
+{
+  if (lock_type != TL_IGNORE && lock.type == TL_UNLOCK)
+    lock.type=lock_type;
+  *to++= &lock;
+  return to;
+}
+*/
+
+/**
+  @brief
+  Used to delete a table. By the time delete_table() has been called all
+  opened references to this table will have been closed (and your globally
+  shared references released). The variable name will just be the name of
+  the table. You will need to remove any files you have created at this point.
+
+  @details
+  If you do not implement this, the default delete_table() is called from
+  handler.cc and it will delete all files with the file extensions returned
+  by bas_ext().
+
+  Called from handler.cc by delete_table and ha_create_table(). Only used
+  during create if the table_flag HA_DROP_BEFORE_CREATE was specified for
+  the storage engine.
+
+  @see
+  delete_table and ha_create_table() in handler.cc
+*/
+int ha_ldb::delete_table(const char *name)
+{
+  DBUG_ENTER("ha_ldb::delete_table");
+
+  int rc;
+  uint32 table_id;
+  std::string key;
+  char id[LDB_TABLE_ID_LENGTH];
+  leveldb::WriteBatch batch;
+
+  /*
+    Dropping only unlinks the name and records the id as dropped; the keys
+    of the table are hidden at once. The files holding nothing else are
+    removed right away, the rest is left to the compactions.
+  */
+  mysql_mutex_lock(&ldb_mutex);
+  if ((rc= ldb_lookup_table(name, &table_id)))
+  {
+    mysql_mutex_unlock(&ldb_mutex);
+    DBUG_RETURN(rc == HA_ERR_NO_SUCH_TABLE ? ENOENT : rc);
+  }
+  mi_int4store(id, table_id);
+  ldb_dict_key(LDB_DICT_TABLE, name, strlen(name), key);
+  batch.Delete(key);
+  key.clear();
+  ldb_dict_key(LDB_DICT_DROPPED, id, LDB_TABLE_ID_LENGTH, key);
+  batch.Put(key, leveldb::Slice());
+  key.clear();
+  ldb_stats_key(table_id, key);
+  batch.Delete(key);
+
+  leveldb::Status s= ldb_db->Write(wo, &batch);
+  if (s.ok())
+    ldb_mark_dropped(table_id);
+  mysql_mutex_unlock(&ldb_mutex);
+
+  if (!s.ok())
+    DBUG_RETURN(HA_ERR_INTERNAL_ERROR);
+  ldb_delete_table_files(table_id);
+  DBUG_RETURN(0);
+}
+
+
+/**
+  @brief
+  Renames a table from one name to another via an alter table call.
+
+  @details
+  If you do not implement this, the default rename_table() is called from
+  handler.cc and it will delete all files with the file extensions returned
+  by bas_ext().
+
+  Keys are prefixed by the table id, so only the dictionary entry moves.
+
+  Called from sql_table.cc by mysql_rename_table().
+
+  @see
+  mysql_rename_table() in sql_table.cc
+*/
+int ha_ldb::rename_table(const char * from, const char * to)
+{
+  DBUG_ENTER("ha_ldb::rename_table ");
+
+  int rc;
+  uint32 table_id;
+  std::string key;
+  char id[LDB_TABLE_ID_LENGTH];
+  leveldb::WriteBatch batch;
+
+  mysql_mutex_lock(&ldb_mutex);
+  if (!(rc= ldb_lookup_table(from, &table_id)))
+  {
+    mi_int4store(id, table_id);
+    ldb_dict_key(LDB_DICT_TABLE, from, strlen(from), key);
+    batch.Delete(key);
+    key.clear();
+    ldb_dict_key(LDB_DICT_TABLE, to, strlen(to), key);
+    batch.Put(key, leveldb::Slice(id, LDB_TABLE_ID_LENGTH));
+    if (!ldb_db->Write(wo, &batch).ok())
+      rc= HA_ERR_INTERNAL_ERROR;
+  }
+  mysql_mutex_unlock(&ldb_mutex);
+
+  DBUG_RETURN(rc);
+}
+
+
+/**
+  @brief
+  Given a starting key and an ending key, estimate the number of rows that
+  will exist between the two keys.
+
+  @details
+  end_key may be empty, in which case determine if start_key matches any rows.
+
+  Called from opt_range.cc by check_quick_keys().
+
+  @see
+  check_quick_keys() in opt_range.cc
+*/
+ha_rows ha_ldb::records_in_range(uint inx, key_range *min_key,
+                                     key_range *max_key)
+{
+  DBUG_ENTER("ha_ldb::records_in_range");
+
+  std::string index_start;
+  std::string index_limit;
+  std::string start;
+  std::string limit;
+  uint64_t sizes[2];
+  ha_rows rows= 0;
+
+  key_prefix(inx, index_start);
+  index_limit= index_start;
+  key_successor(index_limit);
+
+  /* min_key is >= or > (AFTER_KEY), max_key is < or <= (AFTER_KEY). */
+  if (min_key)
+  {
+    pack_key(inx, min_key->key, min_key->length, start);
+    if (min_key->flag == HA_READ_AFTER_KEY && !key_successor(start))
+      start= index_limit;
+  }
+  else
+    start= index_start;
+  if (max_key)
+  {
+    pack_key(inx, max_key->key, max_key->length, limit);
+    if (max_key->flag == HA_READ_AFTER_KEY && !key_successor(limit))
+      limit= index_limit;
+  }
+  else
+    limit= index_limit;
+
+  if (start >= limit)
+    DBUG_RETURN(1);
+
+  /*
+    The range holds its share of the entries of the index in the table
+    files. Small ranges, and ranges still in the memtables, are counted.
+  */
+  leveldb::Range ranges[2]= { leveldb::Range(start, limit),
+                              leveldb::Range(index_start, index_limit) };
+  share->db->GetApproximateSizes(ranges, 2, sizes);
+  if (sizes[1])
+    rows= (ha_rows) (rows2double(stats.records) * ulonglong2double(sizes[0]) /
+                     ulonglong2double(sizes[1]));
+
+  if (rows < LDB_RANGE_COUNT_LIMIT)
+  {
+    leveldb::ReadOptions ro= read_options();
+    ha_rows counted= 0;
+
+    ro.fill_cache= false;
+    leveldb::Iterator *it= share->db->NewIterator(ro);
+    for (it->Seek(start);
+         it->Valid() && counted < LDB_RANGE_COUNT_LIMIT &&
+         it->key().compare(limit) < 0;
+         it->Next())
+      counted++;
+    delete it;
+    rows= counted < LDB_RANGE_COUNT_LIMIT ? counted : max(rows, counted);
+  }
+
+  /* The optimizer takes 0 as proof that the range is empty. */
+  DBUG_RETURN(rows ? rows : 1);
+}
+
+
+/**
+  @brief
+  Sets the fields of opt that DB::SetOptions() can change on an open DB.
+*/
+
+static void ldb_dynamic_options(leveldb::Options &opt)
+{
+  /*
+    The memtable being filled and the one being flushed are the only
+    memtables of a DB, so each gets half of the budget.
+  */
+  opt.write_buffer_size= (size_t) (ldb_memtable_budget / 2);
+  opt.max_mem_usage_for_memtable= (int64_t) ldb_memtable_budget;
+  opt.kL0_CompactionTrigger= (int) ldb_level0_compaction_trigger;
+  opt.kL0_SlowdownWritesTrigger= (int) ldb_level0_slowdown_writes_trigger;
+  opt.kL0_StopWritesTrigger= (int) ldb_level0_stop_writes_trigger;
+  opt.kMaxMemCompactLevel= (int) ldb_max_mem_compact_level;
+  opt.kLimitCompactLevelCount= (int) ldb_limit_compact_levels;
+  opt.kLimitCompactCountInterval= (int) ldb_limit_compact_count_interval;
+  opt.kLimitCompactTimeInterval= (int) ldb_limit_compact_time_interval;
+  opt.kLimitCompactTimeStart= (int) ldb_limit_compact_time_start;
+  opt.kLimitCompactTimeEnd= (int) ldb_limit_compact_time_end;
+  opt.kLimitDeleteObsoleteFileInterval=
+    (int) ldb_delete_obsolete_files_interval;
+  opt.kDoSeekCompaction= ldb_seek_compaction;
+}
+
+
+/**
+  @brief
+  Sets the fields of opt that only take effect when the DB is opened.
+*/
+
+static void ldb_static_options(leveldb::Options &opt)
+{
+  opt.max_open_files= (int) ldb_max_open_files;
+  opt.block_size= (size_t) ldb_block_size;
+  opt.block_restart_interval= (int) ldb_block_restart_interval;
+  /* Rows are stored uncompressed; the table blocks are compressed. */
+  opt.compression= (leveldb::CompressionType) ldb_compression;
+  opt.kTargetFileSize= (int) ldb_target_file_size;
+  opt.kMaxGrandParentOverlapBytes= 10 * (int64_t) ldb_target_file_size;
+  opt.kBaseLevelSize= (int) ldb_base_level_size;
+  opt.kArenaBlockSize= (int) ldb_arena_block_size;
+  opt.kUseMmapRandomAccess= ldb_use_mmap_reads;
+}
+
+
+leveldb::Status leveldb_open(const char *name, bool create_if_missing, leveldb::DB* &db)
+{
+  std::string dbpath;    
+  leveldb::Status status;
+
+  dbpath.assign(name);
+  options.comparator= &ldb_comparator;
+
+  if (!ldb_block_cache)
+    ldb_block_cache= leveldb::NewLRUCache((size_t) ldb_block_cache_size);
+  options.block_cache= ldb_block_cache;
+  if (!ldb_filter_policy && ldb_bloom_bits_per_key)
+    ldb_filter_policy= leveldb::NewBloomFilterPolicy((int) ldb_bloom_bits_per_key);
+  options.filter_policy= ldb_filter_policy;
+  ldb_static_options(options);
+  ldb_dynamic_options(options);
+  options.create_if_missing= create_if_missing;
+  status = leveldb::DB::Open(options, dbpath, &db);
+  wo.sync= ldb_sync_writes;
+
+  return status;
+}
+
+/**
+  @brief
+  create() is called to create a database. The variable name will have the name
+  of the table.
+
+  @details
+  When create() is called you do not need to worry about
+  opening the table. Also, the .frm file will have already been
+  created so adjusting create_info is not necessary. You can overwrite
+  the .frm file at this point if you wish to change the table
+  definition, but there are no methods currently provided for doing
+  so.
+
+  Called from handle.cc by ha_create_table().
+
+  @see
+  ha_create_table() in handle.cc
+*/
+
+int ha_ldb::create(const char *name, TABLE *table_arg,
+                       HA_CREATE_INFO *create_info)
+{
+  DBUG_ENTER("ha_ldb::create");
+
+  /*
+    Rows are stored under their primary key, secondary entries point at it.
+    BLOB/TEXT columns keep their data outside the record, so they cannot be
+    key parts.
+  */
+  if (table_arg->s->primary_key != 0)
+  {
+    DBUG_RETURN(my_errno= HA_ERR_WRONG_INDEX);
+  }
+  for (uint keynr= 0; keynr < table_arg->s->keys; keynr++)
+  {
+    KEY *key_info= table_arg->key_info + keynr;
+    for (uint i= 0; i < key_info->key_parts; i++)
+    {
+      if (key_info->key_part[i].key_part_flag & HA_BLOB_PART)
+        DBUG_RETURN(my_errno= HA_ERR_WRONG_INDEX);
+    }
+  }
+
+  uint32 old_id;
+  bool stale;
+  std::string key;
+  char id[LDB_TABLE_ID_LENGTH];
+  leveldb::WriteBatch batch;
+
+  mysql_mutex_lock(&ldb_mutex);
+
+  /* A name left behind by an interrupted DROP is dropped now. */
+  if ((stale= !ldb_lookup_table(name, &old_id)))
+  {
+    mi_int4store(id, old_id);
+    ldb_dict_key(LDB_DICT_DROPPED, id, LDB_TABLE_ID_LENGTH, key);
+    batch.Put(key, leveldb::Slice());
+  }
+
+  mi_int4store(id, ldb_next_table_id);
+  key.clear();
+  ldb_dict_key(LDB_DICT_TABLE, name, strlen(name), key);
+  batch.Put(key, leveldb::Slice(id, LDB_TABLE_ID_LENGTH));
+
+  mi_int4store(id, ldb_next_table_id + 1);
+  key.clear();
+  ldb_dict_key(LDB_DICT_NEXT_ID, "", 0, key);
+  batch.Put(key, leveldb::Slice(id, LDB_TABLE_ID_LENGTH));
+
+  leveldb::Status s= ldb_db->Write(wo, &batch);
+  if (s.ok())
+  {
+    ldb_next_table_id++;
+    if (stale)
+      ldb_mark_dropped(old_id);
+  }
+  mysql_mutex_unlock(&ldb_mutex);
+
+  DBUG_RETURN(s.ok() ? 0 : HA_ERR_INTERNAL_ERROR);
+}
+
+struct st_mysql_storage_engine ldb_storage_engine=
+{ MYSQL_HANDLERTON_INTERFACE_VERSION };
+
+/*
+  Update functions of the dynamic variables: the new value is stored and
+  applied to the open DB at once.
+*/
+
+static void ldb_set_options()
+{
+  ldb_dynamic_options(options);
+  if (ldb_db)
+    ldb_db->SetOptions(options);
+}
+
+static void ldb_update_block_cache_size(MYSQL_THD thd,
+                                        struct st_mysql_sys_var *var,
+                                        void *var_ptr, const void *save)
+{
+  ldb_block_cache_size= *(const ulonglong*) save;
+  if (ldb_block_cache)
+    ldb_block_cache->SetCapacity((size_t) ldb_block_cache_size);
+}
+
+static void ldb_update_row_cache_size(MYSQL_THD thd,
+                                      struct st_mysql_sys_var *var,
+                                      void *var_ptr, const void *save)
+{
+  ldb_row_cache_size= *(const ulonglong*) save;
+  if (ldb_row_cache)
+    ldb_row_cache->SetCapacity((size_t) ldb_row_cache_size);
+}
+
+static void ldb_update_memtable_budget(MYSQL_THD thd,
+                                       struct st_mysql_sys_var *var,
+                                       void *var_ptr, const void *save)
+{
+  ldb_memtable_budget= *(const ulonglong*) save;
+  ldb_set_options();
+}
+
+static void ldb_update_ulong_option(MYSQL_THD thd,
+                                    struct st_mysql_sys_var *var,
+                                    void *var_ptr, const void *save)
+{
+  *(ulong*) var_ptr= *(const ulong*) save;
+  ldb_set_options();
+}
+
+static void ldb_update_bool_option(MYSQL_THD thd,
+                                   struct st_mysql_sys_var *var,
+                                   void *var_ptr, const void *save)
+{
+  *(my_bool*) var_ptr= *(const my_bool*) save;
+  ldb_set_options();
+}
+
+static void ldb_update_sync_writes(MYSQL_THD thd,
+                                   struct st_mysql_sys_var *var,
+                                   void *var_ptr, const void *save)
+{
+  ldb_sync_writes= *(const my_bool*) save;
+  wo.sync= ldb_sync_writes;
+}
+
+static MYSQL_SYSVAR_STR(
+  data_home_dir,
+  ldb_data_home_dir,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Directory of the leveldb instance holding all LEVELDB tables.",
+  NULL,
+  NULL,
+  "./.leveldb");
+
+static MYSQL_SYSVAR_ULONGLONG(
+  block_cache_size,
+  ldb_block_cache_size,
+  PLUGIN_VAR_RQCMDARG,
+  "Size of the block cache shared by all LEVELDB tables.",
+  NULL,
+  ldb_update_block_cache_size,
+  128 << 20,
+  8 << 20,
+  ULONGLONG_MAX,
+  1 << 20);
+
+static MYSQL_SYSVAR_ULONGLONG(
+  row_cache_size,
+  ldb_row_cache_size,
+  PLUGIN_VAR_RQCMDARG,
+  "Size of the cache of rows read by primary key. 0 at startup disables "
+  "the cache until the next restart.",
+  NULL,
+  ldb_update_row_cache_size,
+  0,
+  0,
+  ULONGLONG_MAX,
+  1 << 20);
+
+static MYSQL_SYSVAR_ULONGLONG(
+  memtable_budget,
+  ldb_memtable_budget,
+  PLUGIN_VAR_RQCMDARG,
+  "Memory used by the memtables of all LEVELDB tables together.",
+  NULL,
+  ldb_update_memtable_budget,
+  64 << 20,
+  128 << 10,
+  2ULL << 30,
+  1 << 10);
+
+static MYSQL_SYSVAR_ULONGLONG(
+  trx_spill_size,
+  ldb_trx_spill_size,
+  PLUGIN_VAR_RQCMDARG,
+  "Size of the write batch at which an autocommit UPDATE or DELETE of one "
+  "table moves its changes into sorted temporary table files, added to the "
+  "database when it commits; 0 keeps all changes in memory.",
+  NULL,
+  NULL,
+  64 << 20,
+  0,
+  ULONGLONG_MAX,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  max_open_files,
+  ldb_max_open_files,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Number of files kept open by LEVELDB; ten of them are not table files.",
+  NULL,
+  NULL,
+  1000,
+  20,
+  200000,
+  0);
+
+static MYSQL_SYSVAR_ULONGLONG(
+  bulk_load_buffer_size,
+  ldb_bulk_load_buffer_size,
+  PLUGIN_VAR_RQCMDARG,
+  "Memory used to sort the rows of a bulk insert into table files; "
+  "0 sends bulk inserts through the transaction like other writes.",
+  NULL,
+  NULL,
+  64 << 20,
+  0,
+  ULONGLONG_MAX,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  block_size,
+  ldb_block_size,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Size of the uncompressed data of a table block.",
+  NULL,
+  NULL,
+  4096,
+  1024,
+  4 << 20,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  block_restart_interval,
+  ldb_block_restart_interval,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Keys between the restart points of a table block.",
+  NULL,
+  NULL,
+  16,
+  1,
+  1024,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  bloom_bits_per_key,
+  ldb_bloom_bits_per_key,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Bits per key of the bloom filters of new table files, which let "
+  "duplicate key checks skip the files that cannot hold the key. "
+  "0 disables the filters.",
+  NULL,
+  NULL,
+  10,
+  0,
+  64,
+  0);
+
+const char *ldb_compression_names[]=
+{
+  "NONE", "SNAPPY", NullS
+};
+
+TYPELIB ldb_compression_typelib=
+{
+  array_elements(ldb_compression_names) - 1, "ldb_compression_typelib",
+  ldb_compression_names, NULL
+};
+
+static MYSQL_SYSVAR_ENUM(
+  compression,
+  ldb_compression,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Compression of the table blocks written from now on: NONE or SNAPPY.",
+  NULL,
+  NULL,
+  leveldb::kSnappyCompression,
+  &ldb_compression_typelib);
+
+static MYSQL_SYSVAR_ULONG(
+  target_file_size,
+  ldb_target_file_size,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Size of the table files written by compactions.",
+  NULL,
+  NULL,
+  2 << 20,
+  64 << 10,
+  1 << 30,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  base_level_size,
+  ldb_base_level_size,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Size of level 1 that triggers its compaction; each deeper level"
+  " may be ten times as large as the one above it.",
+  NULL,
+  NULL,
+  10 << 20,
+  1 << 20,
+  INT_MAX32,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  arena_block_size,
+  ldb_arena_block_size,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_RQCMDARG,
+  "Size of the blocks allocated by the memtables.",
+  NULL,
+  NULL,
+  4096,
+  1024,
+  1 << 20,
+  0);
+
+static MYSQL_SYSVAR_BOOL(
+  use_mmap_reads,
+  ldb_use_mmap_reads,
+  PLUGIN_VAR_READONLY | PLUGIN_VAR_OPCMDARG,
+  "Read table files through mmap() instead of pread().",
+  NULL,
+  NULL,
+  FALSE);
+
+static MYSQL_SYSVAR_ULONG(
+  level0_compaction_trigger,
+  ldb_level0_compaction_trigger,
+  PLUGIN_VAR_RQCMDARG,
+  "Number of level-0 files that triggers their compaction.",
+  NULL,
+  ldb_update_ulong_option,
+  4,
+  1,
+  1000,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  level0_slowdown_writes_trigger,
+  ldb_level0_slowdown_writes_trigger,
+  PLUGIN_VAR_RQCMDARG,
+  "Number of level-0 files at which each write is delayed by 1ms.",
+  NULL,
+  ldb_update_ulong_option,
+  8,
+  1,
+  1000,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  level0_stop_writes_trigger,
+  ldb_level0_stop_writes_trigger,
+  PLUGIN_VAR_RQCMDARG,
+  "Number of level-0 files at which writes wait for a compaction.",
+  NULL,
+  ldb_update_ulong_option,
+  12,
+  1,
+  1000,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  max_mem_compact_level,
+  ldb_max_mem_compact_level,
+  PLUGIN_VAR_RQCMDARG,
+  "Deepest level a flushed memtable is written to when it overlaps"
+  " no file there.",
+  NULL,
+  ldb_update_ulong_option,
+  2,
+  0,
+  LDB_NUM_LEVELS - 1,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  limit_compact_levels,
+  ldb_limit_compact_levels,
+  PLUGIN_VAR_RQCMDARG,
+  "Number of deepest levels whose compactions are limited during"
+  " the window set by limit_compact_time_start and limit_compact_time_end;"
+  " 0 limits none.",
+  NULL,
+  ldb_update_ulong_option,
+  0,
+  0,
+  LDB_NUM_LEVELS,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  limit_compact_count_interval,
+  ldb_limit_compact_count_interval,
+  PLUGIN_VAR_RQCMDARG,
+  "Limited compactions skipped before one is done anyway;"
+  " 0 skips them all.",
+  NULL,
+  ldb_update_ulong_option,
+  0,
+  0,
+  INT_MAX32,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  limit_compact_time_interval,
+  ldb_limit_compact_time_interval,
+  PLUGIN_VAR_RQCMDARG,
+  "Seconds after which a limited compaction is done anyway;"
+  " 0 never does it.",
+  NULL,
+  ldb_update_ulong_option,
+  0,
+  0,
+  INT_MAX32,
+  0);
+
+static MYSQL_SYSVAR_ULONG(
+  limit_compact_time_start,
+  ldb_limit_compact_time_start,
+  PLUGIN_VAR_RQCMDARG,
+  "Hour at which the compaction limit window starts; equal to"
+  " limit_compact_time_end to limit compactions all day.",
+  NULL,
+  ldb_update_ulong_option,
+  0,
+  0,
+  23,
+  0);
 
-  Berkeley DB, for ldb, changes all WRITE locks to TL_WRITE_ALLOW_WRITE
-  (which signals that we are doing WRITES, but are still allowing other
-  readers and writers).
+static MYSQL_SYSVAR_ULONG(
+  limit_compact_time_end,
+  ldb_limit_compact_time_end,
+  PLUGIN_VAR_RQCMDARG,
+  "Hour at which the compaction limit window ends; less than"
+  " limit_compact_time_start for a window across midnight.",
+  NULL,
+  ldb_update_ulong_option,
+  0,
+  0,
+  23,
+  0);
 
-  When releasing locks, store_lock() is also called. In this case one
-  usually doesn't have to do anything.
+static MYSQL_SYSVAR_ULONG(
+  delete_obsolete_files_interval,
+  ldb_delete_obsolete_files_interval,
+  PLUGIN_VAR_RQCMDARG,
+  "Compactions between two scans for obsolete files to delete.",
+  NULL,
+  ldb_update_ulong_option,
+  0,
+  0,
+  INT_MAX32,
+  0);
 
-  In some exceptional cases MySQL may send a request for a TL_IGNORE;
-  This means that we are requesting the same lock as last time and this
-  should also be ignored. (This may happen when someone does a flush
-  table when we have opened a part of the tables, in which case mysqld
-  closes and reopens the tables and tries to get the same locks at last
-  time). In the future we will probably try to remove this.
+static MYSQL_SYSVAR_BOOL(
+  seek_compaction,
+  ldb_seek_compaction,
+  PLUGIN_VAR_OPCMDARG,
+  "Compact a file that is read too often without finding the key.",
+  NULL,
+  ldb_update_bool_option,
+  TRUE);
+
+static MYSQL_SYSVAR_BOOL(
+  sync_writes,
+  ldb_sync_writes,
+  PLUGIN_VAR_OPCMDARG,
+  "Sync the log when a transaction commits; if off, a crash of the"
+  " machine may lose the last commits.",
+  NULL,
+  ldb_update_sync_writes,
+  TRUE);
 
-  Called from lock.cc by get_lock_data().
+static struct st_mysql_sys_var* ldb_system_variables[]= {
+  MYSQL_SYSVAR(data_home_dir),
+  MYSQL_SYSVAR(block_cache_size),
+  MYSQL_SYSVAR(row_cache_size),
+  MYSQL_SYSVAR(memtable_budget),
+  MYSQL_SYSVAR(max_open_files),
+  MYSQL_SYSVAR(bulk_load_buffer_size),
+  MYSQL_SYSVAR(trx_spill_size),
+  MYSQL_SYSVAR(block_size),
+  MYSQL_SYSVAR(block_restart_interval),
+  MYSQL_SYSVAR(bloom_bits_per_key),
+  MYSQL_SYSVAR(compression),
+  MYSQL_SYSVAR(target_file_size),
+  MYSQL_SYSVAR(base_level_size),
+  MYSQL_SYSVAR(arena_block_size),
+  MYSQL_SYSVAR(use_mmap_reads),
+  MYSQL_SYSVAR(level0_compaction_trigger),
+  MYSQL_SYSVAR(level0_slowdown_writes_trigger),
+  MYSQL_SYSVAR(level0_stop_writes_trigger),
+  MYSQL_SYSVAR(max_mem_compact_level),
+  MYSQL_SYSVAR(limit_compact_levels),
+  MYSQL_SYSVAR(limit_compact_count_interval),
+  MYSQL_SYSVAR(limit_compact_time_interval),
+  MYSQL_SYSVAR(limit_compact_time_start),
+  MYSQL_SYSVAR(limit_compact_time_end),
+  MYSQL_SYSVAR(delete_obsolete_files_interval),
+  MYSQL_SYSVAR(seek_compaction),
+  MYSQL_SYSVAR(sync_writes),
+  MYSQL_SYSVAR(lock_wait_timeout),
+  NULL
+};
 
-  @note
-  In this method one should NEVER rely on table->in_use, it may, in fact,
-  refer to a different thread! (this happens if get_lock_data() is called
-  from mysql_lock_abort_for_thread() function)
+/* Engine counters, refreshed when the status variables are read. */
+static struct st_ldb_status {
+  ulonglong group_commits;
+  ulonglong group_commit_batches;
+  ulonglong log_bytes_written;
+  ulonglong flush_bytes_written;
+  ulonglong compaction_bytes_read;
+  ulonglong compaction_bytes_written;
+  ulonglong bulk_load_bytes_written;
+  ulonglong log_syncs;
+  ulonglong table_syncs;
+  ulonglong manifest_syncs;
+  ulonglong write_stall_micros;
+  ulonglong write_slowdowns;
+  ulonglong write_stops;
+  ulonglong memtables;
+  ulonglong immutable_memtables;
+  ulonglong memtable_bytes;
+  ulonglong level0_files;
+  ulonglong table_files;
+  ulonglong table_bytes;
+  ulonglong block_cache_hits;
+  ulonglong block_cache_misses;
+  ulonglong block_cache_bytes;
+} ldb_status;
+
+#define LDB_STATUS_VAR(name) \
+  {#name, (char*) &ldb_status.name, SHOW_LONGLONG}
+
+static SHOW_VAR ldb_status_variables[]=
+{
+  LDB_STATUS_VAR(group_commits),
+  LDB_STATUS_VAR(group_commit_batches),
+  LDB_STATUS_VAR(log_bytes_written),
+  LDB_STATUS_VAR(flush_bytes_written),
+  LDB_STATUS_VAR(compaction_bytes_read),
+  LDB_STATUS_VAR(compaction_bytes_written),
+  LDB_STATUS_VAR(bulk_load_bytes_written),
+  LDB_STATUS_VAR(log_syncs),
+  LDB_STATUS_VAR(table_syncs),
+  LDB_STATUS_VAR(manifest_syncs),
+  LDB_STATUS_VAR(write_stall_micros),
+  LDB_STATUS_VAR(write_slowdowns),
+  LDB_STATUS_VAR(write_stops),
+  LDB_STATUS_VAR(memtables),
+  LDB_STATUS_VAR(immutable_memtables),
+  LDB_STATUS_VAR(memtable_bytes),
+  LDB_STATUS_VAR(level0_files),
+  LDB_STATUS_VAR(table_files),
+  LDB_STATUS_VAR(table_bytes),
+  LDB_STATUS_VAR(block_cache_hits),
+  LDB_STATUS_VAR(block_cache_misses),
+  LDB_STATUS_VAR(block_cache_bytes),
+  {NullS, NullS, SHOW_LONG}
+};
 
-  @see
-  get_lock_data() in lock.cc
+/*
+  The counters come from one DB::GetStats() call, which takes the leveldb
+  mutex once and formats nothing, so they are cheap to poll. Group commit
+  is measured by the leveldb write queue: group_commits log writes carried
+  group_commit_batches transaction batches.
 */
-THR_LOCK_DATA **ha_ldb::store_lock(THD *thd,
-                                       THR_LOCK_DATA **to,
-                                       enum thr_lock_type lock_type)
+static int show_ldb_vars(MYSQL_THD thd, struct st_mysql_show_var *var,
+                         char *buf)
 {
-  DBUG_ENTER("store_lock");
+  leveldb::DBStats stats;
 
-  const bool in_lock_tables = thd_in_lock_tables(thd);
-  const uint sql_command = thd_sql_command(thd);
-  if ((lock_type >= TL_WRITE_CONCURRENT_INSERT
-       && lock_type <= TL_WRITE)
-       && !(in_lock_tables
-       && sql_command == SQLCOM_LOCK_TABLES)
-       && !thd_tablespace_op(thd)
-       && sql_command != SQLCOM_TRUNCATE
-       && sql_command != SQLCOM_OPTIMIZE
-       && sql_command != SQLCOM_CREATE_TABLE)
+  if (ldb_db)
   {
-    lock_type = TL_WRITE_ALLOW_WRITE;
+    ldb_db->GetStats(&stats);
+    ldb_status.group_commits= stats.write_groups;
+    ldb_status.group_commit_batches= stats.write_group_batches;
+    ldb_status.log_bytes_written= stats.log_bytes;
+    ldb_status.flush_bytes_written= stats.flush_bytes;
+    ldb_status.compaction_bytes_read= stats.compaction_bytes_read;
+    ldb_status.compaction_bytes_written= stats.compaction_bytes_written;
+    ldb_status.bulk_load_bytes_written= stats.bulk_load_bytes;
+    ldb_status.log_syncs= stats.log_syncs;
+    ldb_status.table_syncs= stats.table_syncs;
+    ldb_status.manifest_syncs= stats.manifest_syncs;
+    ldb_status.write_stall_micros= stats.stall_micros;
+    ldb_status.write_slowdowns= stats.write_slowdowns;
+    ldb_status.write_stops= stats.write_stops;
+    ldb_status.memtables= stats.memtables;
+    ldb_status.immutable_memtables= stats.immutable_memtables;
+    ldb_status.memtable_bytes= stats.memtable_bytes;
+    ldb_status.level0_files= stats.level0_files;
+    ldb_status.table_files= stats.table_files;
+    ldb_status.table_bytes= stats.table_bytes;
+  }
+  if (ldb_block_cache)
+  {
+    ldb_status.block_cache_hits= ldb_block_cache->Hits();
+    ldb_status.block_cache_misses= ldb_block_cache->Misses();
+    ldb_status.block_cache_bytes= ldb_block_cache->TotalCharge();
   }
 
-  if ( lock_type!=TL_IGNORE && lock.type==TL_UNLOCK )
-    lock.type=lock_type;
-
-  *to++ = &lock;
-  DBUG_RETURN(to);
+  var->type= SHOW_ARRAY;
+  var->value= (char*) &ldb_status_variables;
+  return 0;
 }
-/*
+
+static struct st_mysql_show_var func_status[]=
 {
-  if (lock_type != TL_IGNORE && lock.type == TL_UNLOCK)
-    lock.type=lock_type;
-  *to++= &lock;
-  return to;
-}
-*/
+  {"Ldb",  (char *)show_ldb_vars, SHOW_FUNC},
+  {0,0,SHOW_UNDEF}
+};
 
-/**
-  @brief
-  Used to delete a table. By the time delete_table() has been called all
-  opened references to this table will have been closed (and your globally
-  shared references released). The variable name will just be the name of
-  the table. You will need to remove any files you have created at this point.
+/*
+  INFORMATION_SCHEMA tables: LEVELDB_SST_FILES lists the table files of the
+  current version, LEVELDB_COMPACTION_HISTORY the last flushes, compactions
+  and bulk loads, LEVELDB_LEVEL_STATS the compaction totals of each level.
+*/
 
-  @details
-  If you do not implement this, the default delete_table() is called from
-  handler.cc and it will delete all files with the file extensions returned
-  by bas_ext().
+static struct st_mysql_information_schema ldb_i_s_info=
+{ MYSQL_INFORMATION_SCHEMA_INTERFACE_VERSION };
 
-  Called from handler.cc by delete_table and ha_create_table(). Only used
-  during create if the table_flag HA_DROP_BEFORE_CREATE was specified for
-  the storage engine.
+#define LDB_I_S_KEY_LENGTH (2 * (LDB_TABLE_ID_LENGTH + MAX_KEY_LENGTH))
 
-  @see
-  delete_table and ha_create_table() in handler.cc
+/**
+  @brief
+  Maps the id of every table of the dictionary to its schema and name,
+  separated by a '.'.
 */
-int ha_ldb::delete_table(const char *name)
+
+static void ldb_table_names(std::map<uint32, std::string> &names)
 {
-  DBUG_ENTER("ha_ldb::delete_table");
-  /* This is not implemented but we want someone to be able that it works. */
-  dbpath.assign(name);
-  leveldb::DestroyDB(dbpath, leveldb::Options());
-  DBUG_RETURN(0);
+  std::string key;
+  char db[NAME_LEN + 1];
+  char name[NAME_LEN + 1];
+
+  ldb_dict_key(LDB_DICT_TABLE, "", 0, key);
+  leveldb::Iterator *dict= ldb_db->NewIterator(leveldb::ReadOptions());
+  for (dict->Seek(key); dict->Valid() && dict->key().starts_with(key);
+       dict->Next())
+  {
+    if (dict->value().size() != LDB_TABLE_ID_LENGTH)
+      continue;
+    /* The table path is ./schema/name, in file name encoding. */
+    std::string path(dict->key().data() + key.length(),
+                     dict->key().size() - key.length());
+    size_t name_pos= path.rfind('/');
+    if (name_pos == std::string::npos || name_pos == 0)
+      continue;
+    size_t db_pos= path.rfind('/', name_pos - 1);
+    db_pos= db_pos == std::string::npos ? 0 : db_pos + 1;
+    filename_to_tablename(path.substr(db_pos, name_pos - db_pos).c_str(),
+                          db, sizeof(db));
+    filename_to_tablename(path.c_str() + name_pos + 1, name, sizeof(name));
+    names[mi_uint4korr((const uchar*) dict->value().data())]=
+      std::string(db) + '.' + name;
+  }
+  delete dict;
 }
 
 
-/**
-  @brief
-  Renames a table from one name to another via an alter table call.
+static void ldb_store_hex(Field *field, const std::string &data)
+{
+  static const char digits[]= "0123456789ABCDEF";
+  std::string hex;
 
-  @details
-  If you do not implement this, the default rename_table() is called from
-  handler.cc and it will delete all files with the file extensions returned
-  by bas_ext().
+  hex.reserve(data.size() * 2);
+  for (size_t i= 0; i < data.size(); i++)
+  {
+    hex.push_back(digits[(uchar) data[i] >> 4]);
+    hex.push_back(digits[(uchar) data[i] & 15]);
+  }
+  field->store(hex.data(), hex.size(), system_charset_info);
+}
 
-  Called from sql_table.cc by mysql_rename_table().
 
-  @see
-  mysql_rename_table() in sql_table.cc
-*/
-int ha_ldb::rename_table(const char * from, const char * to)
+static void ldb_store_time(THD *thd, Field *field, ulonglong micros)
 {
-  DBUG_ENTER("ha_ldb::rename_table ");
-  DBUG_RETURN(HA_ERR_WRONG_COMMAND);
+  MYSQL_TIME time;
+
+  thd->variables.time_zone->gmt_sec_to_TIME(&time,
+                                            (my_time_t) (micros / 1000000));
+  field->store_time(&time, MYSQL_TIMESTAMP_DATETIME);
 }
 
 
+static ST_FIELD_INFO ldb_sst_files_fields[]=
+{
+  {"FILE_NUMBER", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"LEVEL", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"FILE_SIZE", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"NUM_ENTRIES", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED | MY_I_S_MAYBE_NULL, "", SKIP_OPEN_TABLE},
+  {"SMALLEST_KEY", LDB_I_S_KEY_LENGTH, MYSQL_TYPE_STRING, 0, 0, "",
+   SKIP_OPEN_TABLE},
+  {"LARGEST_KEY", LDB_I_S_KEY_LENGTH, MYSQL_TYPE_STRING, 0, 0, "",
+   SKIP_OPEN_TABLE},
+  {"TABLE_ID", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED | MY_I_S_MAYBE_NULL, "", SKIP_OPEN_TABLE},
+  {"TABLE_NAME", 2 * NAME_LEN + 1, MYSQL_TYPE_STRING, 0,
+   MY_I_S_MAYBE_NULL, "", SKIP_OPEN_TABLE},
+  {0, 0, MYSQL_TYPE_NULL, 0, 0, 0, SKIP_OPEN_TABLE}
+};
+
 /**
   @brief
-  Given a starting key and an ending key, estimate the number of rows that
-  will exist between the two keys.
+  Fills LEVELDB_SST_FILES. The keys are in hex; TABLE_ID and TABLE_NAME
+  are NULL for a file that holds the keys of more than one table, and
+  NUM_ENTRIES for a file written before entry counts were recorded.
+*/
 
-  @details
-  end_key may be empty, in which case determine if start_key matches any rows.
+static int ldb_sst_files_fill(THD *thd, TABLE_LIST *tables, COND *cond)
+{
+  TABLE *table= tables->table;
+  std::vector<leveldb::FileInfo> files;
+  std::map<uint32, std::string> names;
+  DBUG_ENTER("ldb_sst_files_fill");
 
-  Called from opt_range.cc by check_quick_keys().
+  if (!ldb_db)
+    DBUG_RETURN(0);
+  ldb_db->GetFiles(&files);
+  ldb_table_names(names);
 
-  @see
-  check_quick_keys() in opt_range.cc
-*/
-ha_rows ha_ldb::records_in_range(uint inx, key_range *min_key,
-                                     key_range *max_key)
+  for (size_t i= 0; i < files.size(); i++)
+  {
+    const leveldb::FileInfo &f= files[i];
+    table->field[0]->store((longlong) f.number, TRUE);
+    table->field[1]->store((longlong) f.level, TRUE);
+    table->field[2]->store((longlong) f.size, TRUE);
+    if (f.num_entries)
+    {
+      table->field[3]->set_notnull();
+      table->field[3]->store((longlong) f.num_entries, TRUE);
+    }
+    else
+      table->field[3]->set_null();
+    ldb_store_hex(table->field[4], f.smallest);
+    ldb_store_hex(table->field[5], f.largest);
+
+    table->field[6]->set_null();
+    table->field[7]->set_null();
+    if (f.smallest.size() >= LDB_TABLE_ID_LENGTH &&
+        f.largest.size() >= LDB_TABLE_ID_LENGTH &&
+        !memcmp(f.smallest.data(), f.largest.data(), LDB_TABLE_ID_LENGTH))
+    {
+      uint32 table_id= mi_uint4korr((const uchar*) f.smallest.data());
+      table->field[6]->set_notnull();
+      table->field[6]->store((longlong) table_id, TRUE);
+      std::map<uint32, std::string>::const_iterator name=
+        names.find(table_id);
+      if (name != names.end())
+      {
+        table->field[7]->set_notnull();
+        table->field[7]->store(name->second.data(), name->second.size(),
+                               system_charset_info);
+      }
+    }
+
+    if (schema_table_store_record(thd, table))
+      DBUG_RETURN(1);
+  }
+  DBUG_RETURN(0);
+}
+
+static int ldb_sst_files_init(void *p)
 {
-  DBUG_ENTER("ha_ldb::records_in_range");
-  DBUG_RETURN(10);                         // low number to force index usage
+  ST_SCHEMA_TABLE *schema= (ST_SCHEMA_TABLE*) p;
+  schema->fields_info= ldb_sst_files_fields;
+  schema->fill_table= ldb_sst_files_fill;
+  return 0;
 }
 
 
-leveldb::Status leveldb_open(const char *name, bool create_if_missing, leveldb::DB* &db)
+static ST_FIELD_INFO ldb_compaction_history_fields[]=
 {
-  std::string dbpath;    
-  leveldb::Status status;
+  {"TYPE", 32, MYSQL_TYPE_STRING, 0, 0, "", SKIP_OPEN_TABLE},
+  {"SUCCEEDED", 1, MYSQL_TYPE_LONG, 0, 0, "", SKIP_OPEN_TABLE},
+  {"START_TIME", 0, MYSQL_TYPE_DATETIME, 0, 0, "", SKIP_OPEN_TABLE},
+  {"END_TIME", 0, MYSQL_TYPE_DATETIME, 0, 0, "", SKIP_OPEN_TABLE},
+  {"MICROS", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"INPUT_LEVEL", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED | MY_I_S_MAYBE_NULL, "", SKIP_OPEN_TABLE},
+  {"OUTPUT_LEVEL", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED | MY_I_S_MAYBE_NULL, "", SKIP_OPEN_TABLE},
+  {"INPUT_FILES", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"OUTPUT_FILES", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"BYTES_READ", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"BYTES_WRITTEN", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"INPUT_ENTRIES", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"DROPPED_ENTRIES", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {0, 0, MYSQL_TYPE_NULL, 0, 0, 0, SKIP_OPEN_TABLE}
+};
 
-  dbpath.assign(name);
-  options.write_buffer_size= 33554432;
-  options.create_if_missing= create_if_missing;
-  status = leveldb::DB::Open(options, dbpath, &db);
-  wo.sync= true;
+static const char *ldb_compaction_types[]=
+{
+  "FLUSH", "COMPACTION", "SELF_LEVEL_COMPACTION", "TRIVIAL_MOVE", "BULK_LOAD",
+  "DELETE_FILES"
+};
 
-  return status;
+static void ldb_store_level(Field *field, int level)
+{
+  if (level < 0)
+    field->set_null();
+  else
+  {
+    field->set_notnull();
+    field->store((longlong) level, TRUE);
+  }
 }
 
 /**
   @brief
-  create() is called to create a database. The variable name will have the name
-  of the table.
-
-  @details
-  When create() is called you do not need to worry about
-  opening the table. Also, the .frm file will have already been
-  created so adjusting create_info is not necessary. You can overwrite
-  the .frm file at this point if you wish to change the table
-  definition, but there are no methods currently provided for doing
-  so.
-
-  Called from handle.cc by ha_create_table().
-
-  @see
-  ha_create_table() in handle.cc
+  Fills LEVELDB_COMPACTION_HISTORY, oldest job first. INPUT_LEVEL is NULL
+  for flushes and bulk loads, OUTPUT_LEVEL for a bulk load that was
+  written through the memtable.
 */
 
-int ha_ldb::create(const char *name, TABLE *table_arg,
-                       HA_CREATE_INFO *create_info)
+static int ldb_compaction_history_fill(THD *thd, TABLE_LIST *tables,
+                                       COND *cond)
 {
-  DBUG_ENTER("ha_ldb::create");
-  /*
-    This is not implemented but we want someone to be able to see that it
-    works.
-  */
+  TABLE *table= tables->table;
+  std::vector<leveldb::CompactionInfo> history;
+  DBUG_ENTER("ldb_compaction_history_fill");
+
+  if (!ldb_db)
+    DBUG_RETURN(0);
+  ldb_db->GetCompactionHistory(&history);
 
-  if (table_arg->s->key_parts != 1 || table_arg->s->max_unique_length != 1)
+  for (size_t i= 0; i < history.size(); i++)
   {
-    DBUG_RETURN(my_errno= HA_ERR_WRONG_INDEX);
+    const leveldb::CompactionInfo &c= history[i];
+    const char *type= ldb_compaction_types[c.type];
+    table->field[0]->store(type, strlen(type), system_charset_info);
+    table->field[1]->store((longlong) c.ok, TRUE);
+    ldb_store_time(thd, table->field[2], c.start_micros);
+    ldb_store_time(thd, table->field[3], c.end_micros);
+    table->field[4]->store((longlong) (c.end_micros - c.start_micros), TRUE);
+    ldb_store_level(table->field[5], c.input_level);
+    ldb_store_level(table->field[6], c.output_level);
+    table->field[7]->store((longlong) c.input_files, TRUE);
+    table->field[8]->store((longlong) c.output_files, TRUE);
+    table->field[9]->store((longlong) c.bytes_read, TRUE);
+    table->field[10]->store((longlong) c.bytes_written, TRUE);
+    table->field[11]->store((longlong) c.input_entries, TRUE);
+    table->field[12]->store((longlong) c.dropped_entries, TRUE);
+    if (schema_table_store_record(thd, table))
+      DBUG_RETURN(1);
   }
-
-  leveldb::DB* db= NULL;
-  leveldb::Status s;
-
-  dbpath.assign(name);
-  s= leveldb_open(name, true, db);
-  DBUG_RETURN(!s.ok());
+  DBUG_RETURN(0);
 }
 
-struct st_mysql_storage_engine ldb_storage_engine=
-{ MYSQL_HANDLERTON_INTERFACE_VERSION };
+static int ldb_compaction_history_init(void *p)
+{
+  ST_SCHEMA_TABLE *schema= (ST_SCHEMA_TABLE*) p;
+  schema->fields_info= ldb_compaction_history_fields;
+  schema->fill_table= ldb_compaction_history_fill;
+  return 0;
+}
 
-static ulong srv_enum_var= 0;
-static ulong srv_ulong_var= 0;
 
-const char *enum_var_names[]=
+static ST_FIELD_INFO ldb_level_stats_fields[]=
 {
-  "e1", "e2", NullS
+  {"LEVEL", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"FILES", MY_INT32_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"SIZE", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"COMPACTION_MICROS", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"BYTES_READ", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {"BYTES_WRITTEN", MY_INT64_NUM_DECIMAL_LENGTH, MYSQL_TYPE_LONGLONG, 0,
+   MY_I_S_UNSIGNED, "", SKIP_OPEN_TABLE},
+  {0, 0, MYSQL_TYPE_NULL, 0, 0, 0, SKIP_OPEN_TABLE}
 };
 
-TYPELIB enum_var_typelib=
-{
-  array_elements(enum_var_names) - 1, "enum_var_typelib",
-  enum_var_names, NULL
-};
+/**
+  @brief
+  Fills LEVELDB_LEVEL_STATS: the files of each level and the time and
+  bytes of the jobs that wrote to it since the server started, as in
+  the leveldb.stats property.
+*/
 
-static MYSQL_SYSVAR_ENUM(
-  enum_var,                       // name
-  srv_enum_var,                   // varname
-  PLUGIN_VAR_RQCMDARG,            // opt
-  "Sample ENUM system variable.", // comment
-  NULL,                           // check
-  NULL,                           // update
-  0,                              // def
-  &enum_var_typelib);             // typelib
+static int ldb_level_stats_fill(THD *thd, TABLE_LIST *tables, COND *cond)
+{
+  TABLE *table= tables->table;
+  std::vector<leveldb::LevelInfo> levels;
+  DBUG_ENTER("ldb_level_stats_fill");
 
-static MYSQL_SYSVAR_ULONG(
-  ulong_var,
-  srv_ulong_var,
-  PLUGIN_VAR_RQCMDARG,
-  "0..1000",
-  NULL,
-  NULL,
-  8,
-  0,
-  1000,
-  0);
+  if (!ldb_db)
+    DBUG_RETURN(0);
+  ldb_db->GetLevelStats(&levels);
 
-static struct st_mysql_sys_var* ldb_system_variables[]= {
-  MYSQL_SYSVAR(enum_var),
-  MYSQL_SYSVAR(ulong_var),
-  NULL
-};
+  for (size_t i= 0; i < levels.size(); i++)
+  {
+    table->field[0]->store((longlong) i, TRUE);
+    table->field[1]->store((longlong) levels[i].files, TRUE);
+    table->field[2]->store((longlong) levels[i].bytes, TRUE);
+    table->field[3]->store((longlong) levels[i].micros, TRUE);
+    table->field[4]->store((longlong) levels[i].bytes_read, TRUE);
+    table->field[5]->store((longlong) levels[i].bytes_written, TRUE);
+    if (schema_table_store_record(thd, table))
+      DBUG_RETURN(1);
+  }
+  DBUG_RETURN(0);
+}
 
-// this is an ldb of SHOW_FUNC and of my_snprintf() service
-static int show_func_ldb(MYSQL_THD thd, struct st_mysql_show_var *var,
-                             char *buf)
+static int ldb_level_stats_init(void *p)
 {
+  ST_SCHEMA_TABLE *schema= (ST_SCHEMA_TABLE*) p;
+  schema->fields_info= ldb_level_stats_fields;
+  schema->fill_table= ldb_level_stats_fill;
   return 0;
 }
 
-static struct st_mysql_show_var func_status[]=
+static int ldb_i_s_deinit(void *p)
 {
-  {"ldb_func_ldb",  (char *)show_func_ldb, SHOW_FUNC},
-  {0,0,SHOW_UNDEF}
-};
+  return 0;
+}
 
 mysql_declare_plugin(ldb)
 {
@@ -1166,5 +5677,50 @@ mysql_declare_plugin(ldb)
   ldb_system_variables,                     /* system variables */
   NULL,                                         /* config options */
   0,                                            /* flags */
+},
+{
+  MYSQL_INFORMATION_SCHEMA_PLUGIN,
+  &ldb_i_s_info,
+  "LEVELDB_SST_FILES",
+  "dingqi, taobao.com",
+  "LevelDB table files",
+  PLUGIN_LICENSE_GPL,
+  ldb_sst_files_init,                       /* Plugin Init */
+  ldb_i_s_deinit,                           /* Plugin Deinit */
+  0x0001 /* 0.1 */,
+  NULL,                                         /* status variables */
+  NULL,                                         /* system variables */
+  NULL,                                         /* config options */
+  0,                                            /* flags */
+},
+{
+  MYSQL_INFORMATION_SCHEMA_PLUGIN,
+  &ldb_i_s_info,
+  "LEVELDB_COMPACTION_HISTORY",
+  "dingqi, taobao.com",
+  "LevelDB flushes, compactions and bulk loads",
+  PLUGIN_LICENSE_GPL,
+  ldb_compaction_history_init,              /* Plugin Init */
+  ldb_i_s_deinit,                           /* Plugin Deinit */
+  0x0001 /* 0.1 */,
+  NULL,                                         /* status variables */
+  NULL,                                         /* system variables */
+  NULL,                                         /* config options */
+  0,                                            /* flags */
+},
+{
+  MYSQL_INFORMATION_SCHEMA_PLUGIN,
+  &ldb_i_s_info,
+  "LEVELDB_LEVEL_STATS",
+  "dingqi, taobao.com",
+  "LevelDB compaction totals per level",
+  PLUGIN_LICENSE_GPL,
+  ldb_level_stats_init,                     /* Plugin Init */
+  ldb_i_s_deinit,                           /* Plugin Deinit */
+  0x0001 /* 0.1 */,
+  NULL,                                         /* status variables */
+  NULL,                                         /* system variables */
+  NULL,                                         /* config options */
+  0,                                            /* flags */
 }
 mysql_declare_plugin_end;
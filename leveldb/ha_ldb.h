@@ -45,8 +45,34 @@
 #include "my_base.h"                     /* ha_rows */
 #include "db.h"
 #include "leveldb/write_batch.h"
+#include "leveldb/indexed_write_batch.h"
+#include "leveldb/bulk_load.h"
+#include <string>
+#include <vector>
 
 #define LDB_MAX_KEY_LENGTH 3500 // Same as innodb
+#define LDB_SCAN_BATCH_ROWS 16   // Rows read ahead per rnd_next() refill
+#define LDB_MRR_BATCH_KEYS 64    // Primary keys looked up per MultiGet()
+#define LDB_INDEX_ID_LENGTH 1    // Index id byte in front of every key
+#define LDB_TABLE_ID_LENGTH 4    // Big endian table id in front of that
+#define LDB_ROW_FORMAT_VERSION 1 // First byte of every stored row
+#define LDB_RANGE_COUNT_LIMIT 64 // records_in_range() counts smaller ranges
+#define LDB_NUM_LEVELS 7         // leveldb::config::kNumLevels
+
+/*
+  All LEVELDB tables share one leveldb instance. Table id 0 is the
+  dictionary, whose keys are the dictionary id followed by one of:
+
+    LDB_DICT_NEXT_ID                 -> next free table id
+    LDB_DICT_TABLE + table path      -> table id
+    LDB_DICT_DROPPED + table id      -> keys of a dropped table remain
+    LDB_DICT_STATS + table id        -> statistics of ANALYZE TABLE
+*/
+#define LDB_DICT_TABLE_ID 0
+#define LDB_DICT_NEXT_ID 'N'
+#define LDB_DICT_TABLE 'T'
+#define LDB_DICT_DROPPED 'D'
+#define LDB_DICT_STATS 'S'
 /** @brief
   LEVELDB_SHARE is a structure that will be shared among all open handlers.
   This ldb implements the minimum of what you will probably need.
@@ -56,14 +82,94 @@ class ha_ldb;
 typedef struct st_ldb_share {
   char *table_name;
   uint table_name_length,use_count;
-  leveldb::DB* db;
+  uint32 table_id;                       ///< Key prefix of the table
+  leveldb::DB* db;                       ///< Engine-wide instance, not owned
   mysql_mutex_t mutex;
   THR_LOCK lock;
+
+  /* Statistics of the last ANALYZE TABLE, protected by mutex. */
+  bool stats_valid;
+  ha_rows stats_records;                 ///< Rows counted
+  ulonglong stats_data_size;             ///< Approximate size of those rows
+  ulong stats_mean_rec_length;           ///< Mean length of a stored row
+  ulong *rec_per_key;                    ///< Every key part of every index
+  uint rec_per_key_count;
 } LEVELDB_SHARE;
 
+/*
+  Memcomparable key encoding. Every key part is encoded into a fixed width
+  byte string whose bytewise order is the SQL order of the part, so the
+  concatenation of all parts sorts like the whole key and any key prefix
+  maps onto a leveldb key prefix.
+*/
+enum ldb_key_encoding {
+  LDB_KEY_INT,          ///< Signed integer: big endian, sign bit flipped
+  LDB_KEY_UINT,         ///< Unsigned integer: big endian
+  LDB_KEY_FLOAT,        ///< IEEE float made sortable as an unsigned integer
+  LDB_KEY_DOUBLE,       ///< IEEE double made sortable as an unsigned integer
+  LDB_KEY_BINARY,       ///< Already memcomparable (DECIMAL, BIT, BINARY...)
+  LDB_KEY_VARBINARY,    ///< Zero padded bytes followed by the 2 byte length
+  LDB_KEY_TEXT          ///< Collation weights of strnxfrm(), not decodable
+};
+
+typedef struct st_ldb_key_part {
+  KEY_PART_INFO *key_part;
+  enum ldb_key_encoding encoding;
+  uint length_bytes;    ///< Length prefix of a VARCHAR in the record, else 0
+  uint data_length;     ///< Encoded length of a NOT NULL value
+} LDB_KEY_PART;
+
+/* Encoding of one index, generated from key_info when the table is opened. */
+typedef struct st_ldb_key_def {
+  LDB_KEY_PART *parts;
+  uint part_count;
+  uint max_length;      ///< Longest encoded key
+  bool decodable;       ///< unpack_key() can restore every part
+} LDB_KEY_DEF;
+
+/*
+  Packed row format. A stored row is the LDB_ROW_FORMAT_VERSION byte, the
+  null bitmap of the record and then every non NULL field in table order,
+  each encoded as below. Compression is left to the leveldb blocks.
+*/
+enum ldb_row_encoding {
+  LDB_ROW_INT,          ///< Signed integer: zigzag varint
+  LDB_ROW_UINT,         ///< Unsigned integer: varint
+  LDB_ROW_VARCHAR,      ///< Varint length and the used bytes
+  LDB_ROW_BLOB,         ///< Varint length and the blob data
+  LDB_ROW_FIXED         ///< The pack_length() bytes of the field
+};
+
+typedef struct st_ldb_row_field {
+  Field *field;
+  enum ldb_row_encoding encoding;
+  uint length;          ///< pack_length() of the field in the record
+  uint length_bytes;    ///< Length prefix of a VARCHAR or BLOB, else 0
+} LDB_ROW_FIELD;
+
+/* Outcome of the pushed index condition for one index entry. */
+enum ldb_icp_result {
+  LDB_ICP_NO_MATCH,     ///< Skip the entry
+  LDB_ICP_MATCH,        ///< Return the row
+  LDB_ICP_OUT_OF_RANGE  ///< Past the end of the range: stop
+};
+
+/* A savepoint is the size of the transaction write batch at that point. */
+typedef struct st_ldb_savepoint {
+  size_t batch_size;
+  int batch_count;
+} LDB_SAVEPOINT;
+
 typedef struct st_trx_t{
-  ha_ldb *pobj;
-  leveldb::WriteBatch batch;
+  leveldb::IndexedWriteBatch batch;      ///< Changes of the transaction
+  LDB_SAVEPOINT stmt_savepoint;          ///< Batch at statement start
+  uint tables_in_use;                    ///< Tables locked by the statement
+  const leveldb::Snapshot *snapshot;     ///< Read view, see ldb_register_stmt()
+  std::vector<std::string> row_locks;    ///< Keys locked, see ldb_lock_row()
+  size_t row_lock_count;                 ///< Entries of row_locks in use
+  struct st_trx_t *lock_wait_owner;      ///< Holder of the lock waited for
+  uint lock_waiters;                     ///< Transactions waiting for this one
+  leveldb::BulkLoad *spill;              ///< Changes moved out of batch, or NULL
 }trx_t;
 
 leveldb::Status leveldb_open(const char *name, bool create_if_missing, leveldb::DB* &db);
@@ -74,15 +180,116 @@ class ha_ldb: public handler
 {
   THR_LOCK_DATA lock;      ///< MySQL lock
 
-  std::string dbpath;    
   THD *thd;
-  void get_key(uchar* buf, std::string &key);
+  const leveldb::Snapshot *snapshot;     ///< Read view of the transaction
+  leveldb::Iterator *scan_iter;          ///< Cursor of the rnd_* table scan
+  leveldb::Iterator *index_iter;         ///< Cursor of the index_* reads
+  std::string scan_prefix;               ///< Keyspace of the table scan
+  std::string index_prefix;              ///< Keyspace of the active index
+  /*
+    Primary key read by the last index_read() with get_row() instead of the
+    index cursor; index_cursor() moves the cursor there when needed.
+  */
+  std::string point_key;
+  bool point_read;
+  bool keyread_covering;                 ///< Active index covers read_set
+
+  /*
+    Hints of the current statement received by extra(): keyread asks for the
+    key columns only, scan_fill_cache is cleared for the big sequential
+    scans the server caches itself, and write_can_replace allows write_row()
+    to overwrite a row with the same primary key.
+  */
+  bool keyread;
+  bool scan_fill_cache;
+  bool write_can_replace;
+
+  /*
+    Conditions pushed down by the optimizer for the current statement.
+    scan_cond filters rnd_next() on the fields in scan_cond_fields, decoded
+    alone; icp_cond filters reads of index icp_keyno on the key columns,
+    before the row is fetched or decoded.
+  */
+  const COND *scan_cond;
+  MY_BITMAP scan_cond_fields;
+  Item *icp_cond;
+  uint icp_keyno;
+  std::string icp_bound;                 ///< Prefix kept while icp_cond skips
+
+  /*
+    Read-ahead batch of the table scan: rnd_next() copies up to
+    LDB_SCAN_BATCH_ROWS entries out of scan_iter at once and hands them out
+    one by one, so the iterator is only stepped on refill.
+  */
+  std::string scan_values[LDB_SCAN_BATCH_ROWS];
+  uint scan_batch_count, scan_batch_pos;
+
+  /*
+    Batch of read_multi_range_next(): when every range is one primary key
+    value, the rows of up to LDB_MRR_BATCH_KEYS ranges are fetched by a
+    single MultiGet().
+  */
+  bool mrr_batched;
+  std::string mrr_values[LDB_MRR_BATCH_KEYS];
+  leveldb::Status mrr_status[LDB_MRR_BATCH_KEYS];
+  uint mrr_batch_count, mrr_batch_pos;
+
+  LDB_KEY_DEF *key_defs;                 ///< One encoding per index
+  LDB_ROW_FIELD *row_fields;             ///< One encoding per field
+  std::string row_blobs;                 ///< Value the blobs of a row point to
+  leveldb::BulkLoad *bulk_load;          ///< Loader of the bulk insert, or NULL
+  uint dup_key;                          ///< Index of the last duplicate key error
+
+  /*
+    Buffers reused from row to row, so that reads and writes of single rows
+    do not allocate: the keys built by index_read() (seek_key), by the
+    write methods (row_key, old_row_key) and by check_unique_keys(), the
+    value of a row being written or read, and the latest value compared by
+    lock_row() or found by key_exists().
+  */
+  std::string seek_key;
+  std::string row_key;
+  std::string old_row_key;
+  std::string unique_key;
+  std::string old_unique_key;
+  std::string row_value;
+  std::string latest_value;
+
+  void key_prefix(uint keynr, std::string &key);
+  void pack_record_key(uint keynr, const uchar *record, std::string &key);
+  void pack_row(const uchar *record, std::string &value);
+  void pack_key(uint keynr, const uchar *key, uint key_len, std::string &skey);
+  bool unpack_key(uint keynr, const leveldb::Slice &key, uchar *record);
+  int unpack_row(uchar *buf, const leveldb::Slice &value);
+  int fill_scan_batch(bool filter);
+  bool scan_cond_matches(const leveldb::Slice &value);
+  enum ldb_icp_result check_index_cond(uchar *buf, bool forward);
+  void fill_mrr_batch();
+  leveldb::Iterator *index_cursor();
+  int read_point_row(uchar *buf, const std::string &skey);
+  int read_index_row(uchar *buf, int not_found_error, bool forward);
+  bool index_covers_read_set(uint keynr);
+  leveldb::ReadOptions read_options() const;
+  leveldb::Iterator *new_iterator(bool fill_cache);
+  leveldb::Status get_row(const leveldb::Slice &key, std::string *value);
+  int read_row(const leveldb::Slice &key, uchar *buf);
+  static void unpack_read_row(void *arg, const leveldb::Slice &value);
+  bool pack_unique_key(uint keynr, const uchar *record, std::string &key);
+  int key_exists(uint keynr, const std::string &key);
+  int check_unique_keys(const uchar *record, const uchar *old_record);
+  int lock_row(const std::string &key, bool *reread);
+  bool can_recheck_row(THD *thd, trx_t *trx);
+  bool can_spill(THD *thd, trx_t *trx);
+  int spill_batch(THD *thd, trx_t *trx);
+  bool can_bulk_load(THD *thd);
 public:
   LEVELDB_SHARE *share;    ///< Shared lock info
 
   ha_ldb(handlerton *hton, TABLE_SHARE *table_arg);
   ~ha_ldb()
   {
+    delete scan_iter;
+    delete index_iter;
   }
   /** @brief
     The name that will be used for display purposes.
@@ -93,7 +300,7 @@ public:
     The name of the index type that will be used for display.
     Don't implement this method unless you really have indexes.
    */
-  const char *index_type(uint inx) { return "HASH"; }
+  const char *index_type(uint inx) { return "BTREE"; }
 
   /** @brief
     The file extensions.
@@ -111,12 +318,35 @@ public:
       an engine that can only handle statement-based logging. This is
       used in testing.
     */
-    return HA_NO_TRANSACTIONS | HA_BINLOG_FLAGS | HA_NO_AUTO_INCREMENT | HA_PRIMARY_KEY_REQUIRED_FOR_DELETE;
+    return HA_BINLOG_FLAGS | HA_NO_AUTO_INCREMENT | HA_PRIMARY_KEY_REQUIRED_FOR_DELETE |
+           HA_PRIMARY_KEY_REQUIRED_FOR_POSITION |
+           HA_NULL_IN_KEY;  // key parts carry a NULL flag byte
   }
 
+  /** @brief
+    Rows are stored in primary key order, and scans see the rows written by
+    the statement, so updates of the primary key must not be done while
+    scanning it.
+  */
+  bool primary_key_is_clustered() { return TRUE; }
+
   ulong index_flags(uint inx, uint part, bool all_parts) const
   {
-    return (HA_READ_NEXT);
+    ulong flags= HA_READ_NEXT | HA_READ_PREV | HA_READ_ORDER | HA_READ_RANGE;
+    KEY_PART_INFO *key_part= table_share->key_info[inx].key_part;
+
+    /* Columns can be read back from the key unless they are collated text. */
+    for (uint i= all_parts ? 0 : part; i <= part; i++)
+    {
+      if (key_part[i].type == HA_KEYTYPE_TEXT ||
+          key_part[i].type == HA_KEYTYPE_VARTEXT1 ||
+          key_part[i].type == HA_KEYTYPE_VARTEXT2)
+        return flags;
+    }
+#ifdef HA_DO_INDEX_COND_PUSHDOWN
+    flags|= HA_DO_INDEX_COND_PUSHDOWN;
+#endif
+    return flags | HA_KEYREAD_ONLY;
   }
   uint max_supported_record_length() const { return HA_MAX_REC_LENGTH; }
   uint max_supported_keys()          const { return MAX_KEY; }
@@ -124,13 +354,25 @@ public:
   uint max_supported_key_length()    const { return LDB_MAX_KEY_LENGTH; }
   uint max_supported_key_part_length() const { return LDB_MAX_KEY_LENGTH; }
 
-  virtual double scan_time() { return (double) (stats.records+stats.deleted) / 20.0+10; }
+  /** @brief
+    A table scan reads the primary key range, counted in IO_SIZE blocks.
+  */
+  virtual double scan_time()
+  { return ulonglong2double(stats.data_file_length) / IO_SIZE + 2; }
 
   /** @brief
-    This method will never be called if you do not implement indexes.
+    Rows read in primary key order cost their share of the table scan;
+    rows read through a secondary index cost one primary key lookup each.
   */
-  virtual double read_time(uint, uint, ha_rows rows)
-  { return (double) rows /  20.0+1; }
+  virtual double read_time(uint index, uint ranges, ha_rows rows)
+  {
+    if (index != table_share->primary_key)
+      return rows2double(ranges + rows);
+    if (stats.records <= rows)
+      return rows2double(ranges) + scan_time();
+    return rows2double(ranges) +
+           rows2double(rows) / rows2double(stats.records) * scan_time();
+  }
 
   /*
     Everything below are methods that we implement in ha_ldb.cc.
@@ -154,6 +396,9 @@ public:
   */
   int write_row(uchar *buf);
 
+  void start_bulk_insert(ha_rows rows);
+  int end_bulk_insert();
+
   /** @brief
     We implement this in ha_ldb.cc. It's not an obligatory method;
     skip it and and MySQL will treat it as not implemented.
@@ -173,6 +418,20 @@ public:
   int index_read(uchar *buf, const uchar *key,
                              uint key_len, ha_rkey_function find_flag);
 
+  /** @brief
+    We implement this in ha_ldb.cc. It's not an obligatory method;
+    skip it and and MySQL will treat it as not implemented.
+  */
+  int index_read_last(uchar *buf, const uchar *key, uint key_len);
+
+  int read_multi_range_first(KEY_MULTI_RANGE **found_range_p,
+                             KEY_MULTI_RANGE *ranges, uint range_count,
+                             bool sorted, HANDLER_BUFFER *buffer);
+  int read_multi_range_next(KEY_MULTI_RANGE **found_range_p);
+
+  int index_init(uint idx, bool sorted);
+  int index_end();
+
   /** @brief
     We implement this in ha_ldb.cc. It's not an obligatory method;
     skip it and and MySQL will treat it as not implemented.
@@ -211,8 +470,14 @@ public:
   int rnd_pos(uchar *buf, uchar *pos);                          ///< required
   void position(const uchar *record);                           ///< required
   int info(uint);                                               ///< required
+  int analyze(THD* thd, HA_CHECK_OPT* check_opt);
   int extra(enum ha_extra_function operation);
+  int reset();
+  const COND *cond_push(const COND *cond);
+  void cond_pop();
+  Item *idx_cond_push(uint keyno, Item *idx_cond);
   int external_lock(THD *thd, int lock_type);                   ///< required
+  int start_stmt(THD *thd, thr_lock_type lock_type);
   int delete_all_rows(void);
   int truncate();
   ha_rows records_in_range(uint inx, key_range *min_key,
@@ -45,6 +45,7 @@ Status BuildTable(const std::string& dbname,
       s = builder->Finish();
       if (s.ok()) {
         meta->file_size = builder->FileSize();
+        meta->num_entries = builder->NumEntries();
         assert(meta->file_size > 0);
       }
     } else {
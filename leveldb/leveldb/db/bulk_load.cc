@@ -0,0 +1,486 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Added entries are buffered as
+//    type: uint8              // kTypeValue or kTypeDeletion
+//    key: varstring
+//    value: varstring         // empty for a deletion
+// and each full buffer is sorted and spilled to a run: a table file whose
+// internal keys all have the run's sequence number, one more than that of
+// the run before it, so that merging the runs puts the newest entry of a
+// key first.  Finish() merges the runs and the last buffer into the
+// output tables, whose entries all get the one sequence number reserved
+// for the load, and hands them to the compaction thread to install.
+
+#include "leveldb/bulk_load.h"
+
+#include <algorithm>
+#include <vector>
+#include "db/db_impl.h"
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "db/table_cache.h"
+#include "db/version_edit.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/table_builder.h"
+#include "leveldb/write_batch.h"
+#include "table/merger.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// A load that never fills this much of its buffer is written through the
+// memtable: a table file of its own would cost more than it saves.
+static const size_t kMinTableLoadSize = 1 << 20;
+
+// Batch size when the entries are written through the memtable.
+static const size_t kLoadWriteBatchSize = 1 << 20;
+
+BulkLoad::~BulkLoad() { }
+
+namespace {
+
+ValueType EntryType(const char* entry) {
+  return static_cast<ValueType>(entry[0]);
+}
+
+Slice EntryKey(const char* entry) {
+  uint32_t len;
+  const char* p = GetVarint32Ptr(entry + 1, entry + 6, &len);
+  return Slice(p, len);
+}
+
+Slice EntryValue(const char* entry) {
+  Slice key = EntryKey(entry);
+  uint32_t len;
+  const char* p = key.data() + key.size();
+  p = GetVarint32Ptr(p, p + 5, &len);
+  return Slice(p, len);
+}
+
+struct EntryLess {
+  const Comparator* comparator;
+  const std::string* buffer;
+  EntryLess(const Comparator* c, const std::string* b)
+      : comparator(c), buffer(b) { }
+  bool operator()(size_t a, size_t b) const {
+    return comparator->Compare(EntryKey(buffer->data() + a),
+                               EntryKey(buffer->data() + b)) < 0;
+  }
+};
+
+struct EntryBefore {
+  const Comparator* comparator;
+  const std::string* buffer;
+  EntryBefore(const Comparator* c, const std::string* b)
+      : comparator(c), buffer(b) { }
+  bool operator()(size_t a, const Slice& user_key) const {
+    return comparator->Compare(EntryKey(buffer->data() + a), user_key) < 0;
+  }
+};
+
+// Iterates over the sorted entries of a buffer, as internal keys with
+// sequence number "sequence".
+class BufferIterator : public Iterator {
+ public:
+  BufferIterator(const InternalKeyComparator* comparator,
+                 const std::string* buffer,
+                 const std::vector<size_t>* entries,
+                 SequenceNumber sequence)
+      : comparator_(comparator),
+        buffer_(buffer),
+        entries_(entries),
+        sequence_(sequence),
+        pos_(entries->size()) {
+  }
+
+  virtual bool Valid() const { return pos_ < entries_->size(); }
+  virtual void SeekToFirst() { pos_ = 0; Update(); }
+  virtual void SeekToLast() {
+    pos_ = entries_->empty() ? 0 : entries_->size() - 1;
+    Update();
+  }
+  virtual void Seek(const Slice& target) {
+    pos_ = std::lower_bound(entries_->begin(), entries_->end(),
+                            ExtractUserKey(target),
+                            EntryBefore(comparator_->user_comparator(),
+                                        buffer_)) -
+           entries_->begin();
+    Update();
+    // Entries of the target's user key may still sort before it
+    while (Valid() && comparator_->Compare(key_, target) < 0) {
+      ++pos_;
+      Update();
+    }
+  }
+  virtual void Next() { assert(Valid()); ++pos_; Update(); }
+  virtual void Prev() {
+    assert(Valid());
+    pos_ = (pos_ == 0) ? entries_->size() : pos_ - 1;
+    Update();
+  }
+  virtual Slice key() const { return key_; }
+  virtual Slice value() const {
+    return EntryValue(buffer_->data() + (*entries_)[pos_]);
+  }
+  virtual Status status() const { return Status::OK(); }
+
+ private:
+  void Update() {
+    key_.clear();
+    if (Valid()) {
+      const char* entry = buffer_->data() + (*entries_)[pos_];
+      AppendInternalKey(&key_, ParsedInternalKey(
+          EntryKey(entry), sequence_, EntryType(entry)));
+    }
+  }
+
+  const InternalKeyComparator* comparator_;
+  const std::string* buffer_;
+  const std::vector<size_t>* entries_;
+  const SequenceNumber sequence_;
+  size_t pos_;
+  std::string key_;
+
+  // No copying allowed
+  BufferIterator(const BufferIterator&);
+  void operator=(const BufferIterator&);
+};
+
+}  // namespace
+
+class BulkLoadImpl : public BulkLoad {
+ public:
+  BulkLoadImpl(DBImpl* db, const WriteOptions& options, size_t buffer_size,
+               bool overwrite)
+      : db_(db),
+        user_comparator_(db->internal_comparator_.user_comparator()),
+        write_options_(options),
+        buffer_size_(buffer_size),
+        overwrite_(overwrite),
+        finished_(false) {
+  }
+
+  virtual ~BulkLoadImpl() {
+    DeleteFiles(&runs_);
+    DeleteFiles(&outputs_);
+  }
+
+  virtual void Add(const Slice& key, const Slice& value) {
+    AddEntry(kTypeValue, key, value);
+  }
+
+  virtual void Delete(const Slice& key) {
+    assert(overwrite_);
+    AddEntry(kTypeDeletion, key, Slice());
+  }
+
+  virtual Status status() const { return status_; }
+
+  virtual Status Finish();
+
+ private:
+  void AddEntry(ValueType type, const Slice& key, const Slice& value);
+  Iterator* NewBufferIterator();
+  Iterator* NewFilesIterator(const std::vector<FileMetaData*>& files,
+                             Iterator* buffer_iter);
+  Status WriteTables(Iterator* input, SequenceNumber sequence,
+                     uint64_t max_file_size,
+                     std::vector<FileMetaData*>* files);
+  Status FinishTable(TableBuilder* builder, WritableFile* file,
+                     FileMetaData* meta, const InternalKey& largest);
+  Status WriteThrough(Iterator* input, size_t batch_size);
+  void DeleteFiles(std::vector<FileMetaData*>* files);
+
+  DBImpl* const db_;
+  const Comparator* const user_comparator_;
+  const WriteOptions write_options_;
+  const size_t buffer_size_;
+  const bool overwrite_;
+  bool finished_;
+  Status status_;
+  std::string buffer_;
+  std::vector<size_t> entries_;          // Offsets of the entries in buffer_
+  std::vector<FileMetaData*> runs_;
+  std::vector<FileMetaData*> outputs_;
+};
+
+void BulkLoadImpl::AddEntry(ValueType type, const Slice& key,
+                            const Slice& value) {
+  assert(!finished_);
+  if (!status_.ok()) {
+    return;
+  }
+  entries_.push_back(buffer_.size());
+  buffer_.push_back(static_cast<char>(type));
+  PutLengthPrefixedSlice(&buffer_, key);
+  PutLengthPrefixedSlice(&buffer_, value);
+  if (buffer_.size() >= buffer_size_) {
+    Iterator* iter = NewBufferIterator();
+    status_ = WriteTables(iter, runs_.size() + 1, ~static_cast<uint64_t>(0),
+                          &runs_);
+    delete iter;
+    buffer_.clear();
+    entries_.clear();
+  }
+}
+
+// Sorts the buffer and returns an iterator over it, with the sequence
+// number of the next run.  An overwriting load keeps only the last entry
+// added for each key.
+Iterator* BulkLoadImpl::NewBufferIterator() {
+  std::stable_sort(entries_.begin(), entries_.end(),
+                   EntryLess(user_comparator_, &buffer_));
+  if (overwrite_ && !entries_.empty()) {
+    size_t n = 0;
+    for (size_t i = 1; i < entries_.size(); i++) {
+      if (user_comparator_->Compare(EntryKey(buffer_.data() + entries_[i]),
+                                    EntryKey(buffer_.data() + entries_[n]))
+          != 0) {
+        n++;
+      }
+      entries_[n] = entries_[i];
+    }
+    entries_.resize(n + 1);
+  }
+  return new BufferIterator(&db_->internal_comparator_, &buffer_, &entries_,
+                            runs_.size() + 1);
+}
+
+// Returns a merging iterator over "files" and, if not NULL, "buffer_iter".
+Iterator* BulkLoadImpl::NewFilesIterator(
+    const std::vector<FileMetaData*>& files, Iterator* buffer_iter) {
+  ReadOptions options;
+  options.fill_cache = false;
+  std::vector<Iterator*> list;
+  for (size_t i = 0; i < files.size(); i++) {
+    list.push_back(db_->table_cache_->NewIterator(
+        options, files[i]->number, files[i]->file_size));
+  }
+  if (buffer_iter != NULL) {
+    list.push_back(buffer_iter);
+  }
+  return NewMergingIterator(&db_->internal_comparator_, &list[0], list.size());
+}
+
+// Writes the entries of "input" to new table files of about
+// "max_file_size" bytes, with the given sequence number.  Of the entries
+// of a user key, an overwriting load keeps the first, which is the newest;
+// any other load fails with InvalidArgument.
+Status BulkLoadImpl::WriteTables(Iterator* input, SequenceNumber sequence,
+                                 uint64_t max_file_size,
+                                 std::vector<FileMetaData*>* files) {
+  Status s;
+  TableBuilder* builder = NULL;
+  WritableFile* file = NULL;
+  FileMetaData* meta = NULL;
+  bool has_last = false;
+  std::string last_user_key;
+  ValueType last_type = kTypeValue;
+  std::string internal_key;
+  for (input->SeekToFirst(); input->Valid(); input->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(input->key(), &ikey)) {
+      s = Status::Corruption("bad internal key in bulk load");
+      break;
+    }
+    const Slice user_key = ikey.user_key;
+    if (has_last && user_comparator_->Compare(user_key, last_user_key) == 0) {
+      if (overwrite_) {
+        continue;
+      }
+      s = Status::InvalidArgument("duplicate key in bulk load");
+      break;
+    }
+
+    if (builder == NULL) {
+      meta = new FileMetaData;
+      meta->number = db_->NewPendingFileNumber();
+      files->push_back(meta);
+      s = db_->env_->NewWritableFile(
+          TableFileName(db_->dbname_, meta->number), &file);
+      if (!s.ok()) {
+        break;
+      }
+      builder = new TableBuilder(db_->options_, file);
+      meta->smallest = InternalKey(user_key, sequence, ikey.type);
+    }
+
+    internal_key.clear();
+    AppendInternalKey(&internal_key,
+                      ParsedInternalKey(user_key, sequence, ikey.type));
+    builder->Add(internal_key, input->value());
+    last_user_key.assign(user_key.data(), user_key.size());
+    last_type = ikey.type;
+    has_last = true;
+
+    if (builder->FileSize() >= max_file_size) {
+      s = FinishTable(builder, file, meta,
+                      InternalKey(last_user_key, sequence, last_type));
+      builder = NULL;
+      file = NULL;
+      if (!s.ok()) {
+        break;
+      }
+    }
+  }
+  if (s.ok()) {
+    s = input->status();
+  }
+
+  if (builder != NULL) {
+    if (s.ok()) {
+      s = FinishTable(builder, file, meta,
+                      InternalKey(last_user_key, sequence, last_type));
+    } else {
+      builder->Abandon();
+      delete builder;
+      delete file;
+    }
+  }
+  return s;
+}
+
+Status BulkLoadImpl::FinishTable(TableBuilder* builder, WritableFile* file,
+                                 FileMetaData* meta,
+                                 const InternalKey& largest) {
+  Status s = builder->Finish();
+  meta->file_size = builder->FileSize();
+  meta->num_entries = builder->NumEntries();
+  meta->largest = largest;
+  delete builder;
+
+  if (s.ok()) {
+    s = file->Sync();
+  }
+  if (s.ok()) {
+    s = file->Close();
+  }
+  delete file;
+
+  if (s.ok()) {
+    // Verify that the table is usable
+    ReadOptions options;
+    options.fill_cache = false;
+    Iterator* iter = db_->table_cache_->NewIterator(options, meta->number,
+                                                    meta->file_size);
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+// Writes the entries of "input" through the memtable, in batches of
+// about "batch_size" bytes.  Duplicate keys are handled as in
+// WriteTables().
+Status BulkLoadImpl::WriteThrough(Iterator* input, size_t batch_size) {
+  Status s;
+  WriteBatch batch;
+  bool has_last = false;
+  std::string last_user_key;
+  for (input->SeekToFirst(); input->Valid(); input->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(input->key(), &ikey)) {
+      return Status::Corruption("bad internal key in bulk load");
+    }
+    const Slice user_key = ikey.user_key;
+    if (has_last && user_comparator_->Compare(user_key, last_user_key) == 0) {
+      if (overwrite_) {
+        continue;
+      }
+      return Status::InvalidArgument("duplicate key in bulk load");
+    }
+    if (ikey.type == kTypeDeletion) {
+      batch.Delete(user_key);
+    } else {
+      batch.Put(user_key, input->value());
+    }
+    has_last = true;
+    last_user_key.assign(user_key.data(), user_key.size());
+
+    if (batch.ApproximateSize() >= batch_size) {
+      s = db_->Write(write_options_, &batch);
+      if (!s.ok()) {
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  s = input->status();
+  if (s.ok() && batch.Count() > 0) {
+    s = db_->Write(write_options_, &batch);
+  }
+  return s;
+}
+
+void BulkLoadImpl::DeleteFiles(std::vector<FileMetaData*>* files) {
+  for (size_t i = 0; i < files->size(); i++) {
+    const uint64_t number = (*files)[i]->number;
+    db_->table_cache_->Evict(number);
+    db_->env_->DeleteFile(TableFileName(db_->dbname_, number));
+    db_->ReleasePendingFile(number);
+    delete (*files)[i];
+  }
+  files->clear();
+}
+
+Status BulkLoadImpl::Finish() {
+  assert(!finished_);
+  finished_ = true;
+  if (!status_.ok()) {
+    return status_;
+  }
+
+  if (runs_.empty() && buffer_.size() < kMinTableLoadSize) {
+    // One batch, so that a failed load leaves the DB unchanged.
+    Iterator* iter = NewBufferIterator();
+    status_ = WriteThrough(iter, ~static_cast<size_t>(0));
+    delete iter;
+    return status_;
+  }
+
+  // Reserve the sequence number before the files are written, so that
+  // the entries are older than any write made while they are installed.
+  uint64_t newer_file_number;
+  const SequenceNumber sequence = db_->ReserveSequence(&newer_file_number);
+  Iterator* input = NewFilesIterator(runs_, NewBufferIterator());
+  status_ = WriteTables(input, sequence, db_->config_.kTargetFileSize, &outputs_);
+  delete input;
+  DeleteFiles(&runs_);
+  buffer_.clear();
+  entries_.clear();
+  if (!status_.ok() || outputs_.empty()) {
+    return status_;
+  }
+
+  int level = -1;
+  status_ = db_->InstallBulkLoad(outputs_, newer_file_number, &level);
+  if (status_.ok() && level < 0) {
+    // The key range has data in the memtable, level-0 or files written
+    // since the sequence was reserved, which only newer writes may go on
+    // top of.  The entries are written in bounded batches, so that a
+    // large load does not turn into one huge log record and memtable
+    // insert; readers may see a part of the load meanwhile.
+    input = NewFilesIterator(outputs_, NULL);
+    status_ = WriteThrough(input, kLoadWriteBatchSize);
+    delete input;
+    DeleteFiles(&outputs_);
+  } else if (status_.ok()) {
+    // The files belong to the DB now.
+    for (size_t i = 0; i < outputs_.size(); i++) {
+      db_->ReleasePendingFile(outputs_[i]->number);
+      delete outputs_[i];
+    }
+    outputs_.clear();
+  }
+  return status_;
+}
+
+BulkLoad* DBImpl::NewBulkLoad(const WriteOptions& options,
+                              size_t buffer_size, bool overwrite) {
+  return new BulkLoadImpl(this, options, buffer_size, overwrite);
+}
+
+}  // namespace leveldb
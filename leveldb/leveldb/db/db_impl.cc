@@ -60,6 +60,7 @@ struct DBImpl::CompactionState {
   struct Output {
     uint64_t number;
     uint64_t file_size;
+    uint64_t num_entries;
     InternalKey smallest, largest;
   };
   std::vector<Output> outputs;
@@ -70,16 +71,43 @@ struct DBImpl::CompactionState {
 
   uint64_t total_bytes;
 
+  // Entries read from the inputs and the ones not written back
+  uint64_t input_entries;
+  uint64_t dropped_entries;
+
   Output* current_output() { return &outputs[outputs.size()-1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
         outfile(NULL),
         builder(NULL),
-        total_bytes(0) {
+        total_bytes(0),
+        input_entries(0),
+        dropped_entries(0) {
   }
 };
 
+// Number of jobs kept for GetCompactionHistory()
+static const size_t kCompactionHistorySize = 128;
+
+static CompactionInfo NewCompactionInfo(CompactionInfo::Type type,
+                                        uint64_t start_micros) {
+  CompactionInfo info;
+  info.type = type;
+  info.ok = true;
+  info.start_micros = start_micros;
+  info.end_micros = start_micros;
+  info.input_level = -1;
+  info.output_level = -1;
+  info.input_files = 0;
+  info.output_files = 0;
+  info.bytes_read = 0;
+  info.bytes_written = 0;
+  info.input_entries = 0;
+  info.dropped_entries = 0;
+  return info;
+}
+
 // Fix user-supplied options to be reasonable
 template <class T,class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
@@ -110,9 +138,10 @@ Options SanitizeOptions(const std::string& dbname,
   if (result.block_cache == NULL) {
     result.block_cache = NewLRUCache(result.block_cache_size);
   }
-
-  // config sort of
-  config::setConfig(result);
+  // we make filter base <= block_size here, actually can >. see filter_block.cc;
+  while ((1 << result.kFilterBaseLg) > result.block_size) {
+    --result.kFilterBaseLg;
+  }
   return result;
 }
 
@@ -122,6 +151,7 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
       internal_filter_policy_(options.filter_policy),
       options_(SanitizeOptions(
           dbname, &internal_comparator_, &internal_filter_policy_, options)),
+      config_(options_),
       owns_info_log_(options_.info_log != options.info_log),
       owns_cache_(options_.block_cache != options.block_cache),
       dbname_(dbname),
@@ -129,7 +159,7 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
       db_lock_(NULL),
       shutting_down_(NULL),
       bg_cv_(&mutex_),
-      mem_(new MemTable(internal_comparator_, env_)),
+      mem_(new MemTable(internal_comparator_, env_, config_.kArenaBlockSize)),
       imm_(NULL),
       logfile_(NULL),
       logfile_number_(0),
@@ -144,7 +174,19 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
       // @@
       has_limited_delete_obsolete_file_count_(0),
       bg_compaction_scheduled_(false),
-      manual_compaction_(NULL) {
+      manual_compaction_(NULL),
+      write_groups_(0),
+      write_group_batches_(0),
+      log_syncs_(0),
+      log_bytes_(0),
+      flush_bytes_(0),
+      compaction_bytes_read_(0),
+      compaction_bytes_written_(0),
+      bulk_load_bytes_(0),
+      table_syncs_(0),
+      stall_micros_(0),
+      write_slowdowns_(0),
+      write_stops_(0) {
   mem_->Ref();
   has_imm_.Release_Store(NULL);
 
@@ -152,7 +194,7 @@ DBImpl::DBImpl(const Options& options, const std::string& dbname)
   const int table_cache_size = options.max_open_files - 10;
   table_cache_ = new TableCache(dbname_, &options_, table_cache_size);
 
-  versions_ = new VersionSet(dbname_, &options_, table_cache_,
+  versions_ = new VersionSet(dbname_, &options_, &config_, table_cache_,
                              &internal_comparator_);
 }
 
@@ -230,7 +272,7 @@ void DBImpl::MaybeIgnoreError(Status* s) const {
 }
 
 void DBImpl::DeleteObsoleteFiles() {
-  if (++has_limited_delete_obsolete_file_count_ < config::kLimitDeleteObsoleteFileInterval) {
+  if (++has_limited_delete_obsolete_file_count_ < config_.kLimitDeleteObsoleteFileInterval) {
     Log(options_.info_log, "limit delete %lu", has_limited_delete_obsolete_file_count_);
     // we limit delete obsolete file now
     return ;
@@ -447,7 +489,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == NULL) {
-      mem = new MemTable(internal_comparator_, env_);
+      mem = new MemTable(internal_comparator_, env_, config_.kArenaBlockSize);
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -530,13 +572,27 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       PROFILER_END();
     }
     edit->AddFile(level, meta.number, meta.file_size,
-                  meta.smallest, meta.largest);
+                  meta.smallest, meta.largest, meta.num_entries);
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
   stats_[level].Add(stats);
+  flush_bytes_ += meta.file_size;
+  if (meta.file_size > 0) {
+    table_syncs_++;
+  }
+
+  CompactionInfo info = NewCompactionInfo(CompactionInfo::kFlush,
+                                          start_micros);
+  info.ok = s.ok();
+  info.end_micros = start_micros + stats.micros;
+  info.output_level = level;
+  info.output_files = (meta.file_size > 0) ? 1 : 0;
+  info.bytes_written = meta.file_size;
+  info.input_entries = meta.num_entries;
+  RecordCompaction(info);
   return s;
 }
 
@@ -744,7 +800,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates, int bucke
 }
 
 Status DBImpl::MakeRoomForWrite(bool force, int bucket, BucketUpdate** bucket_update) {
-  static int kMaxMemTableCount = options_.max_mem_usage_for_memtable / options_.write_buffer_size;
+  const size_t kMaxMemTableCount = options_.max_mem_usage_for_memtable / options_.write_buffer_size;
   static int kRetryCount = 3;
   static int kEvictMemTableCount = 5;
 
@@ -800,9 +856,12 @@ Status DBImpl::MakeRoomForWrite(bool force, int bucket, BucketUpdate** bucket_up
 
     MaybeScheduleCompaction();
 
+    const uint64_t start_micros = env_->NowMicros();
     mutex_.Unlock();
     env_->SleepForMicroseconds(10000);
     mutex_.Lock();
+    stall_micros_ += env_->NowMicros() - start_micros;
+    write_stops_++;
     Log(options_.info_log, "wait for less mmt. now %zd + %d", bucket_map_.size(), imm_list_count_);
   }
 
@@ -831,7 +890,7 @@ Status DBImpl::MakeRoomForWrite(bool force, int bucket, BucketUpdate** bucket_up
   bu->log_number_ = new_log_number;
   bu->logfile_ = lfile;
   bu->log_ = new log::Writer(lfile);
-  bu->mem_ = new MemTable(internal_comparator_, env_);
+  bu->mem_ = new MemTable(internal_comparator_, env_, config_.kArenaBlockSize);
   bu->mem_->Ref();
   // link to bucket list tail
   bu->next_ = NULL;
@@ -1053,11 +1112,8 @@ Status DBImpl::DoCompactionWorkSelfLevel(CompactionState* compact) {
   assert(compact->outfile == NULL);
 
   // consider snapshot here, but ShouldDrop() ignore it.
-  if (snapshots_.empty()) {
-    compact->smallest_snapshot = versions_->LastSequence();
-  } else {
-    compact->smallest_snapshot = snapshots_.oldest()->number_;
-  }
+  compact->smallest_snapshot =
+      snapshots_.OldestSequence(versions_->LastSequence());
 
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
   input->SeekToFirst();
@@ -1126,7 +1182,10 @@ Status DBImpl::DoCompactionWorkSelfLevel(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-    if (!drop) {
+    compact->input_entries++;
+    if (drop) {
+      compact->dropped_entries++;
+    } else {
       // Open output file if necessary
       if (compact->builder == NULL) {
         status = OpenCompactionOutputFile(compact);
@@ -1178,6 +1237,9 @@ Status DBImpl::DoCompactionWorkSelfLevel(CompactionState* compact) {
 
   // stat add this level
   stats_[compact->compaction->level()].Add(stats);
+  compaction_bytes_read_ += stats.bytes_read;
+  compaction_bytes_written_ += stats.bytes_written;
+  table_syncs_ += compact->outputs.size();
 
   if (status.ok()) {
     Log(options_.info_log,  "SelfLevel Compacted %d@%d (%ld) bytes => %ld bytes, [%ld + %ld]",
@@ -1189,12 +1251,319 @@ Status DBImpl::DoCompactionWorkSelfLevel(CompactionState* compact) {
       );
     status = InstallCompactionResults(compact, false); // output files is in current level, not level + 1
   }
+
+  CompactionInfo info = NewCompactionInfo(
+      CompactionInfo::kSelfLevelCompaction, start_micros);
+  info.ok = status.ok();
+  info.end_micros = env_->NowMicros();
+  info.input_level = compact->compaction->level();
+  info.output_level = compact->compaction->level();
+  info.input_files = compact->compaction->num_input_files(0);
+  info.output_files = compact->outputs.size();
+  info.bytes_read = stats.bytes_read;
+  info.bytes_written = stats.bytes_written;
+  info.input_entries = compact->input_entries;
+  info.dropped_entries = compact->dropped_entries;
+  RecordCompaction(info);
+
   VersionSet::LevelSummaryStorage tmp;
   Log(options_.info_log,
       "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
+//////////////////////////////////////////
+// bulk load support
+//////////////////////////////////////////
+
+uint64_t DBImpl::NewPendingFileNumber() {
+  MutexLock l(&mutex_);
+  uint64_t number = versions_->NewFileNumber();
+  pending_outputs_.insert(number);
+  return number;
+}
+
+void DBImpl::ReleasePendingFile(uint64_t number) {
+  MutexLock l(&mutex_);
+  pending_outputs_.erase(number);
+}
+
+// Only the writer at the front of writers_ assigns sequence numbers, so
+// queue up like a write and take one when our turn comes.  Entries newer
+// than the sequence can only reach table files numbered from
+// *next_file_number on, since they are written to a memtable after this.
+SequenceNumber DBImpl::ReserveSequence(uint64_t* next_file_number) {
+  Writer w(&mutex_);
+  w.batch = NULL;
+  w.sync = false;
+
+  MutexLock l(&mutex_);
+  do {
+    // A group leader may have retired us along with its group; queue again.
+    w.done = false;
+    writers_.push_back(&w);
+    while (!w.done && &w != writers_.front()) {
+      w.cv.Wait();
+    }
+  } while (w.done);
+
+  const SequenceNumber sequence = versions_->LastSequence() + 1;
+  versions_->SetLastSequence(sequence);
+  *next_file_number = versions_->NextFileNumber();
+  writers_.pop_front();
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  return sequence;
+}
+
+static bool MemTableOverlap(MemTable* mem, const Comparator* ucmp,
+                            const Slice& smallest_user_key,
+                            const Slice& largest_user_key) {
+  Iterator* iter = mem->NewIterator();
+  InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
+  iter->Seek(start.Encode());
+  bool overlap = iter->Valid() &&
+    ucmp->Compare(ExtractUserKey(iter->key()), largest_user_key) <= 0;
+  delete iter;
+  return overlap;
+}
+
+// REQUIRES: mutex_ is held
+bool DBImpl::MemTablesOverlap(const Slice& smallest_user_key,
+                              const Slice& largest_user_key) {
+  mutex_.AssertHeld();
+  std::vector<MemTable*> mems;
+  mems.push_back(mem_);
+  if (imm_ != NULL) {
+    mems.push_back(imm_);
+  }
+  for (BucketMap::iterator it = bucket_map_.begin(); it != bucket_map_.end(); ++it) {
+    mems.push_back(it->second->mem_);
+  }
+  for (BucketList::iterator it = imm_list_.begin(); it != imm_list_.end(); ++it) {
+    mems.push_back((*it)->mem_);
+  }
+
+  const Comparator* ucmp = internal_comparator_.user_comparator();
+  for (size_t i = 0; i < mems.size(); ++i) {
+    if (MemTableOverlap(mems[i], ucmp, smallest_user_key, largest_user_key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Installs the non-overlapping, sorted "files" on the compaction thread,
+// which is the only one to apply version edits.  Files numbered from
+// "newer_file_number" on may hold entries newer than "files".  Sets
+// *level to the level the files went to, or to -1 if they cannot be
+// installed.
+Status DBImpl::InstallBulkLoad(const std::vector<FileMetaData*>& files,
+                               uint64_t newer_file_number, int* level) {
+  assert(!files.empty());
+  ManualCompaction manual;
+  manual.level = -1;
+  manual.done = false;
+  manual.begin = NULL;
+  manual.end = NULL;
+  manual.reschedule = true;     // the new files may need compaction
+  manual.bulk_files = &files;
+  manual.bulk_newer_files = newer_file_number;
+  manual.bg_compaction_func = &DBImpl::BackgroundBulkLoad;
+
+  int64_t timed_us = 1000000;   // 1s
+  MutexLock l(&mutex_);
+  while (bg_compaction_scheduled_ || manual_compaction_ != NULL) {
+    bg_cv_.TimedWait(timed_us);
+  }
+  if (shutting_down_.Acquire_Load()) {
+    return Status::IOError("Deleting DB during bulk load");
+  }
+  manual_compaction_ = &manual;
+  MaybeScheduleCompaction();
+  while (manual_compaction_ == &manual) {
+    bg_cv_.TimedWait(timed_us);
+  }
+
+  *level = manual.level;
+  return manual.compaction_status;
+}
+
+void DBImpl::BackgroundBulkLoad() {
+  assert(bg_compaction_scheduled_);
+  assert(manual_compaction_ != NULL);
+  ManualCompaction* m = manual_compaction_;
+  const std::vector<FileMetaData*>& files = *m->bulk_files;
+  const Slice smallest = files.front()->smallest.user_key();
+  const Slice largest = files.back()->largest.user_key();
+
+  // Memtable dumps and compactions only run on this thread, so no data
+  // can move into the range before the edit is applied.  Writes made
+  // meanwhile are newer than the files, whose sequence number was
+  // reserved before they were written.  So were the writes made while
+  // the files were written, which may already have been compacted down
+  // the levels: the files must not go above a table file made since the
+  // sequence was reserved.
+  mutex_.Lock();
+  Version* base = versions_->current();
+  base->Ref();
+  const bool in_memtable = MemTablesOverlap(smallest, largest);
+  mutex_.Unlock();
+
+  // Level-0 files are searched newest file first, not newest entry first,
+  // so the files must not overlap any older level-0 file.
+  int level = -1;
+  if (!in_memtable && !base->OverlapInLevel(0, &smallest, &largest)) {
+    level = 0;
+    while (level + 1 < config::kNumLevels &&
+           !base->OverlapInLevel(level + 1, &smallest, &largest)) {
+      level++;
+    }
+    std::vector<FileMetaData*> below;
+    for (int l = level + 1; l < config::kNumLevels && level >= 0; l++) {
+      base->GetOverlappingInputs(l, &files.front()->smallest,
+                                 &files.back()->largest, &below);
+      for (size_t i = 0; i < below.size(); i++) {
+        if (below[i]->number >= m->bulk_newer_files) {
+          level = -1;
+          break;
+        }
+      }
+    }
+  }
+
+  Status status;
+  if (level >= 0) {
+    const uint64_t start_micros = env_->NowMicros();
+    VersionEdit edit;
+    CompactionStats stats;
+    for (size_t i = 0; i < files.size(); i++) {
+      const FileMetaData* f = files[i];
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                   f->num_entries);
+      stats.bytes_written += f->file_size;
+    }
+    status = versions_->LogAndApply(&edit, &mutex_);
+    stats.micros = env_->NowMicros() - start_micros;
+    stats_[level].Add(stats);
+    bulk_load_bytes_ += stats.bytes_written;
+    table_syncs_ += files.size();
+
+    CompactionInfo info = NewCompactionInfo(CompactionInfo::kBulkLoad,
+                                            start_micros);
+    info.ok = status.ok();
+    info.end_micros = start_micros + stats.micros;
+    info.output_level = level;
+    info.output_files = files.size();
+    info.bytes_written = stats.bytes_written;
+    for (size_t i = 0; i < files.size(); i++) {
+      info.input_entries += files[i]->num_entries;
+    }
+    RecordCompaction(info);
+    VersionSet::LevelSummaryStorage tmp;
+    Log(options_.info_log, "Bulk loaded %d files to level-%d %lld bytes %s: %s\n",
+        static_cast<int>(files.size()), level,
+        static_cast<long long>(stats.bytes_written),
+        status.ToString().c_str(),
+        versions_->LevelSummary(&tmp));
+  } else {
+    Log(options_.info_log, "Bulk load overlaps %s, not installed\n",
+        in_memtable ? "memtable" : "level-0 or newer files");
+  }
+
+  mutex_.Lock();
+  base->Unref();
+  m->level = status.ok() ? level : -1;
+  m->compaction_status = status;
+  m->done = true;
+  manual_compaction_ = NULL;
+  mutex_.Unlock();
+}
+
+// Removes the files of the range on the compaction thread, so that no
+// compaction is rewriting them meanwhile.
+Status DBImpl::DeleteFilesInRange(const Slice& begin, const Slice& end) {
+  Range range(begin, end);
+  ManualCompaction manual;
+  manual.level = -1;
+  manual.done = false;
+  manual.begin = NULL;
+  manual.end = NULL;
+  manual.reschedule = true;
+  manual.delete_range = &range;
+  manual.bg_compaction_func = &DBImpl::BackgroundDeleteFiles;
+
+  int64_t timed_us = 1000000;   // 1s
+  MutexLock l(&mutex_);
+  while (bg_compaction_scheduled_ || manual_compaction_ != NULL) {
+    bg_cv_.TimedWait(timed_us);
+  }
+  if (shutting_down_.Acquire_Load()) {
+    return Status::IOError("Deleting DB during DeleteFilesInRange");
+  }
+  manual_compaction_ = &manual;
+  MaybeScheduleCompaction();
+  while (manual_compaction_ == &manual) {
+    bg_cv_.TimedWait(timed_us);
+  }
+  return manual.compaction_status;
+}
+
+void DBImpl::BackgroundDeleteFiles() {
+  assert(bg_compaction_scheduled_);
+  assert(manual_compaction_ != NULL);
+  ManualCompaction* m = manual_compaction_;
+  const Comparator* ucmp = internal_comparator_.user_comparator();
+  const Range* range = m->delete_range;
+
+  // Only this thread installs new versions, so the file list can not
+  // change between building the edit and applying it.
+  mutex_.Lock();
+  const uint64_t start_micros = env_->NowMicros();
+  Version* base = versions_->current();
+  VersionEdit edit;
+  CompactionInfo info = NewCompactionInfo(CompactionInfo::kDeleteFiles,
+                                          start_micros);
+  uint64_t bytes = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = base->files(level);
+    for (size_t i = 0; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      if (ucmp->Compare(f->smallest.user_key(), range->start) >= 0 &&
+          ucmp->Compare(f->largest.user_key(), range->limit) < 0) {
+        edit.DeleteFile(level, f->number);
+        info.input_files++;
+        bytes += f->file_size;
+        info.input_entries += f->num_entries;
+      }
+    }
+  }
+  mutex_.Unlock();
+
+  Status status;
+  if (info.input_files > 0) {
+    status = versions_->LogAndApply(&edit, &mutex_);
+    info.ok = status.ok();
+    info.end_micros = env_->NowMicros();
+    info.dropped_entries = info.input_entries;
+    RecordCompaction(info);
+    VersionSet::LevelSummaryStorage tmp;
+    Log(options_.info_log, "Deleted %d files in range, %lld bytes %s: %s\n",
+        info.input_files, static_cast<long long>(bytes),
+        status.ToString().c_str(), versions_->LevelSummary(&tmp));
+    if (status.ok()) {
+      DeleteObsoleteFiles();
+    }
+  }
+
+  mutex_.Lock();
+  m->compaction_status = status;
+  m->done = true;
+  manual_compaction_ = NULL;
+  mutex_.Unlock();
+}
+
 //////////////////////////////////////////
 // special write to support multi-bucket update
 //////////////////////////////////////////
@@ -1232,7 +1601,7 @@ void DBImpl::BackgroundCall() {
   PROFILER_END();
   assert(bg_compaction_scheduled_);
   if (!shutting_down_.Acquire_Load()) {
-    if (manual_compaction_ != NULL) {
+    if (manual_compaction_ != NULL && manual_compaction_->bg_compaction_func != NULL) {
       mutex_.Unlock();
       (this->*manual_compaction_->bg_compaction_func)(); // use user-defined compaction function
       mutex_.Lock();
@@ -1300,12 +1669,21 @@ void DBImpl::BackgroundCompaction() {
     // Move file to next level
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
+    CompactionInfo info = NewCompactionInfo(CompactionInfo::kTrivialMove,
+                                            env_->NowMicros());
     c->edit()->DeleteFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-                       f->smallest, f->largest);
+                       f->smallest, f->largest, f->num_entries);
     PROFILER_BEGIN("com move lAa+");
     status = versions_->LogAndApply(c->edit(), &mutex_);
     PROFILER_END();
+    info.ok = status.ok();
+    info.end_micros = env_->NowMicros();
+    info.input_level = c->level();
+    info.output_level = c->level() + 1;
+    info.input_files = 1;
+    info.output_files = 1;
+    RecordCompaction(info);
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
         static_cast<unsigned long long>(f->number),
@@ -1382,6 +1760,7 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
+    out.num_entries = 0;
     out.smallest.Clear();
     out.largest.Clear();
     compact->outputs.push_back(out);
@@ -1416,6 +1795,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   }
   const uint64_t current_bytes = compact->builder->FileSize();
   compact->current_output()->file_size = current_bytes;
+  compact->current_output()->num_entries = current_entries;
   compact->total_bytes += current_bytes;
   delete compact->builder;
   compact->builder = NULL;
@@ -1458,7 +1838,8 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact, bool uppen_lev
     const CompactionState::Output& out = compact->outputs[i];
     compact->compaction->edit()->AddFile(
         output_level,
-        out.number, out.file_size, out.smallest, out.largest);
+        out.number, out.file_size, out.smallest, out.largest,
+        out.num_entries);
   }
   PROFILER_BEGIN("lAa+");
   Status s = versions_->LogAndApply(compact->compaction->edit(), &mutex_);
@@ -1479,11 +1860,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == NULL);
   assert(compact->outfile == NULL);
-  if (snapshots_.empty()) {
-    compact->smallest_snapshot = versions_->LastSequence();
-  } else {
-    compact->smallest_snapshot = snapshots_.oldest()->number_;
-  }
+  compact->smallest_snapshot =
+      snapshots_.OldestSequence(versions_->LastSequence());
 
   PROFILER_BEGIN("do real file com-");
 
@@ -1569,7 +1947,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-    if (!drop) {
+    compact->input_entries++;
+    if (drop) {
+      compact->dropped_entries++;
+    } else {
       // Open output file if necessary
       if (compact->builder == NULL) {
         status = OpenCompactionOutputFile(compact);
@@ -1621,6 +2002,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
   PROFILER_END();
   stats_[compact->compaction->level() + 1].Add(stats);
+  compaction_bytes_read_ += stats.bytes_read;
+  compaction_bytes_written_ += stats.bytes_written;
+  table_syncs_ += compact->outputs.size();
 
   if (status.ok()) {
     Log(options_.info_log,  "Compacted %d@%d + %d@%d files => %ld bytes, [%ld + %ld]",
@@ -1635,6 +2019,22 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = InstallCompactionResults(compact);
     PROFILER_END();
   }
+
+  CompactionInfo info = NewCompactionInfo(CompactionInfo::kCompaction,
+                                          start_micros);
+  info.ok = status.ok();
+  info.end_micros = env_->NowMicros();
+  info.input_level = compact->compaction->level();
+  info.output_level = compact->compaction->level() + 1;
+  info.input_files = compact->compaction->num_input_files(0) +
+                     compact->compaction->num_input_files(1);
+  info.output_files = compact->outputs.size();
+  info.bytes_read = stats.bytes_read;
+  info.bytes_written = stats.bytes_written;
+  info.input_entries = compact->input_entries;
+  info.dropped_entries = compact->dropped_entries;
+  RecordCompaction(info);
+
   VersionSet::LevelSummaryStorage tmp;
   Log(options_.info_log,
       "compacted to: %s", versions_->LevelSummary(&tmp));
@@ -1702,6 +2102,12 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 Status DBImpl::Get(const ReadOptions& options,
                    const Slice& key,
                    std::string* value) {
+  return Get(options, key, value, SaveValueToString);
+}
+
+Status DBImpl::Get(const ReadOptions& options, const Slice& key,
+                   void* arg,
+                   void (*handle_value)(void* arg, const Slice& value)) {
   Status s;
   PROFILER_BEGIN("db mutex");
   MutexLock l(&mutex_);
@@ -1728,13 +2134,13 @@ Status DBImpl::Get(const ReadOptions& options,
     mutex_.Unlock();
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
+    if (mem->Get(lkey, arg, handle_value, &s)) {
       // Done
-    } else if (imm != NULL && imm->Get(lkey, value, &s)) {
+    } else if (imm != NULL && imm->Get(lkey, arg, handle_value, &s)) {
       // Done
     } else {
       PROFILER_BEGIN("db sst get");
-      s = current->Get(options, lkey, value, &stats);
+      s = current->Get(options, lkey, arg, handle_value, &stats);
       PROFILER_END();
       have_stat_update = true;
     }
@@ -1750,6 +2156,135 @@ Status DBImpl::Get(const ReadOptions& options,
   return s;
 }
 
+bool DBImpl::KeyMayExist(const ReadOptions& options,
+                         const Slice& key, std::string* value,
+                         bool* value_found) {
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != NULL) {
+    snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != NULL) imm->Ref();
+  current->Ref();
+
+  bool may_exist;
+  *value_found = false;
+  {
+    mutex_.Unlock();
+    LookupKey lkey(key, snapshot);
+    Status s;
+    if (mem->Get(lkey, value, &s) ||
+        (imm != NULL && imm->Get(lkey, value, &s))) {
+      // A deletion in a memtable hides the entries of the files
+      may_exist = *value_found = s.ok();
+    } else {
+      may_exist = current->KeyMayExist(lkey);
+    }
+    mutex_.Lock();
+  }
+
+  mem->Unref();
+  if (imm != NULL) imm->Unref();
+  current->Unref();
+  return may_exist;
+}
+
+namespace {
+// Orders the indexes of lookup keys by user key.
+struct LookupKeyLess {
+  const Comparator* ucmp;
+  const std::vector<LookupKey*>* keys;
+  LookupKeyLess(const Comparator* c, const std::vector<LookupKey*>* k)
+      : ucmp(c), keys(k) { }
+  bool operator()(size_t a, size_t b) const {
+    return ucmp->Compare((*keys)[a]->user_key(), (*keys)[b]->user_key()) < 0;
+  }
+};
+}  // namespace
+
+std::vector<Status> DBImpl::MultiGet(const ReadOptions& options,
+                                     const std::vector<Slice>& keys,
+                                     std::vector<std::string>* values) {
+  const size_t n = keys.size();
+  std::vector<Status> statuses(n);
+  values->resize(n);
+  if (n == 0) {
+    return statuses;
+  }
+
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != NULL) {
+    snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != NULL) imm->Ref();
+  current->Ref();
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    std::vector<LookupKey*> lkeys(n);
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+      lkeys[i] = new LookupKey(keys[i], snapshot);
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              LookupKeyLess(internal_comparator_.user_comparator(), &lkeys));
+
+    // Keys not in the memtables are looked up in the files together.
+    std::vector<size_t> file_order;
+    std::vector<const LookupKey*> file_keys;
+    std::vector<std::string*> file_values;
+    for (size_t i = 0; i < n; i++) {
+      const size_t k = order[i];
+      if (mem->Get(*lkeys[k], &(*values)[k], &statuses[k])) {
+        // Done
+      } else if (imm != NULL && imm->Get(*lkeys[k], &(*values)[k], &statuses[k])) {
+        // Done
+      } else {
+        file_order.push_back(k);
+        file_keys.push_back(lkeys[k]);
+        file_values.push_back(&(*values)[k]);
+      }
+    }
+    if (!file_keys.empty()) {
+      std::vector<Status> file_statuses(file_keys.size());
+      PROFILER_BEGIN("db sst multiget");
+      current->MultiGet(options, file_keys.size(), &file_keys[0],
+                        &file_values[0], &file_statuses[0]);
+      PROFILER_END();
+      for (size_t i = 0; i < file_keys.size(); i++) {
+        statuses[file_order[i]] = file_statuses[i];
+      }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      delete lkeys[i];
+    }
+    mutex_.Lock();
+  }
+
+  mem->Unref();
+  if (imm != NULL) imm->Unref();
+  current->Unref();
+  return statuses;
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot);
@@ -1760,16 +2295,20 @@ Iterator* DBImpl::NewIterator(const ReadOptions& options) {
        : latest_snapshot));
 }
 
+// snapshots_ has its own lock and the last sequence is loaded atomically,
+// so snapshots do not contend on mutex_.
 const Snapshot* DBImpl::GetSnapshot() {
-  MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
 }
 
 void DBImpl::ReleaseSnapshot(const Snapshot* s) {
-  MutexLock l(&mutex_);
   snapshots_.Delete(reinterpret_cast<const SnapshotImpl*>(s));
 }
 
+uint64_t DBImpl::GetLatestSequenceNumber() {
+  return versions_->LastSequence();
+}
+
 // Convenience methods
 Status DBImpl::Put(const WriteOptions& o, const Slice& key, const Slice& val, bool synced) {
   return DB::Put(o, key, val, synced);
@@ -1819,10 +2358,11 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
     // during this phase since &w is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
     // into mem_.
+    const Slice contents = WriteBatchInternal::Contents(updates);
     {
       mutex_.Unlock();
       PROFILER_BEGIN("db addrecord");
-      status = log_->AddRecord(WriteBatchInternal::Contents(updates));
+      status = log_->AddRecord(contents);
       if (status.ok() && options.sync) {
         status = logfile_->Sync();
       }
@@ -1837,12 +2377,20 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
     if (updates == tmp_batch_) tmp_batch_->Clear();
 
     versions_->SetLastSequence(last_sequence);
+    write_groups_++;
+    log_bytes_ += contents.size();
+    if (status.ok() && options.sync) {
+      log_syncs_++;
+    }
   }
 
   PROFILER_BEGIN("db lastwait");
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
+    if (ready->batch != NULL) {
+      write_group_batches_++;
+    }
     if (ready != &w) {
       ready->status = status;
       ready->done = true;
@@ -1923,7 +2471,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       break;
     } else if (
         allow_delay &&
-        versions_->NumLevelFiles(0) >= config::kL0_SlowdownWritesTrigger) {
+        versions_->NumLevelFiles(0) >= config_.kL0_SlowdownWritesTrigger) {
       // We are getting close to hitting a hard limit on the number of
       // L0 files.  Rather than delaying a single write by several
       // seconds when we hit the hard limit, start delaying each
@@ -1931,10 +2479,13 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
       Log(options_.info_log, "wait slow");
+      const uint64_t start_micros = env_->NowMicros();
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
+      stall_micros_ += env_->NowMicros() - start_micros;
+      write_slowdowns_++;
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
@@ -1943,13 +2494,19 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
       Log(options_.info_log, "wait imm ");
+      const uint64_t start_micros = env_->NowMicros();
       MaybeScheduleCompaction();
       bg_cv_.Wait();
+      stall_micros_ += env_->NowMicros() - start_micros;
+      write_stops_++;
       Log(options_.info_log, "wait imm over");
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) { // @ not stop
+    } else if (versions_->NumLevelFiles(0) >= config_.kL0_StopWritesTrigger) { // @ not stop
       // There are too many level-0 files.
       Log(options_.info_log, "waiting...\n");
+      const uint64_t start_micros = env_->NowMicros();
       bg_cv_.Wait();
+      stall_micros_ += env_->NowMicros() - start_micros;
+      write_stops_++;
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1971,7 +2528,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       log_ = new log::Writer(lfile);
       imm_ = mem_;
       has_imm_.Release_Store(imm_);
-      mem_ = new MemTable(internal_comparator_, env_);
+      mem_ = new MemTable(internal_comparator_, env_, config_.kArenaBlockSize);
       mem_->Ref();
       force = false;   // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -2040,6 +2597,21 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value,
       }
     }
     return true;
+  } else if (in == "write-groups") {
+    char buf[50];
+    snprintf(buf, sizeof(buf), "%lu", write_groups_);
+    value->append(buf);
+    return true;
+  } else if (in == "write-group-batches") {
+    char buf[50];
+    snprintf(buf, sizeof(buf), "%lu", write_group_batches_);
+    value->append(buf);
+    return true;
+  } else if (in == "log-syncs") {
+    char buf[50];
+    snprintf(buf, sizeof(buf), "%lu", log_syncs_);
+    value->append(buf);
+    return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
@@ -2076,6 +2648,102 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value,
   return false;
 }
 
+void DBImpl::GetStats(DBStats* stats) {
+  MutexLock l(&mutex_);
+  stats->write_groups = write_groups_;
+  stats->write_group_batches = write_group_batches_;
+  stats->log_bytes = log_bytes_;
+  stats->flush_bytes = flush_bytes_;
+  stats->compaction_bytes_read = compaction_bytes_read_;
+  stats->compaction_bytes_written = compaction_bytes_written_;
+  stats->bulk_load_bytes = bulk_load_bytes_;
+  stats->log_syncs = log_syncs_;
+  stats->table_syncs = table_syncs_;
+  stats->manifest_syncs = versions_->ManifestSyncs();
+  stats->stall_micros = stall_micros_;
+  stats->write_slowdowns = write_slowdowns_;
+  stats->write_stops = write_stops_;
+
+  // mem_ and the bucket memtables take writes, the others are flushed.
+  stats->memtables = 1 + bucket_map_.size();
+  stats->immutable_memtables = (imm_ != NULL ? 1 : 0) + imm_list_count_;
+  stats->memtable_bytes = mem_->ApproximateMemoryUsage();
+  if (imm_ != NULL) {
+    stats->memtable_bytes += imm_->ApproximateMemoryUsage();
+  }
+  for (BucketMap::const_iterator it = bucket_map_.begin();
+       it != bucket_map_.end(); ++it) {
+    stats->memtable_bytes += it->second->mem_->ApproximateMemoryUsage();
+  }
+  for (BucketList::const_iterator it = imm_list_.begin();
+       it != imm_list_.end(); ++it) {
+    stats->memtable_bytes += (*it)->mem_->ApproximateMemoryUsage();
+  }
+  stats->memtables += stats->immutable_memtables;
+
+  stats->level0_files = versions_->NumLevelFiles(0);
+  stats->table_files = 0;
+  stats->table_bytes = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    stats->table_files += versions_->NumLevelFiles(level);
+    stats->table_bytes += versions_->NumLevelBytes(level);
+  }
+}
+
+void DBImpl::GetFiles(std::vector<FileInfo>* files) {
+  Version* v;
+  {
+    MutexLock l(&mutex_);
+    v = versions_->current();
+    v->Ref();
+  }
+  files->clear();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& level_files = v->files(level);
+    for (size_t i = 0; i < level_files.size(); i++) {
+      const FileMetaData* f = level_files[i];
+      FileInfo info;
+      info.level = level;
+      info.number = f->number;
+      info.size = f->file_size;
+      info.num_entries = f->num_entries;
+      info.smallest = f->smallest.user_key().ToString();
+      info.largest = f->largest.user_key().ToString();
+      files->push_back(info);
+    }
+  }
+  {
+    MutexLock l(&mutex_);
+    v->Unref();
+  }
+}
+
+void DBImpl::RecordCompaction(const CompactionInfo& info) {
+  MutexLock l(&history_mutex_);
+  if (compaction_history_.size() >= kCompactionHistorySize) {
+    compaction_history_.pop_front();
+  }
+  compaction_history_.push_back(info);
+}
+
+void DBImpl::GetCompactionHistory(std::vector<CompactionInfo>* history) {
+  MutexLock l(&history_mutex_);
+  history->assign(compaction_history_.begin(), compaction_history_.end());
+}
+
+void DBImpl::GetLevelStats(std::vector<LevelInfo>* levels) {
+  MutexLock l(&mutex_);
+  levels->resize(config::kNumLevels);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    LevelInfo* info = &(*levels)[level];
+    info->files = versions_->NumLevelFiles(level);
+    info->bytes = versions_->NumLevelBytes(level);
+    info->micros = stats_[level].micros;
+    info->bytes_read = stats_[level].bytes_read;
+    info->bytes_written = stats_[level].bytes_written;
+  }
+}
+
 Status DBImpl::OpCmd(int cmd) {
   MutexLock l(&mutex_);
   Status s;
@@ -2089,6 +2757,38 @@ Status DBImpl::OpCmd(int cmd) {
   return s;
 }
 
+Status DBImpl::SetOptions(const Options& options) {
+  MutexLock l(&mutex_);
+  options_.write_buffer_size = options.write_buffer_size;
+  options_.max_mem_usage_for_memtable = options.max_mem_usage_for_memtable;
+  ClipToRange(&options_.write_buffer_size, 64<<10, 1<<30);
+  options_.kL0_CompactionTrigger = options.kL0_CompactionTrigger;
+  options_.kL0_SlowdownWritesTrigger = options.kL0_SlowdownWritesTrigger;
+  options_.kL0_StopWritesTrigger = options.kL0_StopWritesTrigger;
+  options_.kMaxMemCompactLevel = options.kMaxMemCompactLevel;
+  ClipToRange(&options_.kMaxMemCompactLevel, 0, config::kNumLevels - 1);
+  options_.kLimitCompactLevelCount = options.kLimitCompactLevelCount;
+  options_.kLimitCompactCountInterval = options.kLimitCompactCountInterval;
+  options_.kLimitCompactTimeInterval = options.kLimitCompactTimeInterval;
+  options_.kLimitCompactTimeStart = options.kLimitCompactTimeStart;
+  options_.kLimitCompactTimeEnd = options.kLimitCompactTimeEnd;
+  options_.kLimitDeleteObsoleteFileInterval =
+      options.kLimitDeleteObsoleteFileInterval;
+  options_.kDoSeekCompaction = options.kDoSeekCompaction;
+  config_.setDynamicConfig(options_);
+  Log(options_.info_log, "SetOptions: write_buffer_size %lld, "
+      "level-0 triggers %d/%d/%d",
+      static_cast<long long>(options_.write_buffer_size),
+      options_.kL0_CompactionTrigger, options_.kL0_SlowdownWritesTrigger,
+      options_.kL0_StopWritesTrigger);
+
+  // Writers waiting for room may now proceed, and a lower trigger may
+  // call for a compaction.
+  bg_cv_.SignalAll();
+  MaybeScheduleCompaction();
+  return Status::OK();
+}
+
 bool DBImpl::GetLevelRange(int level, std::string* smallest, std::string* largest) {
   MutexLock l(&mutex_);
   if (level < 0 || level > config::kNumLevels) {
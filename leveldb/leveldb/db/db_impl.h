@@ -9,6 +9,7 @@
 #include <list>
 #include <deque>
 #include <set>
+#include <vector>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
@@ -20,6 +21,7 @@ namespace leveldb {
 
 class MemTable;
 class TableCache;
+struct FileMetaData;
 class Version;
 class VersionEdit;
 class VersionSet;
@@ -55,16 +57,34 @@ class DBImpl : public DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key,
                      std::string* value);
+  virtual Status Get(const ReadOptions& options, const Slice& key,
+                     void* arg,
+                     void (*handle_value)(void* arg, const Slice& value));
+  virtual bool KeyMayExist(const ReadOptions& options,
+                           const Slice& key, std::string* value,
+                           bool* value_found);
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
   virtual Iterator* NewIterator(const ReadOptions&);
+  virtual BulkLoad* NewBulkLoad(const WriteOptions& options,
+                                size_t buffer_size, bool overwrite);
   virtual const Snapshot* GetSnapshot();
   virtual void ReleaseSnapshot(const Snapshot* snapshot);
+  virtual uint64_t GetLatestSequenceNumber();
   virtual bool GetProperty(const Slice& property, std::string* value,
                            void (*key_printer)(const Slice&, std::string&) = NULL);
+  virtual void GetStats(DBStats* stats);
+  virtual void GetFiles(std::vector<FileInfo>* files);
+  virtual void GetCompactionHistory(std::vector<CompactionInfo>* history);
+  virtual void GetLevelStats(std::vector<LevelInfo>* levels);
   virtual Status OpCmd(int cmd);
+  virtual Status SetOptions(const Options& options);
   virtual bool GetLevelRange(int level, std::string* smallest, std::string* largest);
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
   virtual void CompactRange(const Slice* begin, const Slice* end);
   virtual Status CompactRangeSelfLevel(uint64_t limit_filenumber, const Slice* begin, const Slice* end);
+  virtual Status DeleteFilesInRange(const Slice& begin, const Slice& end);
   virtual Status ForceCompactMemTable();
   virtual void ResetDbName(const std::string& dbname) { dbname_ = dbname; }
 
@@ -95,6 +115,7 @@ class DBImpl : public DB {
 
  private:
   friend class DB;
+  friend class BulkLoadImpl;
   struct CompactionState;
   struct Writer;
 
@@ -150,11 +171,27 @@ class DBImpl : public DB {
   void BackgroundCompactionSelfLevel();
   Status DoCompactionWorkSelfLevel(CompactionState* compact);
 
+  // bulk load support (see db/bulk_load.cc)
+  uint64_t NewPendingFileNumber();
+  void ReleasePendingFile(uint64_t number);
+  SequenceNumber ReserveSequence(uint64_t* next_file_number);
+  bool MemTablesOverlap(const Slice& smallest_user_key,
+                        const Slice& largest_user_key);
+  Status InstallBulkLoad(const std::vector<FileMetaData*>& files,
+                         uint64_t newer_file_number, int* level);
+  void BackgroundBulkLoad();
+  void BackgroundDeleteFiles();
+
   // Constant after construction
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
-  const Options options_;  // options_.comparator == &internal_comparator_
+  // options_.comparator == &internal_comparator_.  Only the fields that
+  // SetOptions() changes may be modified, with mutex_ held.
+  Options options_;
+  // Tuning derived from options_, shared with versions_.  Its dynamic
+  // fields change with options_.
+  config config_;
   bool owns_info_log_;
   bool owns_cache_;
   std::string dbname_;
@@ -220,8 +257,12 @@ class DBImpl : public DB {
     uint64_t limit_filenumber;  // just specified for special use
     BgCompactionFunc bg_compaction_func; // specified compaction function
     bool reschedule;            // whether re-schecheled other compaction when this compaction is completed
+    const std::vector<FileMetaData*>* bulk_files; // files to install by BackgroundBulkLoad()
+    uint64_t bulk_newer_files;  // first file number that may be newer than bulk_files
+    const Range* delete_range;  // range of BackgroundDeleteFiles()
     Status compaction_status;
-    ManualCompaction() : bg_compaction_func(NULL), reschedule(true) {}
+    ManualCompaction() : bg_compaction_func(NULL), reschedule(true), bulk_files(NULL),
+                         bulk_newer_files(0), delete_range(NULL) {}
   };
   ManualCompaction* manual_compaction_;
 
@@ -247,6 +288,33 @@ class DBImpl : public DB {
   };
   CompactionStats stats_[config::kNumLevels];
 
+  // Group commit stats: log writes, the batches they carried and the
+  // log syncs they needed.
+  uint64_t write_groups_;
+  uint64_t write_group_batches_;
+  uint64_t log_syncs_;
+
+  // Other counters reported by GetStats().  Bytes written to the log,
+  // by memtable flushes, by compactions and by bulk loads; syncs of new
+  // table files; time and number of writes delayed or stopped by
+  // MakeRoomForWrite().
+  uint64_t log_bytes_;
+  uint64_t flush_bytes_;
+  uint64_t compaction_bytes_read_;
+  uint64_t compaction_bytes_written_;
+  uint64_t bulk_load_bytes_;
+  uint64_t table_syncs_;
+  uint64_t stall_micros_;
+  uint64_t write_slowdowns_;
+  uint64_t write_stops_;
+
+  // The last jobs that wrote table files, oldest first, for
+  // GetCompactionHistory().  Guarded by history_mutex_ rather than
+  // mutex_ since flushes and compactions finish with or without mutex_.
+  port::Mutex history_mutex_;
+  std::deque<CompactionInfo> compaction_history_;
+  void RecordCompaction(const CompactionInfo& info);
+
   // No copying allowed
   DBImpl(const DBImpl&);
   void operator=(const DBImpl&);
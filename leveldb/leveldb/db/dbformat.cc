@@ -20,6 +20,10 @@ void AppendInternalKey(std::string* result, const ParsedInternalKey& key) {
   PutFixed64(result, PackSequenceAndType(key.sequence, key.type));
 }
 
+void SaveValueToString(void* arg, const Slice& value) {
+  reinterpret_cast<std::string*>(arg)->assign(value.data(), value.size());
+}
+
 std::string ParsedInternalKey::DebugString() const {
   char buf[50];
   snprintf(buf, sizeof(buf), "' @ %llu : %d",
@@ -184,6 +184,13 @@ inline bool ParseInternalKey(const Slice& internal_key,
   return (c <= static_cast<unsigned char>(kTypeValue));
 }
 
+// Receives the value found by a lookup, which is only valid during the
+// call, together with the "arg" passed to the lookup.
+typedef void (*ValueHandler)(void* arg, const Slice& value);
+
+// ValueHandler that stores the value in the std::string* "arg".
+extern void SaveValueToString(void* arg, const Slice& value);
+
 // A helper class useful for DBImpl::Get()
 class LookupKey {
  public:
@@ -0,0 +1,441 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// The index is a skiplist with one entry per updated key:
+//    key: varstring
+//    offset: fixed32, position of the latest record for key in rep_
+// An update of a key already in the index only rewrites its offset.
+
+#include "leveldb/indexed_write_batch.h"
+
+#include <new>
+#include <string.h>
+#include "leveldb/iterator.h"
+#include "db/dbformat.h"
+#include "db/skiplist.h"
+#include "db/write_batch_internal.h"
+#include "util/arena.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// WriteBatch header has an 8-byte sequence number followed by a 4-byte count.
+static const size_t kHeader = 12;
+
+namespace {
+
+Slice EntryKey(const char* data) {
+  uint32_t len;
+  const char* p = data;
+  p = GetVarint32Ptr(p, p + 5, &len);  // +5: we assume "p" is not corrupted
+  return Slice(p, len);
+}
+
+// Position of the record an index entry refers to.
+uint32_t EntryOffset(const char* entry) {
+  Slice key = EntryKey(entry);
+  return DecodeFixed32(key.data() + key.size());
+}
+
+const char* EncodeKey(std::string* scratch, const Slice& target) {
+  scratch->clear();
+  PutVarint32(scratch, target.size());
+  scratch->append(target.data(), target.size());
+  return scratch->data();
+}
+
+// The encoding of a key looked up in the index, on the stack unless the
+// key is long.
+class IndexKey {
+ public:
+  explicit IndexKey(const Slice& key) {
+    const size_t needed = VarintLength(key.size()) + key.size();
+    start_ = (needed <= sizeof(space_)) ? space_ : new char[needed];
+    char* dst = EncodeVarint32(start_, key.size());
+    memcpy(dst, key.data(), key.size());
+  }
+
+  ~IndexKey() {
+    if (start_ != space_) delete[] start_;
+  }
+
+  const char* data() const { return start_; }
+
+ private:
+  char* start_;
+  char space_[200];     // Avoid allocation for short keys
+
+  // No copying allowed
+  IndexKey(const IndexKey&);
+  void operator=(const IndexKey&);
+};
+
+// Decodes the record at "offset" of a batch representation and sets
+// *next to the offset of the following record.
+bool DecodeRecord(const Slice& rep, size_t offset, Slice* key,
+                  Slice* value, bool* deleted, size_t* next) {
+  Slice input(rep.data() + offset, rep.size() - offset);
+  if (input.empty()) {
+    return false;
+  }
+  char tag = OffSyncMask(input[0]);
+  input.remove_prefix(1);
+  if (!GetLengthPrefixedSlice(&input, key)) {
+    return false;
+  }
+  switch (tag) {
+    case kTypeValue:
+      *deleted = false;
+      if (!GetLengthPrefixedSlice(&input, value)) {
+        return false;
+      }
+      break;
+    case kTypeDeletion:
+      *deleted = true;
+      break;
+    case kTypeDeletionWithTailer:
+      *deleted = true;
+      if (!SkipLengthPrefixedSlice(&input)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  *next = input.data() - rep.data();
+  return true;
+}
+
+struct KeyComparator {
+  const Comparator* comparator;
+  explicit KeyComparator(const Comparator* c) : comparator(c) { }
+  int operator()(const char* a, const char* b) const {
+    return comparator->Compare(EntryKey(a), EntryKey(b));
+  }
+};
+
+typedef SkipList<const char*, KeyComparator> Index;
+
+// Merges the entries of an index over a base iterator.  Where both have
+// a key, the batch wins; keys deleted by the batch are skipped.
+class BaseDeltaIterator : public Iterator {
+ public:
+  BaseDeltaIterator(Iterator* base, const Index* index,
+                    const WriteBatch* batch, const Comparator* comparator)
+      : base_(base),
+        delta_(index),
+        batch_(batch),
+        comparator_(comparator),
+        forward_(true),
+        valid_(false),
+        current_at_base_(true),
+        equal_keys_(false) {
+  }
+
+  virtual ~BaseDeltaIterator() {
+    delete base_;
+  }
+
+  virtual bool Valid() const { return valid_; }
+
+  virtual void SeekToFirst() {
+    forward_ = true;
+    base_->SeekToFirst();
+    delta_.SeekToFirst();
+    UpdateCurrent();
+  }
+
+  virtual void SeekToLast() {
+    forward_ = false;
+    base_->SeekToLast();
+    delta_.SeekToLast();
+    UpdateCurrent();
+  }
+
+  virtual void Seek(const Slice& k) {
+    forward_ = true;
+    base_->Seek(k);
+    delta_.Seek(EncodeKey(&tmp_, k));
+    UpdateCurrent();
+  }
+
+  virtual void Next() {
+    assert(valid_);
+    if (!forward_) {
+      // Bring both children to or after the current key, which is then
+      // the current key again.
+      std::string current = key().ToString();
+      Seek(current);
+    }
+    Advance();
+  }
+
+  virtual void Prev() {
+    assert(valid_);
+    if (forward_) {
+      std::string current = key().ToString();
+      SeekBefore(current);
+    }
+    Advance();
+  }
+
+  virtual Slice key() const {
+    return current_at_base_ ? base_->key() : EntryKey(delta_.key());
+  }
+
+  virtual Slice value() const {
+    if (current_at_base_) {
+      return base_->value();
+    }
+    Slice key, value;
+    bool deleted;
+    size_t next;
+    DecodeRecord(WriteBatchInternal::Contents(batch_),
+                 EntryOffset(delta_.key()), &key, &value, &deleted, &next);
+    return value;
+  }
+
+  virtual Status status() const { return base_->status(); }
+
+ private:
+  // Positions both children at the last key <= k, going backward.
+  void SeekBefore(const Slice& k) {
+    forward_ = false;
+    base_->Seek(k);
+    if (!base_->Valid()) {
+      base_->SeekToLast();
+    } else if (comparator_->Compare(base_->key(), k) > 0) {
+      base_->Prev();
+    }
+    delta_.Seek(EncodeKey(&tmp_, k));
+    if (!delta_.Valid()) {
+      delta_.SeekToLast();
+    } else if (comparator_->Compare(EntryKey(delta_.key()), k) > 0) {
+      delta_.Prev();
+    }
+    UpdateCurrent();
+  }
+
+  void AdvanceBase() {
+    if (forward_) {
+      base_->Next();
+    } else {
+      base_->Prev();
+    }
+  }
+
+  void AdvanceDelta() {
+    if (forward_) {
+      delta_.Next();
+    } else {
+      delta_.Prev();
+    }
+  }
+
+  void Advance() {
+    if (equal_keys_) {
+      AdvanceBase();
+      AdvanceDelta();
+    } else if (current_at_base_) {
+      AdvanceBase();
+    } else {
+      AdvanceDelta();
+    }
+    UpdateCurrent();
+  }
+
+  // Picks the child holding the next key in the current direction,
+  // skipping the keys the batch deletes.
+  void UpdateCurrent() {
+    equal_keys_ = false;
+    while (true) {
+      if (!delta_.Valid()) {
+        current_at_base_ = true;
+        valid_ = base_->Valid();
+        return;
+      }
+
+      Slice key, value;
+      bool deleted;
+      size_t next;
+      if (!DecodeRecord(WriteBatchInternal::Contents(batch_),
+                        EntryOffset(delta_.key()),
+                        &key, &value, &deleted, &next)) {
+        AdvanceDelta();
+        continue;
+      }
+
+      int c = base_->Valid() ? comparator_->Compare(key, base_->key()) : -1;
+      if (!forward_) {
+        c = -c;
+      }
+      if (c > 0) {
+        current_at_base_ = true;
+        valid_ = true;
+        return;
+      }
+      if (deleted) {
+        if (c == 0) {
+          AdvanceBase();
+        }
+        AdvanceDelta();
+        continue;
+      }
+      equal_keys_ = (c == 0);
+      current_at_base_ = false;
+      valid_ = true;
+      return;
+    }
+  }
+
+  Iterator* base_;
+  Index::Iterator delta_;
+  const WriteBatch* batch_;
+  const Comparator* comparator_;
+  std::string tmp_;       // For passing to EncodeKey
+  bool forward_;
+  bool valid_;
+  bool current_at_base_;
+  bool equal_keys_;       // The batch overrides the current key of base_
+
+  // No copying allowed
+  BaseDeltaIterator(const BaseDeltaIterator&);
+  void operator=(const BaseDeltaIterator&);
+};
+
+}  // namespace
+
+// The index lives in the arena, so that a batch that is cleared and
+// filled again reuses its memory.
+struct IndexedWriteBatch::Rep {
+  KeyComparator comparator;
+  Arena arena;
+  Index* index;
+
+  explicit Rep(const Comparator* c)
+      : comparator(c),
+        index(NewIndex()) {
+  }
+
+  ~Rep() {
+    index->~Index();
+  }
+
+  Index* NewIndex() {
+    return new (arena.AllocateAligned(sizeof(Index))) Index(comparator,
+                                                            &arena);
+  }
+
+  void Reset() {
+    index->~Index();
+    arena.Reset();
+    index = NewIndex();
+  }
+};
+
+IndexedWriteBatch::IndexedWriteBatch(const Comparator* comparator)
+    : rep_(new Rep(comparator)) {
+}
+
+IndexedWriteBatch::~IndexedWriteBatch() {
+  delete rep_;
+}
+
+void IndexedWriteBatch::AddToIndex(const Slice& key, size_t offset) {
+  IndexKey encoded(key);
+  Index::Iterator iter(rep_->index);
+  iter.Seek(encoded.data());
+  if (iter.Valid() &&
+      rep_->comparator.comparator->Compare(EntryKey(iter.key()),
+                                           key) == 0) {
+    // Entries are ordered by key only, so the offset can change in place.
+    Slice entry_key = EntryKey(iter.key());
+    EncodeFixed32(const_cast<char*>(entry_key.data() + entry_key.size()),
+                  static_cast<uint32_t>(offset));
+    return;
+  }
+
+  const size_t encoded_len = VarintLength(key.size()) + key.size() + 4;
+  char* buf = rep_->arena.Allocate(encoded_len);
+  char* p = EncodeVarint32(buf, key.size());
+  memcpy(p, key.data(), key.size());
+  p += key.size();
+  EncodeFixed32(p, static_cast<uint32_t>(offset));
+  rep_->index->Insert(buf);
+}
+
+void IndexedWriteBatch::Put(const Slice& key, const Slice& value) {
+  size_t offset = batch_.ApproximateSize();
+  batch_.Put(key, value);
+  AddToIndex(key, offset);
+}
+
+void IndexedWriteBatch::Delete(const Slice& key) {
+  size_t offset = batch_.ApproximateSize();
+  batch_.Delete(key);
+  AddToIndex(key, offset);
+}
+
+void IndexedWriteBatch::Clear() {
+  if (batch_.Count() == 0) {
+    return;               // Nothing to forget, e.g. after a read-only statement
+  }
+  batch_.Clear();
+  rep_->Reset();
+}
+
+void IndexedWriteBatch::RollbackTo(size_t size, int count) {
+  batch_.RollbackTo(size, count);
+
+  // Rollbacks are rare (failed statements, savepoints): re-index the
+  // records that are left.
+  rep_->Reset();
+  Slice rep = WriteBatchInternal::Contents(&batch_);
+  Slice key, value;
+  bool deleted;
+  size_t offset = kHeader;
+  size_t next;
+  while (offset < rep.size() &&
+         DecodeRecord(rep, offset, &key, &value, &deleted, &next)) {
+    AddToIndex(key, offset);
+    offset = next;
+  }
+}
+
+bool IndexedWriteBatch::Get(const Slice& key, std::string* value,
+                            bool* deleted) const {
+  Slice record_value;
+  if (!Get(key, &record_value, deleted)) {
+    return false;
+  }
+  if (!*deleted) {
+    value->assign(record_value.data(), record_value.size());
+  }
+  return true;
+}
+
+bool IndexedWriteBatch::Get(const Slice& key, Slice* value,
+                            bool* deleted) const {
+  IndexKey encoded(key);
+  Index::Iterator iter(rep_->index);
+  iter.Seek(encoded.data());
+  if (!iter.Valid() ||
+      rep_->comparator.comparator->Compare(EntryKey(iter.key()),
+                                           key) != 0) {
+    return false;
+  }
+
+  Slice record_key;
+  size_t next;
+  return DecodeRecord(WriteBatchInternal::Contents(&batch_),
+                      EntryOffset(iter.key()),
+                      &record_key, value, deleted, &next);
+}
+
+Iterator* IndexedWriteBatch::NewIteratorWithBase(Iterator* base) const {
+  return new BaseDeltaIterator(base, rep_->index, &batch_,
+                               rep_->comparator.comparator);
+}
+
+}  // namespace leveldb
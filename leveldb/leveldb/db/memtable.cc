@@ -18,9 +18,11 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& cmp, Env* env)
+MemTable::MemTable(const InternalKeyComparator& cmp, Env* env,
+                   size_t arena_block_size)
     : comparator_(cmp),
       refs_(0),
+      arena_(arena_block_size),
       table_(comparator_, &arena_),
       env_(env) {
 }
@@ -106,7 +108,8 @@ void MemTable::Add(SequenceNumber s, ValueType type,
   table_.Insert(buf);
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, void* arg, ValueHandler handle_value,
+                   Status* s) {
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
@@ -136,7 +139,7 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
             return true;
           } else {
             Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-            value->assign(v.data(), v.size());
+            (*handle_value)(arg, v);
             return true;
           }
         }
@@ -20,8 +20,10 @@ class MemTableIterator;
 class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
-  // is zero and the caller must call Ref() at least once.
-  explicit MemTable(const InternalKeyComparator& comparator, Env* env);
+  // is zero and the caller must call Ref() at least once.  Memory is
+  // allocated in blocks of "arena_block_size" bytes.
+  MemTable(const InternalKeyComparator& comparator, Env* env,
+           size_t arena_block_size);
 
   // Increase reference count.
   void Ref() { ++refs_; }
@@ -61,7 +63,13 @@ class MemTable {
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  bool Get(const LookupKey& key, std::string* value, Status* s) {
+    return Get(key, value, SaveValueToString, s);
+  }
+
+  // Same as above, but a value is passed to (*handle_value)(arg, value).
+  bool Get(const LookupKey& key, void* arg, ValueHandler handle_value,
+           Status* s);
 
  private:
   ~MemTable();  // Private since only Unref() should be used to delete it
@@ -5,18 +5,23 @@
 #ifndef STORAGE_LEVELDB_DB_SNAPSHOT_H_
 #define STORAGE_LEVELDB_DB_SNAPSHOT_H_
 
+#include "db/dbformat.h"
 #include "leveldb/db.h"
+#include "port/port.h"
 
 namespace leveldb {
 
 class SnapshotList;
 
 // Snapshots are kept in a doubly-linked list in the DB.
-// Each SnapshotImpl corresponds to a particular sequence number.
+// Each SnapshotImpl corresponds to a particular sequence number and is
+// shared by all the GetSnapshot() calls that got that number.
 class SnapshotImpl : public Snapshot {
  public:
   SequenceNumber number_;  // const after creation
 
+  virtual uint64_t sequence() const { return number_; }
+
  private:
   friend class SnapshotList;
 
@@ -24,41 +29,88 @@ class SnapshotImpl : public Snapshot {
   SnapshotImpl* prev_;
   SnapshotImpl* next_;
 
+  int refs_;                           // Protected by list_->mu_
   SnapshotList* list_;                 // just for sanity checks
 };
 
+// Thread-safe: the list has its own mutex, so taking and releasing a
+// snapshot never waits for the DB mutex.
 class SnapshotList {
  public:
-  SnapshotList() {
+  SnapshotList() : floor_(0) {
     list_.prev_ = &list_;
     list_.next_ = &list_;
   }
 
   bool empty() const { return list_.next_ == &list_; }
-  SnapshotImpl* oldest() const { assert(!empty()); return list_.next_; }
-  SnapshotImpl* newest() const { assert(!empty()); return list_.prev_; }
 
+  // Returns a snapshot at seq or later.  A newer snapshot may be returned
+  // since every sequence up to it was already published when seq was
+  // read; this keeps the list sorted and lets the reads made between two
+  // writes share one snapshot.
   const SnapshotImpl* New(SequenceNumber seq) {
-    SnapshotImpl* s = new SnapshotImpl;
-    s->number_ = seq;
-    s->list_ = this;
-    s->next_ = &list_;
-    s->prev_ = list_.prev_;
-    s->prev_->next_ = s;
-    s->next_->prev_ = s;
+    mu_.Lock();
+    if (seq < floor_) {
+      seq = floor_;
+    }
+    SnapshotImpl* s = list_.prev_;
+    if (s != &list_ && s->number_ >= seq) {
+      s->refs_++;
+    } else {
+      s = new SnapshotImpl;
+      s->number_ = seq;
+      s->refs_ = 1;
+      s->list_ = this;
+      s->next_ = &list_;
+      s->prev_ = list_.prev_;
+      s->prev_->next_ = s;
+      s->next_->prev_ = s;
+    }
+    mu_.Unlock();
     return s;
   }
 
-  void Delete(const SnapshotImpl* s) {
-    assert(s->list_ == this);
-    s->prev_->next_ = s->next_;
-    s->next_->prev_ = s->prev_;
-    delete s;
+  void Delete(const SnapshotImpl* snapshot) {
+    assert(snapshot->list_ == this);
+    SnapshotImpl* s = const_cast<SnapshotImpl*>(snapshot);
+    mu_.Lock();
+    assert(s->refs_ > 0);
+    const bool last = --s->refs_ == 0;
+    if (last) {
+      s->prev_->next_ = s->next_;
+      s->next_->prev_ = s->prev_;
+    }
+    mu_.Unlock();
+    if (last) {
+      delete s;
+    }
+  }
+
+  // Returns the sequence number of the oldest snapshot, or if_empty if
+  // there is none.  No later snapshot is older than the returned number.
+  SequenceNumber OldestSequence(SequenceNumber if_empty) {
+    mu_.Lock();
+    SequenceNumber seq = empty() ? if_empty : list_.next_->number_;
+    if (seq > floor_) {
+      floor_ = seq;
+    }
+    mu_.Unlock();
+    return seq;
   }
 
  private:
+  port::Mutex mu_;
+
+  // Oldest sequence a new snapshot may get: a compaction may already have
+  // dropped the entries only older snapshots would see.
+  SequenceNumber floor_;
+
   // Dummy head of doubly-linked list of snapshots
   SnapshotImpl list_;
+
+  // No copying allowed
+  SnapshotList(const SnapshotList&);
+  void operator=(const SnapshotList&);
 };
 
 }  // namespace leveldb
@@ -44,6 +44,23 @@ class TableCache {
              void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Same as Get() for the n sorted keys of "keys", with "args[i]" for
+  // "keys[i]", looking the table up once.
+  Status MultiGet(const ReadOptions& options,
+                  uint64_t file_number,
+                  uint64_t file_size,
+                  int n,
+                  const Slice* keys,
+                  void* const* args,
+                  void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Stores in *may_match whether the specified file may hold an entry
+  // for internal key "k", consulting only its index and filter.
+  Status KeyMayMatch(uint64_t file_number,
+                     uint64_t file_size,
+                     const Slice& k,
+                     bool* may_match);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
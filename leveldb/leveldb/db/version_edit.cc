@@ -20,7 +20,9 @@ enum Tag {
   kDeletedFile          = 6,
   kNewFile              = 7,
   // 8 was used for large value refs
-  kPrevLogNumber        = 9
+  kPrevLogNumber        = 9,
+  // Entry count of a file added by a preceding kNewFile
+  kNewFileEntries       = 10
 };
 
 void VersionEdit::Clear() {
@@ -82,6 +84,12 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.num_entries > 0) {
+      PutVarint32(dst, kNewFileEntries);
+      PutVarint32(dst, new_files_[i].first);  // level
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.num_entries);
+    }
   }
 }
 
@@ -186,12 +194,26 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
             GetInternalKey(&input, &f.largest)) {
+          f.num_entries = 0;
           new_files_.push_back(std::make_pair(level, f));
         } else {
           msg = "new-file entry";
         }
         break;
 
+      case kNewFileEntries:
+        if (GetLevel(&input, &level) &&
+            GetVarint64(&input, &number) &&
+            GetVarint64(&input, &f.num_entries) &&
+            !new_files_.empty() &&
+            new_files_.back().first == level &&
+            new_files_.back().second.number == number) {
+          new_files_.back().second.num_entries = f.num_entries;
+        } else {
+          msg = "new-file entry count";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -254,6 +276,10 @@ std::string VersionEdit::DebugString() const {
     AppendNumberTo(&r, f.number);
     r.append(" ");
     AppendNumberTo(&r, f.file_size);
+    if (f.num_entries > 0) {
+      r.append(" entries=");
+      AppendNumberTo(&r, f.num_entries);
+    }
     r.append(" ");
     r.append(f.smallest.DebugString());
     r.append(" .. ");
@@ -23,12 +23,14 @@ namespace leveldb {
 // Maximum number of bytes in all compacted files.  We avoid expanding
 // the lower level file set of a compaction if it would make the
 // total compaction cover more than this many bytes.
-static const int64_t kExpandedCompactionByteSizeLimit = 25 * config::kTargetFileSize;
+static int64_t ExpandedCompactionByteSizeLimit(const config* config) {
+  return 25 * static_cast<int64_t>(config->kTargetFileSize);
+}
 
-static double MaxBytesForLevel(int level) {
+static double MaxBytesForLevel(const config* config, int level) {
   // Note: the result for level zero is not really used since we set
   // the level-0 compaction threshold based on number of files.
-  double result = config::kBaseLevelSize * 1.0;  // Result for both level-0 and level-1
+  double result = config->kBaseLevelSize * 1.0;  // Result for both level-0 and level-1
   while (level > 1) {
     result *= 10;
     level--;
@@ -36,8 +38,8 @@ static double MaxBytesForLevel(int level) {
   return result;
 }
 
-static uint64_t MaxFileSizeForLevel(int level) {
-  return config::kTargetFileSize;  // We could vary per level to reduce number of files?
+static uint64_t MaxFileSizeForLevel(const config* config, int level) {
+  return config->kTargetFileSize;  // We could vary per level to reduce number of files?
 }
 
 static int64_t TotalFileSize(const std::vector<FileMetaData*>& files) {
@@ -261,7 +263,8 @@ struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
-  std::string* value;
+  void* arg;
+  ValueHandler handle_value;
 };
 }
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -278,7 +281,7 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
           s->state = kDropped;
         } else {
           s->state = kFound;
-          s->value->assign(v.data(), v.size());
+          (*s->handle_value)(s->arg, v);
         }
       } else {
         s->state = kDeleted;
@@ -293,7 +296,8 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
 
 Status Version::Get(const ReadOptions& options,
                     const LookupKey& k,
-                    std::string* value,
+                    void* arg,
+                    ValueHandler handle_value,
                     GetStats* stats) {
   Slice ikey = k.internal_key();
   Slice user_key = k.user_key();
@@ -308,7 +312,8 @@ Status Version::Get(const ReadOptions& options,
   // We can search level-by-level since entries never hop across
   // levels.  Therefore we are guaranteed that if we find data
   // in an smaller level, later levels are irrelevant.
-  std::vector<FileMetaData*> tmp;
+  FileMetaData* tmp_space[32];   // Avoid allocation for a usual level-0
+  std::vector<FileMetaData*> tmp_heap;
   FileMetaData* tmp2;
   for (int level = 0; level < config::kNumLevels; level++) {
     size_t num_files = files_[level].size();
@@ -320,19 +325,24 @@ Status Version::Get(const ReadOptions& options,
       PROFILER_BEGIN("db l0");
       // Level-0 files may overlap each other.  Find all files that
       // overlap user_key and process them in order from newest to oldest.
-      tmp.reserve(num_files);
+      FileMetaData** tmp = tmp_space;
+      if (num_files > sizeof(tmp_space) / sizeof(tmp_space[0])) {
+        tmp_heap.resize(num_files);
+        tmp = &tmp_heap[0];
+      }
+      size_t num_tmp = 0;
       for (uint32_t i = 0; i < num_files; i++) {
         FileMetaData* f = files[i];
         if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
             ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
-          tmp.push_back(f);
+          tmp[num_tmp++] = f;
         }
       }
-      if (tmp.empty()) continue;
+      if (num_tmp == 0) continue;
 
-      std::sort(tmp.begin(), tmp.end(), NewestFirst);
-      files = &tmp[0];
-      num_files = tmp.size();
+      std::sort(tmp, tmp + num_tmp, NewestFirst);
+      files = tmp;
+      num_files = num_tmp;
     } else {
       PROFILER_BEGIN("db lN");
       // Binary search to find earliest index whose largest key >= ikey.
@@ -370,7 +380,8 @@ Status Version::Get(const ReadOptions& options,
       saver.state = kNotFound;
       saver.ucmp = ucmp;
       saver.user_key = user_key;
-      saver.value = value;
+      saver.arg = arg;
+      saver.handle_value = handle_value;
       s = vset_->table_cache_->Get(options, f->number, f->file_size,
                                    ikey, &saver, SaveValue);
       if (!s.ok()) {
@@ -396,9 +407,167 @@ Status Version::Get(const ReadOptions& options,
   return Status::NotFound(Slice());  // Use an empty error message for speed
 }
 
+bool Version::KeyMayExist(const LookupKey& k) {
+  Slice ikey = k.internal_key();
+  Slice user_key = k.user_key();
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    size_t begin = 0;
+    size_t end = files.size();
+    if (level > 0) {
+      // At most one file of the level may hold the key
+      begin = FindFile(vset_->icmp_, files, ikey);
+      end = std::min(begin + 1, end);
+    }
+    for (size_t i = begin; i < end; i++) {
+      FileMetaData* f = files[i];
+      if (ucmp->Compare(user_key, f->smallest.user_key()) < 0 ||
+          ucmp->Compare(user_key, f->largest.user_key()) > 0) {
+        continue;
+      }
+      bool may_match = true;
+      Status s = vset_->table_cache_->KeyMayMatch(f->number, f->file_size,
+                                                  ikey, &may_match);
+      if (!s.ok() || may_match) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Searches file "f" for the keys of "group", whose lookups are in
+// "savers"; a failed search ends the lookups of the group.
+static void MultiGetFromFile(TableCache* table_cache,
+                             const ReadOptions& options, FileMetaData* f,
+                             const std::vector<int>& group,
+                             const LookupKey* const* keys,
+                             Saver* savers, Status* statuses) {
+  if (group.empty()) {
+    return;
+  }
+  std::vector<Slice> ikeys;
+  std::vector<void*> args;
+  for (size_t i = 0; i < group.size(); i++) {
+    ikeys.push_back(keys[group[i]]->internal_key());
+    args.push_back(&savers[group[i]]);
+  }
+  Status s = table_cache->MultiGet(options, f->number, f->file_size,
+                                   group.size(), &ikeys[0], &args[0],
+                                   SaveValue);
+  if (!s.ok()) {
+    for (size_t i = 0; i < group.size(); i++) {
+      statuses[group[i]] = s;
+    }
+  }
+}
+
+// Removes the keys whose lookup is over from "pending".
+static void DropResolved(std::vector<int>* pending, const Saver* savers,
+                         const Status* statuses) {
+  size_t kept = 0;
+  for (size_t i = 0; i < pending->size(); i++) {
+    const int k = (*pending)[i];
+    if (savers[k].state == kNotFound && statuses[k].ok()) {
+      (*pending)[kept++] = k;
+    }
+  }
+  pending->resize(kept);
+}
+
+void Version::MultiGet(const ReadOptions& options, int n,
+                       const LookupKey* const* keys,
+                       std::string* const* vals, Status* statuses) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  std::vector<Saver> savers(n);
+  std::vector<int> pending;     // Keys still searched for, in order
+  for (int i = 0; i < n; i++) {
+    savers[i].state = kNotFound;
+    savers[i].ucmp = ucmp;
+    savers[i].user_key = keys[i]->user_key();
+    savers[i].arg = vals[i];
+    savers[i].handle_value = SaveValueToString;
+    statuses[i] = Status::OK();
+    pending.push_back(i);
+  }
+
+  // As in Get(), a key found in a level is not searched for in the
+  // later levels.
+  std::vector<int> group;
+  for (int level = 0; level < config::kNumLevels && !pending.empty(); level++) {
+    size_t num_files = files_[level].size();
+    if (num_files == 0) continue;
+
+    if (level == 0) {
+      // Search the overlapping files from newest to oldest, dropping the
+      // keys found by each one.
+      std::vector<FileMetaData*> tmp(files_[level]);
+      std::sort(tmp.begin(), tmp.end(), NewestFirst);
+      for (size_t i = 0; i < tmp.size() && !pending.empty(); i++) {
+        FileMetaData* f = tmp[i];
+        group.clear();
+        for (size_t p = 0; p < pending.size(); p++) {
+          const Slice user_key = savers[pending[p]].user_key;
+          if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+              ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+            group.push_back(pending[p]);
+          }
+        }
+        MultiGetFromFile(vset_->table_cache_, options, f, group, keys,
+                         &savers[0], statuses);
+        DropResolved(&pending, &savers[0], statuses);
+      }
+    } else {
+      // Consecutive keys in the range of the same file form one group.
+      size_t p = 0;
+      while (p < pending.size()) {
+        uint32_t index = FindFile(vset_->icmp_, files_[level],
+                                  keys[pending[p]]->internal_key());
+        if (index >= num_files) {
+          break;                // The remaining keys are past the level
+        }
+        FileMetaData* f = files_[level][index];
+        group.clear();
+        while (p < pending.size() &&
+               vset_->icmp_.Compare(keys[pending[p]]->internal_key(),
+                                    f->largest.Encode()) <= 0) {
+          if (ucmp->Compare(savers[pending[p]].user_key,
+                            f->smallest.user_key()) >= 0) {
+            group.push_back(pending[p]);
+          }
+          p++;
+        }
+        MultiGetFromFile(vset_->table_cache_, options, f, group, keys,
+                         &savers[0], statuses);
+      }
+      DropResolved(&pending, &savers[0], statuses);
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (!statuses[i].ok()) {
+      continue;
+    }
+    switch (savers[i].state) {
+      case kFound:
+        break;
+      case kNotFound:
+      case kDeleted:
+      case kDropped:
+        statuses[i] = Status::NotFound(Slice());
+        break;
+      case kCorrupt:
+        statuses[i] = Status::Corruption("corrupted key for ", savers[i].user_key);
+        break;
+    }
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   // ignore seek compaction
-  if (!config::kDoSeekCompaction) {
+  if (!vset_->config_->kDoSeekCompaction) {
     return false;
   }
 
@@ -476,13 +645,14 @@ int Version::PickLevelForMemTableOutput(
     InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
-    while (level < config::kMaxMemCompactLevel) {
+    const config* config = vset_->config_;
+    while (level < config->kMaxMemCompactLevel) {
       if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
         break;
       }
       GetOverlappingInputs(level + 2, &start, &limit, &overlaps);
       const int64_t sum = TotalFileSize(overlaps);
-      if (sum > config::kMaxGrandParentOverlapBytes) {
+      if (sum > config->kMaxGrandParentOverlapBytes) {
         break;
       }
       level++;
@@ -770,11 +940,13 @@ class VersionSet::Builder {
 const char* VersionSet::kBackupVersionDir = "backupversions";
 VersionSet::VersionSet(const std::string& dbname,
                        const Options* options,
+                       const config* config,
                        TableCache* table_cache,
                        const InternalKeyComparator* cmp)
     : env_(options->env),
       dbname_(dbname),
       options_(options),
+      config_(config),
       table_cache_(table_cache),
       icmp_(*cmp),
       next_file_number_(2),
@@ -788,7 +960,8 @@ VersionSet::VersionSet(const std::string& dbname,
       descriptor_file_(NULL),
       descriptor_log_(NULL),
       dummy_versions_(this),
-      current_(NULL) {
+      current_(NULL),
+      manifest_syncs_(0) {
   AppendVersion(new Version(this));
 }
 
@@ -892,6 +1065,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     // we only need lock here to update current_/dummy_versions list
     mu->Lock();
     AppendVersion(v);
+    manifest_syncs_++;
     log_number_ = edit->log_number_;
     prev_log_number_ = edit->prev_log_number_;
     mu->Unlock();
@@ -1166,11 +1340,11 @@ void VersionSet::Finalize(Version* v) {
       // (3) @ we should give level-0 the highest priority
       // if file count in level-0 is over kL0_CompactionTrigger.
       score = v->files_[level].size() /
-          static_cast<double>(config::kL0_CompactionTrigger);
+          static_cast<double>(config_->kL0_CompactionTrigger);
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score = static_cast<double>(level_bytes) / MaxBytesForLevel(level);
+      score = static_cast<double>(level_bytes) / MaxBytesForLevel(config_, level);
     }
 
     if (score > best_score) {
@@ -1178,7 +1352,7 @@ void VersionSet::Finalize(Version* v) {
         if (ShouldLimitCompact(level)) {
           Log(options_->info_log, "limit com %ld@%d", has_limited_compact_count_, level);
           break;                // following level need no check because we will limit it.
-        } else if (level > current_max_level_ - config::kLimitCompactLevelCount) { // higher level need no check
+        } else if (level > current_max_level_ - config_->kLimitCompactLevelCount) { // higher level need no check
           need_limit_compact = false;
         }
       }
@@ -1206,16 +1380,16 @@ bool VersionSet::ShouldLimitCompact(int level) {
 }
 
 bool VersionSet::LimitCompactByLevel(int level) {
-  return config::kLimitCompactLevelCount > 0 && // has configged to limit compact and
-    level > current_max_level_ - config::kLimitCompactLevelCount && // this level should be limited
-    config::IsLimitCompactTime();                                 // in specified time.
+  return config_->kLimitCompactLevelCount > 0 && // has configged to limit compact and
+    level > current_max_level_ - config_->kLimitCompactLevelCount && // this level should be limited
+    config_->IsLimitCompactTime();                                 // in specified time.
 }
 
 bool VersionSet::LimitCompactByInterval() {
-  bool limit = (0 == config::kLimitCompactCountInterval || 0 == config::kLimitCompactTimeInterval) || // limit always Or
-    (has_limited_compact_count_ < config::kLimitCompactCountInterval) || // limit count not over Or
+  bool limit = (0 == config_->kLimitCompactCountInterval || 0 == config_->kLimitCompactTimeInterval) || // limit always Or
+    (has_limited_compact_count_ < config_->kLimitCompactCountInterval) || // limit count not over Or
     (0 == first_limited_compact_time_ ||                                 // has not limited Or
-     static_cast<int32_t>(env_->NowSecs() - first_limited_compact_time_) < config::kLimitCompactTimeInterval); // limit time not over
+     static_cast<int32_t>(env_->NowSecs() - first_limited_compact_time_) < config_->kLimitCompactTimeInterval); // limit time not over
 
   if (limit) {
     ++has_limited_compact_count_;
@@ -1250,7 +1424,8 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                   f->num_entries);
     }
   }
 
@@ -1461,7 +1636,7 @@ Compaction* VersionSet::PickCompaction() {
     level = current_->compaction_level_;
     assert(level >= 0);
     assert(level+1 < config::kNumLevels);
-    c = new Compaction(level);
+    c = new Compaction(config_, level);
 
     PROFILER_BEGIN("pick first+");
     // Pick the first file that comes after compact_pointer_[level]
@@ -1480,7 +1655,7 @@ Compaction* VersionSet::PickCompaction() {
     }
   } else if (seek_compaction) {
     level = current_->file_to_compact_level_;
-    c = new Compaction(level);
+    c = new Compaction(config_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
     Log(options_->info_log, "seek com");
   } else {
@@ -1530,7 +1705,7 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
     const int64_t inputs1_size = TotalFileSize(c->inputs_[1]);
     const int64_t expanded0_size = TotalFileSize(expanded0);
     if (expanded0.size() > c->inputs_[0].size() &&
-        inputs1_size + expanded0_size < kExpandedCompactionByteSizeLimit) {
+        inputs1_size + expanded0_size < ExpandedCompactionByteSizeLimit(config_)) {
       InternalKey new_start, new_limit;
       GetRange(expanded0, &new_start, &new_limit);
       std::vector<FileMetaData*> expanded1;
@@ -1588,7 +1763,7 @@ Compaction* VersionSet::CompactRange(
   }
 
   // Avoid compacting too much in one shot in case the range is large.
-  const uint64_t limit = MaxFileSizeForLevel(level);
+  const uint64_t limit = MaxFileSizeForLevel(config_, level);
   uint64_t total = 0;
   for (size_t i = 0; i < inputs.size(); i++) {
     uint64_t s = inputs[i]->file_size;
@@ -1599,7 +1774,7 @@ Compaction* VersionSet::CompactRange(
     }
   }
 
-  Compaction* c = new Compaction(level);
+  Compaction* c = new Compaction(config_, level);
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
@@ -1614,13 +1789,13 @@ Compaction* VersionSet::CompactRangeOneLevel(
     const InternalKey* begin,
     const InternalKey* end) {
   std::vector<FileMetaData*> inputs;
-  const uint64_t limit_filesize = MaxFileSizeForLevel(level) * 4;
+  const uint64_t limit_filesize = MaxFileSizeForLevel(config_, level) * 4;
   current_->GetOverlappingInputsOneLevel(level, limit_filenumber, limit_filesize, begin, end, &inputs);
   if (inputs.empty()) {
     return NULL;
   }
 
-  Compaction* c = new Compaction(level);
+  Compaction* c = new Compaction(config_, level);
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
@@ -1670,9 +1845,10 @@ void Version::GetOverlappingInputsOneLevel(
 //////////////////////////////
 
 
-Compaction::Compaction(int level)
+Compaction::Compaction(const config* config, int level)
     : level_(level),
-      max_output_file_size_(MaxFileSizeForLevel(level)),
+      max_output_file_size_(MaxFileSizeForLevel(config, level)),
+      max_grandparent_overlap_bytes_(config->kMaxGrandParentOverlapBytes),
       input_version_(NULL),
       grandparent_index_(0),
       seen_key_(false),
@@ -1694,7 +1870,7 @@ bool Compaction::IsTrivialMove() const {
   // a very expensive merge later on.
   return (num_input_files(0) == 1 &&
           num_input_files(1) == 0 &&
-          TotalFileSize(grandparents_) <= config::kMaxGrandParentOverlapBytes);
+          TotalFileSize(grandparents_) <= max_grandparent_overlap_bytes_);
 }
 
 void Compaction::AddInputDeletions(VersionEdit* edit) {
@@ -1739,7 +1915,7 @@ bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   }
   seen_key_ = true;
 
-  if (overlapped_bytes_ > config::kMaxGrandParentOverlapBytes) {
+  if (overlapped_bytes_ > max_grandparent_overlap_bytes_) {
     // Too much overlap for current output; start new output
     overlapped_bytes_ = 0;
     return true;
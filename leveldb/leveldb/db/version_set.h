@@ -63,15 +63,28 @@ class Version {
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
-  // Lookup the value for key.  If found, store it in *val and
-  // return OK.  Else return a non-OK status.  Fills *stats.
+  // Lookup the value for key.  If found, pass it to
+  // (*handle_value)(arg, value) and return OK.  Else return a non-OK
+  // status.  Fills *stats.
   // REQUIRES: lock is not held
   struct GetStats {
     FileMetaData* seek_file;
     int seek_file_level;
   };
-  Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+  Status Get(const ReadOptions&, const LookupKey& key, void* arg,
+             ValueHandler handle_value, GetStats* stats);
+
+  // Returns false if no file of this Version can hold an entry for key,
+  // judging by the key ranges and the filters of the files only.
+  // REQUIRES: lock is not held
+  bool KeyMayExist(const LookupKey& key);
+
+  // Same as Get() for each of the n keys of "keys", which must be sorted,
+  // storing the result for keys[i] in *vals[i] and statuses[i].  A file
+  // is searched once for all the keys it may hold.  Seeks are not charged.
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, int n, const LookupKey* const* keys,
+                std::string* const* vals, Status* statuses);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -112,6 +125,11 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // The files of "level", sorted by key except at level-0.
+  const std::vector<FileMetaData*>& files(int level) const {
+    return files_[level];
+  }
+
   // return smallest and largest key in level
   bool Range(int level, std::string* smallest, std::string* largest);
 
@@ -171,6 +189,7 @@ class VersionSet {
  public:
   VersionSet(const std::string& dbname,
              const Options* options,
+             const config* config,
              TableCache* table_cache,
              const InternalKeyComparator*);
   ~VersionSet();
@@ -218,15 +237,20 @@ class VersionSet {
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
-  // Return the last sequence number.
+  // Return the number of syncs of the descriptor by LogAndApply().
+  uint64_t ManifestSyncs() const { return manifest_syncs_; }
+
+  // Return the last sequence number.  May be called without the DB
+  // mutex: the entries of every sequence up to the result are visible.
   // uint64_t LastSequence() const { return last_sequence_; }
-  uint64_t LastSequence() const { return last_sequence_.Get(); }
+  uint64_t LastSequence() const { return last_sequence_.Acquire_Load(); }
 
-  // Set the last sequence number to s.
+  // Set the last sequence number to s, once its entries are written.
+  // REQUIRES: the DB mutex is held.
   void SetLastSequence(uint64_t s) {
-    assert(s >= last_sequence_.Get());
+    assert(s >= last_sequence_.Acquire_Load());
     // last_sequence_ = s;
-    last_sequence_.Set(s);
+    last_sequence_.Release_Store(s);
   }
 
   // Mark the specified file number as used.
@@ -276,7 +300,7 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (config::kDoSeekCompaction && v->file_to_compact_ != NULL);
+    return (v->compaction_score_ >= 1) || (config_->kDoSeekCompaction && v->file_to_compact_ != NULL);
   }
 
   // Add all files listed in any live version to *live.
@@ -334,6 +358,7 @@ class VersionSet {
   Env* const env_;
   const std::string dbname_;
   const Options* const options_;
+  const config* const config_;
   TableCache* const table_cache_;
   const InternalKeyComparator icmp_;
   port::AtomicCount<uint64_t> next_file_number_;
@@ -355,6 +380,7 @@ class VersionSet {
   log::Writer* descriptor_log_;
   Version dummy_versions_;  // Head of circular doubly-linked list of versions.
   Version* current_;        // == dummy_versions_.prev_
+  uint64_t manifest_syncs_;
 
   // Per-level key at which the next compaction at that level should start.
   // Either an empty string, or a valid InternalKey.
@@ -411,10 +437,11 @@ class Compaction {
   friend class Version;
   friend class VersionSet;
 
-  explicit Compaction(int level);
+  Compaction(const config* config, int level);
 
   int level_;
   uint64_t max_output_file_size_;
+  int64_t max_grandparent_overlap_bytes_;
   Version* input_version_;
   VersionEdit edit_;
 
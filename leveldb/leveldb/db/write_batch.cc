@@ -39,6 +39,21 @@ void WriteBatch::Clear() {
   rep_.resize(kHeader);
 }
 
+size_t WriteBatch::ApproximateSize() const {
+  return rep_.size();
+}
+
+int WriteBatch::Count() const {
+  return WriteBatchInternal::Count(this);
+}
+
+void WriteBatch::RollbackTo(size_t size, int count) {
+  assert(size >= kHeader && size <= rep_.size());
+  assert(count <= WriteBatchInternal::Count(this));
+  rep_.resize(size);
+  WriteBatchInternal::SetCount(this, count);
+}
+
 Status WriteBatch::Iterate(Handler* handler) const {
   Slice input(rep_);
   if (input.size() < kHeader) {
@@ -0,0 +1,71 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// BulkLoad adds a large number of new entries to a DB without going
+// through the log and the memtable: the entries are sorted into table
+// files that are added to the DB with a single version edit.
+//
+//    BulkLoad* load = db->NewBulkLoad(WriteOptions(), 64 << 20, false);
+//    load->Add("key1", "value1");       // In any order
+//    ...
+//    Status s = load->Finish();
+//    delete load;
+//
+// The files are placed at the deepest level that has no data in their key
+// range, so loading into an empty key range costs about one sequential
+// write of the data.  If the range overlaps data that is still in the
+// memtable or in level-0 when the load finishes, the entries are written
+// through the memtable instead, in several write batches.
+//
+// An overwriting load may add a key more than once, the last entry
+// winning, and may delete keys.  Like any load that cannot install its
+// files, it is then written in several batches: the caller must keep
+// other writers off its keys, and readers may see a part of it until
+// Finish() returns.  A crash in the middle may leave a part of it in the
+// DB.
+//
+// A BulkLoad must be externally synchronized.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_BULK_LOAD_H_
+#define STORAGE_LEVELDB_INCLUDE_BULK_LOAD_H_
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class BulkLoad {
+ public:
+  BulkLoad() { }
+
+  // Removes the files of a load that did not finish successfully.
+  virtual ~BulkLoad();
+
+  // Adds an entry.  Entries may be added in any order, but a key may
+  // only be added once unless the load overwrites.
+  virtual void Add(const Slice& key, const Slice& value) = 0;
+
+  // Adds the deletion of "key".
+  // REQUIRES: the load overwrites
+  virtual void Delete(const Slice& key) = 0;
+
+  // Return non-ok iff some error has been detected.
+  virtual Status status() const = 0;
+
+  // Adds the entries to the DB.  Returns InvalidArgument if a key was
+  // added twice to a load that does not overwrite, in which case the DB
+  // is unchanged.  Snapshots taken while Finish() runs may or may not see
+  // the entries.
+  // REQUIRES: Finish() has not been called
+  virtual Status Finish() = 0;
+
+ private:
+  // No copying allowed
+  BulkLoad(const BulkLoad&);
+  void operator=(const BulkLoad&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_BULK_LOAD_H_
@@ -81,6 +81,19 @@ class Cache {
   // its cache keys.
   virtual uint64_t NewId() = 0;
 
+  // Return the number of Lookup() calls that found their key, and that
+  // did not.
+  virtual uint64_t Hits() = 0;
+  virtual uint64_t Misses() = 0;
+
+  // Return the total charge of the entries in the cache.
+  virtual size_t TotalCharge() = 0;
+
+  // Change the capacity of the cache, evicting the least recently used
+  // entries if the cache is now over capacity.  Entries still in use
+  // are freed when they are released.
+  virtual void SetCapacity(size_t capacity) = 0;
+
  private:
   void LRU_Remove(Handle* e);
   void LRU_Append(Handle* e);
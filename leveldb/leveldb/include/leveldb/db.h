@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 
@@ -19,16 +21,89 @@ static const int kMinorVersion = 4;
 struct Options;
 struct ReadOptions;
 struct WriteOptions;
+class BulkLoad;
 class WriteBatch;
 
 // Abstract handle to particular state of a DB.
 // A Snapshot is an immutable object and can therefore be safely
 // accessed from multiple threads without any external synchronization.
 class Snapshot {
+ public:
+  // Sequence number of the last write the snapshot observes.
+  virtual uint64_t sequence() const = 0;
+
  protected:
   virtual ~Snapshot();
 };
 
+// Counters of a DB since it was opened, see DB::GetStats().
+struct DBStats {
+  uint64_t write_groups;              // Log writes
+  uint64_t write_group_batches;       // Batches carried by the log writes
+  uint64_t log_bytes;                 // Bytes appended to the log
+  uint64_t flush_bytes;               // Bytes of tables written by flushes
+  uint64_t compaction_bytes_read;     // Bytes of tables read by compactions
+  uint64_t compaction_bytes_written;  // Bytes of tables they wrote
+  uint64_t bulk_load_bytes;           // Bytes of tables added by BulkLoad
+  uint64_t log_syncs;                 // Syncs of the log
+  uint64_t table_syncs;               // Syncs of new table files
+  uint64_t manifest_syncs;            // Syncs of the descriptor
+  uint64_t stall_micros;              // Time writes waited for room
+  uint64_t write_slowdowns;           // Writes delayed for level-0 files
+  uint64_t write_stops;               // Waits for a flush or compaction
+  uint64_t memtables;                 // All memtables, bucket ones included
+  uint64_t immutable_memtables;       // Memtables waiting to be flushed
+  uint64_t memtable_bytes;            // Memory used by all memtables
+  uint64_t level0_files;              // Files at level-0
+  uint64_t table_files;               // Files at all levels
+  uint64_t table_bytes;               // Size of the files at all levels
+};
+
+// A table file of the current version, see DB::GetFiles().
+struct FileInfo {
+  int level;
+  uint64_t number;
+  uint64_t size;                      // File size in bytes
+  uint64_t num_entries;               // 0 if written by an older release
+  std::string smallest;               // Smallest user key in the file
+  std::string largest;                // Largest user key in the file
+};
+
+// A table-writing job, see DB::GetCompactionHistory().
+struct CompactionInfo {
+  enum Type {
+    kFlush,                           // Memtable written to a table
+    kCompaction,                      // Files merged into the next level
+    kSelfLevelCompaction,             // Files rewritten in their own level
+    kTrivialMove,                     // File moved to the next level
+    kBulkLoad,                        // Files added by a BulkLoad
+    kDeleteFiles                      // Files removed by DeleteFilesInRange
+  };
+  Type type;
+  bool ok;                            // False if the job failed
+  uint64_t start_micros;              // Env::NowMicros() when it started
+  uint64_t end_micros;                // and when it finished
+  int input_level;                    // -1 for flushes, bulk loads and
+                                      // deleted files
+  int output_level;
+  int input_files;
+  int output_files;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t input_entries;             // Entries read by compactions
+  uint64_t dropped_entries;           // and the ones not written back
+};
+
+// Compaction totals of a level since the DB was opened, see
+// DB::GetLevelStats().
+struct LevelInfo {
+  int files;                          // Files now at the level
+  uint64_t bytes;                     // and their size
+  uint64_t micros;                    // Time spent writing to the level
+  uint64_t bytes_read;                // Bytes read by those jobs
+  uint64_t bytes_written;             // Bytes written to the level
+};
+
 // A range of keys
 struct Range {
   Slice start;          // Included in the range
@@ -116,6 +191,32 @@ class DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key, std::string* value) = 0;
 
+  // Same as Get() above, but the value is passed to
+  // (*handle_value)(arg, value) instead of being copied.  "value" is only
+  // valid during the call, so the caller decodes it where it needs it.
+  virtual Status Get(const ReadOptions& options, const Slice& key,
+                     void* arg,
+                     void (*handle_value)(void* arg, const Slice& value)) = 0;
+
+  // Same as Get() for each of "keys", storing the value of keys[i] in
+  // (*values)[i] and returning its status in the i'th element of the
+  // result.  All the keys are read from one state of the database, and
+  // each table file is searched once for all the keys it may hold, so
+  // this is cheaper than one Get() per key.
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values) = 0;
+
+  // Returns false if the database surely has no entry for "key", and
+  // true if it may have one.  Only the memtables and the filters of the
+  // table files are consulted, so no data block is read.  If the entry
+  // is found in a memtable its value is stored in *value and
+  // *value_found is set to true; otherwise *value_found is set to false
+  // and a true result must be confirmed with Get().
+  virtual bool KeyMayExist(const ReadOptions& options,
+                           const Slice& key, std::string* value,
+                           bool* value_found) = 0;
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -124,6 +225,18 @@ class DB {
   // The returned iterator should be deleted before this db is deleted.
   virtual Iterator* NewIterator(const ReadOptions& options) = 0;
 
+  // Return a heap-allocated BulkLoad that adds entries to the database
+  // by writing table files directly (see leveldb/bulk_load.h).  Up to
+  // "buffer_size" bytes of entries are sorted in memory at a time;
+  // "options" apply to the entries that are written through the memtable.
+  // If "overwrite" is true, later entries for a key replace earlier ones
+  // and keys may be deleted.
+  //
+  // Caller should delete the BulkLoad when it is no longer needed.
+  // The returned BulkLoad should be deleted before this db is deleted.
+  virtual BulkLoad* NewBulkLoad(const WriteOptions& options,
+                                size_t buffer_size, bool overwrite) = 0;
+
   // Return a handle to the current DB state.  Iterators created with
   // this handle will all observe a stable snapshot of the current DB
   // state.  The caller must call ReleaseSnapshot(result) when the
@@ -134,6 +247,10 @@ class DB {
   // use "snapshot" after this call.
   virtual void ReleaseSnapshot(const Snapshot* snapshot) = 0;
 
+  // Sequence number of the last write applied to the DB.  A write
+  // returned by Write() is at or below the value read after it.
+  virtual uint64_t GetLatestSequenceNumber() = 0;
+
   // DB implementations can export properties about their state
   // via this method.  If "property" is a valid property understood by this
   // DB implementation, fills "*value" with its current value and returns
@@ -148,12 +265,38 @@ class DB {
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.write-groups", "leveldb.write-group-batches",
+  //  "leveldb.log-syncs" - number of log writes, of the batches they
+  //     carried (group commit) and of the log syncs they needed.
   virtual bool GetProperty(const Slice& property, std::string* value,
                            void (*key_printer)(const Slice&, std::string&) = NULL) = 0;
 
+  // Store the counters of the DB in *stats.  Cheaper than GetProperty()
+  // since nothing is formatted: one lock and a few loads.
+  virtual void GetStats(DBStats* stats) = 0;
+
+  // Store the table files of the current version in *files, by level.
+  virtual void GetFiles(std::vector<FileInfo>* files) = 0;
+
+  // Store the last flushes, compactions and bulk loads of the DB in
+  // *history, oldest first.  Only a bounded number of jobs is kept.
+  virtual void GetCompactionHistory(std::vector<CompactionInfo>* history) = 0;
+
+  // Store the compaction totals of each level in *levels, indexed by
+  // level.
+  virtual void GetLevelStats(std::vector<LevelInfo>* levels) = 0;
+
   // operate some command to db
   virtual Status OpCmd(int cmd) = 0;
 
+  // Apply the fields of "options" that may change while the DB is open:
+  // write_buffer_size, max_mem_usage_for_memtable, the kL0_* triggers,
+  // kMaxMemCompactLevel, the kLimitCompact* settings,
+  // kLimitDeleteObsoleteFileInterval and kDoSeekCompaction.  The other
+  // fields are ignored; they only take effect when the DB is reopened.
+  // The block cache is resized through Cache::SetCapacity().
+  virtual Status SetOptions(const Options& options) = 0;
+
   // For each i in [0,n-1], store in "sizes[i]", the approximate
   // file system space used by keys in "[range[i].start .. range[i].limit)".
   //
@@ -180,6 +323,15 @@ class DB {
   //    db->CompactRange(NULL, NULL);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
 
+  // Remove the table files whose keys all lie in [begin,end) from the
+  // DB with a single version edit, without reading them.  The entries
+  // of the range held by the memtables or by files that also hold keys
+  // outside of it are kept, and removing a file may uncover older
+  // entries of the range in deeper levels: the caller must hide the
+  // range by other means (e.g. a comparator that drops its keys) and
+  // uses this call to reclaim most of its space at once.
+  virtual Status DeleteFilesInRange(const Slice& begin, const Slice& end) = 0;
+
   // Compact a range of keys only in one level and files whoes filenumer is less than limit_filenumber
   virtual Status CompactRangeSelfLevel(uint64_t limit_filenumber, const Slice* begin, const Slice* end) = 0;
 
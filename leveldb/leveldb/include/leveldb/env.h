@@ -74,6 +74,15 @@ class Env {
   virtual Status NewRandomAccessFile(const std::string& fname,
                                      RandomAccessFile** result) = 0;
 
+  // Like NewRandomAccessFile(fname, result), but the file may be memory
+  // mapped if use_mmap is true and the environment supports it.  The
+  // default implementation ignores use_mmap.
+  virtual Status NewRandomAccessFile(const std::string& fname,
+                                     RandomAccessFile** result,
+                                     bool use_mmap) {
+    return NewRandomAccessFile(fname, result);
+  }
+
   // Create an object that writes to a new file with the specified
   // name.  Deletes any existing file with the same name and creates a
   // new file.  On success, stores a pointer to the new file in
@@ -307,6 +316,10 @@ class EnvWrapper : public Env {
   Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
     return target_->NewRandomAccessFile(f, r);
   }
+  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r,
+                             bool use_mmap) {
+    return target_->NewRandomAccessFile(f, r, use_mmap);
+  }
   Status NewWritableFile(const std::string& f, WritableFile** r) {
     return target_->NewWritableFile(f, r);
   }
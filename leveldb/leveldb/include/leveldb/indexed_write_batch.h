@@ -0,0 +1,70 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// IndexedWriteBatch is a WriteBatch whose updates are also kept sorted by
+// key, so that the writer can read its own pending updates: look a key up
+// in the batch, or iterate over a DB iterator with the batch applied on
+// top of it.
+//
+// The index refers to the records of the batch, so a lookup does not
+// parse the batch.  An IndexedWriteBatch must be externally synchronized.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_INDEXED_WRITE_BATCH_H_
+#define STORAGE_LEVELDB_INCLUDE_INDEXED_WRITE_BATCH_H_
+
+#include <string>
+#include "leveldb/comparator.h"
+#include "leveldb/write_batch.h"
+
+namespace leveldb {
+
+class Iterator;
+
+class IndexedWriteBatch {
+ public:
+  // "comparator" must order keys like the comparator of the DB the batch
+  // is read together with.
+  explicit IndexedWriteBatch(const Comparator* comparator = BytewiseComparator());
+  ~IndexedWriteBatch();
+
+  // Same as the WriteBatch methods, keeping the index up to date.
+  void Put(const Slice& key, const Slice& value);
+  void Delete(const Slice& key);
+  void Clear();
+  size_t ApproximateSize() const { return batch_.ApproximateSize(); }
+  int Count() const { return batch_.Count(); }
+  void RollbackTo(size_t size, int count);
+
+  // The updates, to be applied by DB::Write().
+  WriteBatch* GetWriteBatch() { return &batch_; }
+
+  // Returns true if the batch updates "key".  For a Put, stores the value
+  // in *value and sets *deleted to false; for a Delete sets *deleted.
+  bool Get(const Slice& key, std::string* value, bool* deleted) const;
+
+  // Same as above, but *value points into the batch and is only valid
+  // until the batch is next changed.
+  bool Get(const Slice& key, Slice* value, bool* deleted) const;
+
+  // Returns an iterator over "base" with the updates of the batch applied
+  // on top of it, and takes ownership of "base".  The iterator sees the
+  // updates added while it is live.  After Clear() or RollbackTo() it may
+  // only be deleted.
+  Iterator* NewIteratorWithBase(Iterator* base) const;
+
+ private:
+  struct Rep;
+  Rep* rep_;
+  WriteBatch batch_;
+
+  void AddToIndex(const Slice& key, size_t offset);
+
+  // No copying allowed
+  IndexedWriteBatch(const IndexedWriteBatch&);
+  void operator=(const IndexedWriteBatch&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_INDEXED_WRITE_BATCH_H_
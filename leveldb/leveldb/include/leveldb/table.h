@@ -71,6 +71,19 @@ class Table {
       void* arg,
       void (*handle_result)(void* arg, const Slice& k, const Slice& v));
 
+  // Same as InternalGet() for each of the n sorted keys of "keys", with
+  // "args[i]" for "keys[i]".  The index is walked once for all the keys,
+  // and a data block is read once for all the keys it may hold.
+  Status InternalMultiGet(
+      const ReadOptions&, int n, const Slice* keys,
+      void* const* args,
+      void (*handle_result)(void* arg, const Slice& k, const Slice& v));
+
+  // Returns false if the filter of the data block that would hold "key"
+  // rules the key out.  Only the index block and the filter, which are
+  // kept in memory, are consulted.
+  bool KeyMayMatch(const Slice& key);
+
 
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
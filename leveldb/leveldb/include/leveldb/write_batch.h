@@ -45,6 +45,17 @@ class WriteBatch {
   // Clear all updates buffered in this batch.
   void Clear();
 
+  // Size of the batch representation.  Together with Count() it marks a
+  // point the batch can be rolled back to.
+  size_t ApproximateSize() const;
+
+  // Number of updates buffered in this batch.
+  int Count() const;
+
+  // Drop the updates added since the batch had "count" updates and was
+  // "size" bytes long.
+  void RollbackTo(size_t size, int count);
+
   // Support for iterating over the contents of a batch.
   class Handler {
    public:
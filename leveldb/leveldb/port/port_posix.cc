@@ -42,8 +42,9 @@ void CondVar::TimedWait(int64_t timeout_us) {
   struct timeval tv;
   gettimeofday(&tv, NULL);
   timespec ts;
-  ts.tv_sec += timeout_us / 1000000;
-  ts.tv_nsec = (tv.tv_usec + timeout_us % 1000000) * 1000;
+  int64_t usec = tv.tv_usec + timeout_us % 1000000;
+  ts.tv_sec = tv.tv_sec + timeout_us / 1000000 + usec / 1000000;
+  ts.tv_nsec = (usec % 1000000) * 1000;
   PthreadCall("timedwait", pthread_cond_timedwait(&cv_, &mu_->mu_, &ts));
 }
 
@@ -114,6 +114,15 @@ public:
   inline T GetAndInc() {
     return atomic_add(&t_, 1);
   }
+  // Load and store that are atomic for every T, even 64 bits wide on
+  // i386, and order the accesses around them: what was written before a
+  // Release_Store() is visible after an Acquire_Load() that returns it.
+  inline T Acquire_Load() const {
+    return __atomic_load_n(&t_, __ATOMIC_ACQUIRE);
+  }
+  inline void Release_Store(T t) {
+    __atomic_store_n(&t_, t, __ATOMIC_RELEASE);
+  }
 
 private:
   volatile T t_;
@@ -6,19 +6,20 @@
 
 #include "leveldb/filter_policy.h"
 #include "util/coding.h"
-#include "util/config.h"
 
 namespace leveldb {
 
 // See doc/table_format.txt for an explanation of the filter block format.
 
-FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy)
-    : policy_(policy) {
+FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy,
+                                       int base_lg)
+    : policy_(policy),
+      base_lg_(base_lg) {
 }
 
 void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
-  uint64_t filter_index = (block_offset / config::kFilterBase);
-  // Actually kFilterBase CAN be larger than block size, just minimize each filter here.
+  uint64_t filter_index = (block_offset >> base_lg_);
+  // Actually filter base CAN be larger than block size, just minimize each filter here.
   assert(filter_index >= filter_offsets_.size());
   while (filter_index > filter_offsets_.size()) {
     GenerateFilter();
@@ -43,7 +44,7 @@ Slice FilterBlockBuilder::Finish() {
   }
 
   PutFixed32(&result_, array_offset);
-  result_.push_back(config::kFilterBaseLg);  // Save encoding parameter in result
+  result_.push_back(base_lg_);  // Save encoding parameter in result
   return Slice(result_);
 }
 
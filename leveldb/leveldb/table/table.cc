@@ -251,6 +251,73 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
   return s;
 }
 
+bool Table::KeyMayMatch(const Slice& k) {
+  FilterBlockReader* filter = rep_->filter;
+  if (filter == NULL) {
+    return true;
+  }
+  bool may_match = true;
+  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  iiter->Seek(k);
+  if (iiter->Valid()) {
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (handle.DecodeFrom(&handle_value).ok()) {
+      may_match = filter->KeyMayMatch(handle.offset(), k);
+    }
+  } else if (iiter->status().ok()) {
+    // Past the last key of the table
+    may_match = false;
+  }
+  delete iiter;
+  return may_match;
+}
+
+Status Table::InternalMultiGet(const ReadOptions& options, int n,
+                               const Slice* keys, void* const* args,
+                               void (*saver)(void*, const Slice&, const Slice&)) {
+  Status s;
+  const Comparator* comparator = rep_->options.comparator;
+  Iterator* iiter = rep_->index_block->NewIterator(comparator);
+  Iterator* block_iter = NULL;
+  std::string block_handle;     // Handle of the block of block_iter
+  for (int i = 0; i < n && s.ok(); i++) {
+    // The keys are sorted, so the index entry of this key is the current
+    // one unless the key is past it.
+    if (i == 0 || comparator->Compare(keys[i], iiter->key()) > 0) {
+      iiter->Seek(keys[i]);
+      if (!iiter->Valid()) {
+        break;                  // This key and the next ones are past the table
+      }
+    }
+
+    Slice handle_value = iiter->value();
+    FilterBlockReader* filter = rep_->filter;
+    BlockHandle handle;
+    if (filter != NULL &&
+        handle.DecodeFrom(&handle_value).ok() &&
+        !filter->KeyMayMatch(handle.offset(), keys[i])) {
+      continue;                 // Not found
+    }
+
+    if (block_iter == NULL || iiter->value() != Slice(block_handle)) {
+      delete block_iter;
+      block_iter = BlockReader(this, options, iiter->value());
+      block_handle.assign(iiter->value().data(), iiter->value().size());
+    }
+    block_iter->Seek(keys[i]);
+    if (block_iter->Valid()) {
+      (*saver)(args[i], block_iter->key(), block_iter->value());
+    }
+    s = block_iter->status();
+  }
+  if (s.ok()) {
+    s = iiter->status();
+  }
+  delete block_iter;
+  delete iiter;
+  return s;
+}
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
   Iterator* index_iter =
@@ -54,7 +54,8 @@ struct TableBuilder::Rep {
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == NULL ? NULL
-                     : new FilterBlockBuilder(opt.filter_policy)),
+                     : new FilterBlockBuilder(opt.filter_policy,
+                                              opt.kFilterBaseLg)),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
   }
@@ -3,12 +3,11 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "util/arena.h"
-#include "util/config.h"
 #include <assert.h>
 
 namespace leveldb {
 
-Arena::Arena() {
+Arena::Arena(size_t block_size) : block_size_(block_size) {
   blocks_memory_ = 0;
   alloc_ptr_ = NULL;  // First allocation will allocate a block
   alloc_bytes_remaining_ = 0;
@@ -21,7 +20,7 @@ Arena::~Arena() {
 }
 
 char* Arena::AllocateFallback(size_t bytes) {
-  if (bytes > static_cast<size_t>(config::kArenaBlockSize / 4)) {
+  if (bytes > block_size_ / 4) {
     // Object is more than a quarter of our block size.  Allocate it separately
     // to avoid wasting too much space in leftover bytes.
     char* result = AllocateNewBlock(bytes);
@@ -29,8 +28,8 @@ char* Arena::AllocateFallback(size_t bytes) {
   }
 
   // We waste the remaining space in the current block.
-  alloc_ptr_ = AllocateNewBlock(config::kArenaBlockSize);
-  alloc_bytes_remaining_ = config::kArenaBlockSize;
+  alloc_ptr_ = AllocateNewBlock(block_size_);
+  alloc_bytes_remaining_ = block_size_;
 
   char* result = alloc_ptr_;
   alloc_ptr_ += bytes;
@@ -57,6 +56,27 @@ char* Arena::AllocateAligned(size_t bytes) {
   return result;
 }
 
+void Arena::Reset() {
+  // Only blocks of block_size_ bytes are allocated from piecemeal.
+  char* current = NULL;
+  if (alloc_ptr_ != NULL) {
+    current = alloc_ptr_ + alloc_bytes_remaining_ - block_size_;
+  }
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    if (blocks_[i] != current) {
+      delete[] blocks_[i];
+    }
+  }
+  blocks_.clear();
+  blocks_memory_ = 0;
+  if (current != NULL) {
+    blocks_.push_back(current);
+    blocks_memory_ = block_size_;
+    alloc_ptr_ = current;
+    alloc_bytes_remaining_ = block_size_;
+  }
+}
+
 char* Arena::AllocateNewBlock(size_t block_bytes) {
   char* result = new char[block_bytes];
   blocks_memory_ += block_bytes;
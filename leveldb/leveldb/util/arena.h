@@ -14,7 +14,10 @@ namespace leveldb {
 
 class Arena {
  public:
-  Arena();
+  static const size_t kDefaultBlockSize = 4096;
+
+  // Memory is allocated in blocks of "block_size" bytes.
+  explicit Arena(size_t block_size = kDefaultBlockSize);
   ~Arena();
 
   // Return a pointer to a newly allocated memory block of "bytes" bytes.
@@ -23,6 +26,10 @@ class Arena {
   // Allocate memory with the normal alignment guarantees provided by malloc
   char* AllocateAligned(size_t bytes);
 
+  // Frees every allocation at once.  The block currently allocated from
+  // is kept for the allocations that follow.
+  void Reset();
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena (including space allocated but not yet used for user
   // allocations).
@@ -34,6 +41,8 @@ class Arena {
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
 
+  const size_t block_size_;
+
   // Allocation state
   char* alloc_ptr_;
   size_t alloc_bytes_remaining_;
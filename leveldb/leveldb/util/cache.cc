@@ -138,8 +138,9 @@ class LRUCache {
   LRUCache();
   ~LRUCache();
 
-  // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  // Separate from constructor so caller can easily make an array of LRUCache.
+  // Evicts the oldest entries if the cache is now over capacity.
+  void SetCapacity(size_t capacity);
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
@@ -148,19 +149,22 @@ class LRUCache {
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
+  void GetStats(uint64_t* hits, uint64_t* misses, size_t* usage);
 
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* e);
   void Unref(LRUHandle* e);
 
-  // Initialized before use.
-  size_t capacity_;
+  void EvictToCapacity();
 
   // mutex_ protects the following state.
   port::Mutex mutex_;
+  size_t capacity_;
   size_t usage_;
   uint64_t last_id_;
+  uint64_t hits_;
+  uint64_t misses_;
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
@@ -170,8 +174,11 @@ class LRUCache {
 };
 
 LRUCache::LRUCache()
-    : usage_(0),
-      last_id_(0) {
+    : capacity_(0),
+      usage_(0),
+      last_id_(0),
+      hits_(0),
+      misses_(0) {
   // Make empty circular linked list
   lru_.next = &lru_;
   lru_.prev = &lru_;
@@ -213,9 +220,12 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != NULL) {
+    hits_++;
     e->refs++;
     LRU_Remove(e);
     LRU_Append(e);
+  } else {
+    misses_++;
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -248,14 +258,31 @@ Cache::Handle* LRUCache::Insert(
     Unref(old);
   }
 
+  EvictToCapacity();
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void LRUCache::SetCapacity(size_t capacity) {
+  MutexLock l(&mutex_);
+  capacity_ = capacity;
+  EvictToCapacity();
+}
+
+// REQUIRES: mutex_ is held
+void LRUCache::EvictToCapacity() {
   while (usage_ > capacity_ && lru_.next != &lru_) {
     LRUHandle* old = lru_.next;
     LRU_Remove(old);
     table_.Remove(old->key(), old->hash);
     Unref(old);
   }
+}
 
-  return reinterpret_cast<Cache::Handle*>(e);
+void LRUCache::GetStats(uint64_t* hits, uint64_t* misses, size_t* usage) {
+  MutexLock l(&mutex_);
+  *hits += hits_;
+  *misses += misses_;
+  *usage += usage_;
 }
 
 void LRUCache::Erase(const Slice& key, uint32_t hash) {
@@ -287,10 +314,7 @@ class ShardedLRUCache : public Cache {
  public:
   explicit ShardedLRUCache(size_t capacity)
       : last_id_(0) {
-    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-    for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
-    }
+    SetCapacity(capacity);
   }
   virtual ~ShardedLRUCache() { }
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
@@ -317,6 +341,37 @@ class ShardedLRUCache : public Cache {
     MutexLock l(&id_mutex_);
     return ++(last_id_);
   }
+  virtual uint64_t Hits() {
+    uint64_t hits = 0, misses = 0;
+    size_t usage = 0;
+    GetStats(&hits, &misses, &usage);
+    return hits;
+  }
+  virtual uint64_t Misses() {
+    uint64_t hits = 0, misses = 0;
+    size_t usage = 0;
+    GetStats(&hits, &misses, &usage);
+    return misses;
+  }
+  virtual void SetCapacity(size_t capacity) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].SetCapacity(per_shard);
+    }
+  }
+  virtual size_t TotalCharge() {
+    uint64_t hits = 0, misses = 0;
+    size_t usage = 0;
+    GetStats(&hits, &misses, &usage);
+    return usage;
+  }
+
+ private:
+  void GetStats(uint64_t* hits, uint64_t* misses, size_t* usage) {
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].GetStats(hits, misses, usage);
+    }
+  }
 };
 
 }  // end anonymous namespace
@@ -25,7 +25,6 @@
 #include "util/mutexlock.h"
 #include "util/logging.h"
 #include "util/posix_logger.h"
-#include "util/config.h"
 
 namespace leveldb {
 
@@ -452,12 +451,18 @@ class PosixEnv : public Env {
 
   virtual Status NewRandomAccessFile(const std::string& fname,
                                      RandomAccessFile** result) {
+    return NewRandomAccessFile(fname, result, false);
+  }
+
+  virtual Status NewRandomAccessFile(const std::string& fname,
+                                     RandomAccessFile** result,
+                                     bool use_mmap) {
     *result = NULL;
     Status s;
     int fd = open(fname.c_str(), O_RDONLY);
     if (fd < 0) {
       s = IOError(fname, errno);
-    } else if (sizeof(void*) >= 8 && config::kUseMmapRandomAccess) {
+    } else if (sizeof(void*) >= 8 && use_mmap) {
       // Use mmap when virtual address-space is plentiful.
       uint64_t size;
       s = GetFileSize(fname, &size);